@@ -0,0 +1,257 @@
+/**
+ * @brief Measures number formatting against the printf-based formatting print
+ * used before.
+ *
+ * Every routine is first checked against printf, or the bit loop binary output
+ * was built with, on the edge values: zero, the extremes, and each power of two
+ * and of ten with its neighbours, both signs. The random values are then
+ * checked too, and spread over every length from one digit to the most, so no
+ * single length dominates.
+ *
+ * Usage: format_bench [values] [repetitions]
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "format.h"
+
+#define DEFAULT_VALUES      1000000
+#define DEFAULT_REPETITIONS 5
+#define TEXT_MAX            68  // Room for any number in any base, and a NUL.
+
+typedef size_t (*Formatter)(char *out, int64_t value);
+
+static size_t   printf_decimal(char *out, int64_t value);
+static size_t   printf_hex(char *out, int64_t value);
+static size_t   loop_binary(char *out, int64_t value);
+static size_t   fast_decimal(char *out, int64_t value);
+static size_t   fast_hex(char *out, int64_t value);
+static size_t   fast_binary(char *out, int64_t value);
+static bool     check(const char *name, Formatter expected, Formatter actual, const int64_t *values,
+                      long count);
+static long     edge_values(int64_t *values);
+static int64_t *random_values(long count);
+static double   run(Formatter format, const int64_t *values, long count, int repetitions);
+static double   now(void);
+
+int main(int argc, char **argv) {
+    long count       = (argc > 1) ? strtol(argv[1], NULL, 10) : DEFAULT_VALUES;
+    int  repetitions = (argc > 2) ? atoi(argv[2]) : DEFAULT_REPETITIONS;
+    if (count <= 0 || repetitions <= 0) {
+        printf("Usage: %s [values] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    static const struct {
+        const char *name;
+        Formatter   before;
+        Formatter   after;
+    } bases[] = {
+        {"decimal", printf_decimal, fast_decimal},
+        {"hex", printf_hex, fast_hex},
+        {"binary", loop_binary, fast_binary},
+    };
+    size_t base_count = sizeof(bases) / sizeof(bases[0]);
+
+    int64_t  edges[512];
+    long     edge_count = edge_values(edges);
+    int64_t *values     = random_values(count);
+    if (!values) {
+        printf("Could not allocate the values\n");
+        return 1;
+    }
+
+    bool ok = true;
+    for (size_t b = 0; b < base_count; b++) {
+        ok = check(bases[b].name, bases[b].before, bases[b].after, edges, edge_count) && ok;
+        ok = check(bases[b].name, bases[b].before, bases[b].after, values, count) && ok;
+    }
+    if (!ok) {
+        free(values);
+        return 1;
+    }
+    printf("format check: %ld edge and %ld random values match\n", edge_count, count);
+
+    for (size_t b = 0; b < base_count; b++) {
+        double before = run(bases[b].before, values, count, repetitions);
+        double after  = run(bases[b].after, values, count, repetitions);
+        printf("format %s: %ld values, best of %d: before %.1f ns/value, after %.1f ns/value, "
+               "%.1fx\n",
+               bases[b].name, count, repetitions, before / (double) count * 1e9,
+               after / (double) count * 1e9, before / after);
+    }
+    free(values);
+    return 0;
+}
+
+/**
+ * @brief Formats every value with two routines and reports any difference.
+ *
+ * @param name The name of the base, to report differences under.
+ * @param expected The routine giving the expected text.
+ * @param actual The routine to check.
+ * @param values The values to format.
+ * @param count The number of values.
+ * @return True if every value formatted the same, false otherwise.
+ */
+static bool check(const char *name, Formatter expected, Formatter actual, const int64_t *values,
+                  long count) {
+    for (long i = 0; i < count; i++) {
+        char   want[TEXT_MAX];
+        char   got[TEXT_MAX];
+        size_t want_length = expected(want, values[i]);
+        size_t got_length  = actual(got, values[i]);
+        if (want_length != got_length || memcmp(want, got, want_length) != 0) {
+            printf("format %s of %" PRId64 ": expected %.*s, got %.*s\n", name, values[i],
+                   (int) want_length, want, (int) got_length, got);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Fills in the values where formatting is most likely to go wrong.
+ *
+ * @param values Where to store the values, with room for 512.
+ * @return The number of values stored.
+ */
+static long edge_values(int64_t *values) {
+    long count      = 0;
+    values[count++] = 0;
+    values[count++] = INT64_MIN;
+    values[count++] = INT64_MAX;
+
+    // Each power and its neighbours, of both signs
+    uint64_t power = 1;
+    for (int bit = 0; bit < 64; bit++, power <<= 1) {
+        for (int offset = -1; offset <= 1; offset++) {
+            int64_t value   = (int64_t) (power + (uint64_t) offset);
+            values[count++] = value;
+            values[count++] = (int64_t) (0 - (uint64_t) value);
+        }
+    }
+    power = 1;
+    for (int digits = 1; digits <= 19; digits++, power *= 10) {
+        for (int offset = -1; offset <= 1; offset++) {
+            int64_t value   = (int64_t) (power + (uint64_t) offset);
+            values[count++] = value;
+            values[count++] = (int64_t) (0 - (uint64_t) value);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Generates random values of every length.
+ *
+ * @param count The number of values to generate.
+ * @return The values, or NULL if they could not be allocated.
+ */
+static int64_t *random_values(long count) {
+    int64_t *values = malloc((size_t) count * sizeof(int64_t));
+    if (!values) {
+        return NULL;
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (long i = 0; i < count; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        // Shifting off a random number of bits varies the length
+        values[i] = (int64_t) (state >> (state % 64));
+    }
+    return values;
+}
+
+/**
+ * @brief Formats every value several times and returns the best time.
+ *
+ * @param format The routine to time.
+ * @param values The values to format.
+ * @param count The number of values.
+ * @param repetitions How many times to format the values.
+ * @return The best time, in seconds.
+ */
+static double run(Formatter format, const int64_t *values, long count, int repetitions) {
+    double best  = 0;
+    size_t total = 0;
+    for (int r = 0; r < repetitions; r++) {
+        char   text[TEXT_MAX];
+        double start = now();
+        for (long i = 0; i < count; i++) {
+            total += format(text, values[i]);
+        }
+        double elapsed = now() - start;
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    // Using the total keeps the formatting from being optimized away
+    if (total == 0) {
+        printf("Nothing was formatted\n");
+    }
+    return best;
+}
+
+static size_t printf_decimal(char *out, int64_t value) {
+    return (size_t) snprintf(out, TEXT_MAX, "%" PRId64, value);
+}
+
+static size_t printf_hex(char *out, int64_t value) {
+    return (size_t) snprintf(out, TEXT_MAX, "%" PRIx64, (uint64_t) value);
+}
+
+/**
+ * @brief Formats in binary the way print did, a bit at a time.
+ */
+static size_t loop_binary(char *out, int64_t value) {
+    char     binary[65] = {0};
+    int      started    = 0;
+    int      index      = 0;
+    uint64_t uvalue     = (uint64_t) value;
+
+    for (int i = 63; i >= 0; i--) {
+        char bit = ((uvalue >> i) & 1) ? '1' : '0';
+
+        if (bit == '1' || started) {
+            started         = 1;
+            binary[index++] = bit;
+        }
+    }
+
+    if (!started) {
+        binary[0] = '0';
+        binary[1] = '\0';
+    }
+
+    return (size_t) snprintf(out, TEXT_MAX, "%s", binary);
+}
+
+static size_t fast_decimal(char *out, int64_t value) {
+    return format_decimal(out, value);
+}
+
+static size_t fast_hex(char *out, int64_t value) {
+    return format_hex(out, (uint64_t) value);
+}
+
+static size_t fast_binary(char *out, int64_t value) {
+    return format_binary(out, (uint64_t) value);
+}
+
+/**
+ * @brief Returns a monotonic time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
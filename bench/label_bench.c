@@ -0,0 +1,248 @@
+/**
+ * @brief Measures the label map on programs with many labels.
+ *
+ * The labels are digits shuffled between a few fixed prefixes, so many of them
+ * are made of the same characters, as generated code tends to produce. They are
+ * interned into a map that starts as small as the one a program is parsed
+ * with, then looked up by name, and finally a program defining and branching
+ * to every one of them is parsed.
+ *
+ * Usage: label_bench [labels] [repetitions]
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "label_map.h"
+#include "parser.h"
+#include "token_buffer.h"
+
+#define DEFAULT_LABELS      200000
+#define DEFAULT_REPETITIONS 5
+#define INITIAL_CAPACITY    100  // The capacity a program's label map starts with.
+
+static char **generate_labels(long count);
+static char  *generate_source(char **labels, long count);
+static bool   run_map(char **labels, long count, int repetitions);
+static bool   run_parse(char **labels, long count, int repetitions);
+static void   free_labels(char **labels, long count);
+static double now(void);
+
+int main(int argc, char **argv) {
+    long count       = (argc > 1) ? strtol(argv[1], NULL, 10) : DEFAULT_LABELS;
+    int  repetitions = (argc > 2) ? atoi(argv[2]) : DEFAULT_REPETITIONS;
+    if (count <= 0 || repetitions <= 0) {
+        printf("Usage: %s [labels] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    char **labels = generate_labels(count);
+    if (!labels) {
+        printf("Could not allocate the labels\n");
+        return 1;
+    }
+    bool ok = run_map(labels, count, repetitions) && run_parse(labels, count, repetitions);
+    free_labels(labels, count);
+    if (!ok) {
+        printf("Could not allocate the label map\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Interns and then looks up every label several times and prints the
+ * best times.
+ *
+ * @param labels The labels.
+ * @param count The number of labels.
+ * @param repetitions How many times to build the map.
+ * @return True on success, false if memory ran out.
+ */
+static bool run_map(char **labels, long count, int repetitions) {
+    double best_intern = 0;
+    double best_lookup = 0;
+    for (int r = 0; r < repetitions; r++) {
+        LabelMap map;
+        if (!label_map_init(&map, INITIAL_CAPACITY)) {
+            return false;
+        }
+
+        double start = now();
+        for (long i = 0; i < count; i++) {
+            if (intern_label(&map, labels[i], strlen(labels[i])) < 0) {
+                label_map_free(&map);
+                return false;
+            }
+        }
+        double interned = now() - start;
+
+        long found = 0;
+        start      = now();
+        for (long i = 0; i < count; i++) {
+            found += get_label(&map, labels[i]) != NULL;
+        }
+        double looked_up = now() - start;
+
+        label_map_free(&map);
+        if (found != count) {
+            return false;
+        }
+        if (r == 0 || interned < best_intern) {
+            best_intern = interned;
+        }
+        if (r == 0 || looked_up < best_lookup) {
+            best_lookup = looked_up;
+        }
+    }
+
+    printf("labels intern: %ld labels, best of %d: %.3f ms, %.1f ns/label\n", count, repetitions,
+           best_intern * 1e3, best_intern / (double) count * 1e9);
+    printf("labels lookup: %ld labels, best of %d: %.3f ms, %.1f ns/label\n", count, repetitions,
+           best_lookup * 1e3, best_lookup / (double) count * 1e9);
+    return true;
+}
+
+/**
+ * @brief Parses a program defining and branching to every label several times
+ * and prints the best time.
+ *
+ * @param labels The labels.
+ * @param count The number of labels.
+ * @param repetitions How many times to parse the program.
+ * @return True on success, false if memory ran out or the program did not
+ * parse.
+ */
+static bool run_parse(char **labels, long count, int repetitions) {
+    char *src = generate_source(labels, count);
+    if (!src) {
+        return false;
+    }
+
+    TokenBuffer tokens;
+    token_buffer_init(&tokens);
+    if (!token_buffer_lex(&tokens, src)) {
+        token_buffer_free(&tokens);
+        free(src);
+        return false;
+    }
+
+    bool   ok   = true;
+    double best = 0;
+    for (int r = 0; ok && r < repetitions; r++) {
+        LabelMap map;
+        Arena    arena;
+        Parser   parser;
+        if (!label_map_init(&map, INITIAL_CAPACITY)) {
+            ok = false;
+            break;
+        }
+        arena_init(&arena);
+
+        double start = now();
+        parser_init_tokens(&parser, &tokens, &map, &arena);
+        parse_commands(&parser);
+        double elapsed = now() - start;
+
+        ok = !parser.had_error && map.count == count;
+        parser_free(&parser);
+        arena_free(&arena);
+        label_map_free(&map);
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    if (ok) {
+        printf("labels parse: %ld labels, %zu bytes, best of %d: %.3f ms, %.1f ns/label\n",
+               count, strlen(src), repetitions, best * 1e3, best / (double) count * 1e9);
+    }
+    token_buffer_free(&tokens);
+    free(src);
+    return ok;
+}
+
+/**
+ * @brief Builds the labels, each a prefix and a shuffled number.
+ *
+ * @param count The number of labels to generate.
+ * @return The labels, or NULL if they could not be allocated.
+ */
+static char **generate_labels(long count) {
+    static const char *const prefixes[] = {"loop_", "l", ".end_", "case_"};
+
+    char **labels = calloc((size_t) count, sizeof(char *));
+    if (!labels) {
+        return NULL;
+    }
+    for (long i = 0; i < count; i++) {
+        // Reversing the digits makes neighbours anagrams of each other
+        char digits[24];
+        int  length = snprintf(digits, sizeof(digits), "%ld", i);
+        if (i % 2) {
+            for (int a = 0, b = length - 1; a < b; a++, b--) {
+                char c    = digits[a];
+                digits[a] = digits[b];
+                digits[b] = c;
+            }
+        }
+
+        labels[i] = malloc(40);
+        if (!labels[i]) {
+            free_labels(labels, i);
+            return NULL;
+        }
+        snprintf(labels[i], 40, "%s%s_%ld", prefixes[i % 4], digits, i % 7);
+    }
+    return labels;
+}
+
+/**
+ * @brief Builds a program that defines every label once and branches to it.
+ *
+ * @param labels The labels.
+ * @param count The number of labels.
+ * @return The NUL terminated source, or NULL if it could not be allocated.
+ */
+static char *generate_source(char **labels, long count) {
+    size_t capacity = (size_t) count * 96 + 1;
+    char  *src      = malloc(capacity);
+    if (!src) {
+        return NULL;
+    }
+
+    size_t length = 0;
+    for (long i = 0; i < count; i++) {
+        // Branch targets are spread over the whole program
+        const char *target = labels[(i * 7919 + 1) % count];
+        length += (size_t) snprintf(src + length, capacity - length,
+                                    "%s:\n    add x1, x1, 1\n    b.lt %s\n", labels[i], target);
+    }
+    return src;
+}
+
+/**
+ * @brief Frees generated labels.
+ *
+ * @param labels The labels.
+ * @param count The number of labels.
+ */
+static void free_labels(char **labels, long count) {
+    for (long i = 0; i < count; i++) {
+        free(labels[i]);
+    }
+    free(labels);
+}
+
+/**
+ * @brief Returns a monotonic time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,233 @@
+/**
+ * @brief Measures lexer throughput on a large generated source.
+ *
+ * The source mixes every kind of line a real program has: instructions with
+ * register and immediate operands, labels, branches, strings and comments, so
+ * keyword recognition is exercised the way it is in practice. A second,
+ * annotated variant is mostly indentation and comments, like generated code.
+ * The dense source is also lexed whole into a token buffer, as the parser
+ * reads it from a file.
+ *
+ * Usage: lexer_bench [lines] [repetitions]
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "token_buffer.h"
+#include "token_type.h"
+
+#define DEFAULT_LINES       1000000
+#define DEFAULT_REPETITIONS 5
+
+static char  *generate_source(long lines, bool annotated, size_t *size);
+static bool   run(const char *name, long lines, bool annotated, int repetitions);
+static bool   run_batched(long lines, int repetitions);
+static double now(void);
+
+int main(int argc, char **argv) {
+    long lines       = (argc > 1) ? strtol(argv[1], NULL, 10) : DEFAULT_LINES;
+    int  repetitions = (argc > 2) ? atoi(argv[2]) : DEFAULT_REPETITIONS;
+    if (lines <= 0 || repetitions <= 0) {
+        printf("Usage: %s [lines] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    if (!run("dense", lines, false, repetitions) || !run("annotated", lines, true, repetitions) ||
+        !run_batched(lines, repetitions)) {
+        printf("Could not allocate the source\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Lexes a generated source several times and prints the best time.
+ *
+ * @param name The name to print the results under.
+ * @param lines The number of lines to generate.
+ * @param annotated Whether to generate the annotated variant.
+ * @param repetitions How many times to lex the source.
+ * @return True on success, false if the source could not be allocated.
+ */
+static bool run(const char *name, long lines, bool annotated, int repetitions) {
+    size_t size;
+    char  *src = generate_source(lines, annotated, &size);
+    if (!src) {
+        return false;
+    }
+
+    double best   = 0;
+    long   tokens = 0;
+    long   idents = 0;
+    for (int r = 0; r < repetitions; r++) {
+        Lexer lex;
+        lexer_init(&lex, src);
+
+        tokens       = 0;
+        idents       = 0;
+        double start = now();
+        for (;;) {
+            Token t = lexer_next_token(&lex);
+            if (t.type == TOK_EOF || t.type == TOK_ERR) {
+                break;
+            }
+            tokens++;
+            idents += (t.type == TOK_IDENT);
+        }
+        double elapsed = now() - start;
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("lexer %s: %zu bytes, %ld lines, %ld tokens (%ld identifiers)\n", name, size, lines,
+           tokens, idents);
+    printf("lexer %s: best of %d: %.3f ms, %.1f MB/s, %.1f Mtokens/s\n", name, repetitions,
+           best * 1e3, (double) size / best / 1e6, (double) tokens / best / 1e6);
+
+    free(src);
+    return true;
+}
+
+/**
+ * @brief Lexes the dense source into a token buffer several times and prints
+ * the best time.
+ *
+ * @param lines The number of lines to generate.
+ * @param repetitions How many times to lex the source.
+ * @return True on success, false if the source or tokens could not be
+ * allocated.
+ */
+static bool run_batched(long lines, int repetitions) {
+    size_t size;
+    char  *src = generate_source(lines, false, &size);
+    if (!src) {
+        return false;
+    }
+
+    double best   = 0;
+    size_t tokens = 0;
+    size_t bytes  = 0;
+    for (int r = 0; r < repetitions; r++) {
+        TokenBuffer buffer;
+        token_buffer_init(&buffer);
+
+        double start   = now();
+        bool   lexed   = token_buffer_lex(&buffer, src);
+        double elapsed = now() - start;
+
+        tokens = buffer.count;
+        bytes  = buffer.count * (sizeof(uint8_t) + 2 * sizeof(uint32_t)) +
+                 buffer.newline_count * sizeof(uint32_t) +
+                 buffer.override_count * sizeof(TokenOverride);
+        token_buffer_free(&buffer);
+        if (!lexed) {
+            free(src);
+            return false;
+        }
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("lexer batched: %zu bytes, %zu tokens in %zu bytes of token buffer\n", size, tokens,
+           bytes);
+    printf("lexer batched: best of %d: %.3f ms, %.1f MB/s, %.1f Mtokens/s\n", repetitions,
+           best * 1e3, (double) size / best / 1e6, (double) tokens / best / 1e6);
+
+    free(src);
+    return true;
+}
+
+/**
+ * @brief Builds a source of the given number of lines.
+ *
+ * @param lines The number of lines to generate.
+ * @param annotated Whether to indent deeply and comment every line.
+ * @param size A pointer to store the length of the source in.
+ * @return The NUL terminated source, or NULL if it could not be allocated.
+ */
+static char *generate_source(long lines, bool annotated, size_t *size) {
+    static const char comment[] = "                // keeps the running total of the "
+                                  "block in the register named above\n";
+
+    size_t capacity = (size_t) lines * (48 + sizeof(comment)) + 1;
+    char  *src      = malloc(capacity);
+    if (!src) {
+        return NULL;
+    }
+
+    size_t length = 0;
+    for (long i = 0; i < lines; i++) {
+        char  *out  = src + length;
+        size_t room = capacity - length;
+        long   a    = i % 31 + 1;
+        long   b    = (i * 7) % 31 + 1;
+        long   c    = (i * 13) % 31 + 1;
+        int    written;
+
+        switch (i % 12) {
+            case 0:
+                written = snprintf(out, room, "    add x%ld, x%ld, x%ld\n", a, b, c);
+                break;
+            case 1:
+                written = snprintf(out, room, "    mov x%ld, %ld\n", a, i);
+                break;
+            case 2:
+                written = snprintf(out, room, "    load x%ld, 8, x%ld\n", a, b);
+                break;
+            case 3:
+                written = snprintf(out, room, "    store x%ld, x%ld, 8\n", a, b);
+                break;
+            case 4:
+                written = snprintf(out, room, "    cmp x%ld, x%ld\n", a, b);
+                break;
+            case 5:
+                written = snprintf(out, room, "    b.lt .loop_%ld\n", i);
+                break;
+            case 6:
+                written = snprintf(out, room, ".loop_%ld:\n", i);
+                break;
+            case 7:
+                written =
+                    snprintf(out, room, "    sub x%ld, x%ld, 0x%lx\n", a, b, (unsigned long) c);
+                break;
+            case 8:
+                written = snprintf(out, room, "    // comment on line %ld\n", i);
+                break;
+            case 9:
+                written = snprintf(out, room, "    put \"string %ld\", x%ld\n", i, a);
+                break;
+            case 10:
+                written = snprintf(out, room, "    call helper_%ld\n", c);
+                break;
+            default:
+                written = snprintf(out, room, "    print x%ld d\n", a);
+                break;
+        }
+        length += (size_t) written;
+
+        if (annotated) {
+            // Replace the newline with a trailing comment
+            memcpy(src + length - 1, comment, sizeof(comment));
+            length += sizeof(comment) - 2;
+        }
+    }
+
+    *size = length;
+    return src;
+}
+
+/**
+ * @brief Returns a monotonic time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,74 @@
+#ifndef CI_ARENA_H
+#define CI_ARENA_H
+#include <stddef.h>
+
+#define ARENA_FIRST_BLOCK (64 * 1024)         // Bytes in an arena's first block.
+#define ARENA_MAX_BLOCK   (16 * 1024 * 1024)  // Most bytes a block grows to.
+
+/**
+ * @brief A block of memory an arena hands out pieces of.
+ */
+typedef struct arena_block {
+    struct arena_block *next;  // The block filled before this one.
+    size_t              size;  // Bytes in `data`.
+    size_t              used;  // Bytes of `data` handed out so far.
+    unsigned char       data[];
+} ArenaBlock;
+
+/**
+ * @brief A bump allocator for memory that lives as long as a program.
+ *
+ * Pieces are carved out of large blocks in order and are never freed one by
+ * one; the whole arena is released at once. Each block is twice the size of
+ * the last, up to `ARENA_MAX_BLOCK`, so even a large program takes only a
+ * handful of allocations.
+ */
+typedef struct {
+    ArenaBlock *blocks;      // The block being filled, followed by the full ones.
+    size_t      next_block;  // Bytes in the next block to allocate.
+} Arena;
+
+/**
+ * @brief Initializes an empty arena. No memory is allocated until it is used.
+ *
+ * @param arena Pointer to the `Arena` to initialize.
+ */
+void arena_init(Arena *arena);
+
+/**
+ * @brief Frees every block of an arena, and so everything allocated from it.
+ *
+ * @param arena Pointer to the `Arena` to free. It is left empty and usable.
+ */
+void arena_free(Arena *arena);
+
+/**
+ * @brief Allocates zeroed memory from an arena, aligned for any type.
+ *
+ * @param arena Pointer to the `Arena` to allocate from.
+ * @param size The number of bytes to allocate.
+ * @return The memory, or NULL if memory ran out.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Copies a string into an arena.
+ *
+ * @param arena Pointer to the `Arena` to allocate from.
+ * @param str The characters to copy, which need not be NUL terminated.
+ * @param length The number of characters to copy.
+ * @return The NUL-terminated copy, or NULL if memory ran out.
+ */
+char *arena_copy_string(Arena *arena, const char *str, size_t length);
+
+/**
+ * @brief Moves every block of one arena into another.
+ *
+ * Whatever was allocated from `from` then lives as long as `to`.
+ *
+ * @param to Pointer to the `Arena` to move the blocks into.
+ * @param from Pointer to the `Arena` to empty.
+ */
+void arena_adopt(Arena *to, Arena *from);
+
+#endif
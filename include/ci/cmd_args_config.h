@@ -1,13 +1,34 @@
 #ifndef CI_CMD_ARGS_CONFIG_H
 #define CI_CMD_ARGS_CONFIG_H
 #include <stdbool.h>
+#include <stddef.h>
+
+#define DUMP_REGS 0x1                     // Print the flags and registers at the end of a run.
+#define DUMP_MEM  0x2                     // Print the modified memory at the end of a run.
+#define DUMP_ALL  (DUMP_REGS | DUMP_MEM)  // Print the whole final state.
 
 typedef struct {
-    bool  print_lex;     // Lex; do not parse
-    bool  print_parse;   // Print result of parsing. Implicitly performs lexing
-    bool  repl;          // Set when no arguments are supplied
-    char *in_filename;   // What are we running?
-    char *out_filename;  // File to output to
+    bool   print_lex;               // Lex; do not parse
+    bool   print_parse;             // Print result of parsing. Implicitly performs lexing
+    bool   repl;                    // Set when no arguments are supplied
+    char  *in_filename;             // What are we running?
+    char  *out_filename;            // File to output to
+    char  *mem_in_filename;         // Binary image to preload into memory
+    size_t mem_in_offset;           // Where in memory the preloaded image starts
+    char  *mem_out_filename;        // File to write the final memory contents to
+    char  *obj_filename;            // Compile to this object file instead of running
+    size_t mem_size;                // Bytes of memory available to the program
+    bool   mem_huge_pages;          // Back memory with transparent huge pages
+    bool   mem_sparse;              // Use sparse paged memory covering every address
+    bool   mem_guard;               // Catch out of range accesses with a guard page
+    bool   mem_profile;             // Record memory accesses and report on them
+    char  *mem_profile_filename;    // File to write the memory profile to, or NULL for stderr
+    bool   exec_profile;            // Count executed instructions and report on them
+    char  *exec_profile_filename;   // File to write the execution profile to, or NULL for stderr
+    int    sample_hz;               // Samples per second of CPU time to profile at, or 0 for none
+    char  *sample_folded_filename;  // File to write folded stacks to, or NULL for stderr
+    int    parse_threads;           // Threads to parse with, or 0 for one per CPU on large sources
+    int    dump;                    // What of the final state to print, a mix of DUMP_ flags
 } CmdArgsConfig;
 
 void config_free(CmdArgsConfig *conf);
@@ -18,13 +18,25 @@ typedef enum {
     BRANCH_LESS_EQUAL,
 } BranchCondition;
 
+/**
+ * @brief The base a `print` command writes its value in.
+ */
+typedef enum {
+    PRINT_DECIMAL,  // d
+    PRINT_HEX,      // x
+    PRINT_BINARY,   // b
+    PRINT_STRING,   // s, the string at the address the value holds
+} PrintBase;
+
 /**
  * @brief Union representing an operand, which can be an integer or a string.
  */
 typedef union {
-    int64_t num_val;
-    char   *str_val;
-    char    base;
+    int64_t   num_val;
+    char     *str_val;
+    char      base;
+    PrintBase print_base;  // The base of a `print` command.
+    uint8_t  *address;     // Resolved memory address of a constant-address load or store.
 } Operand;
 
 /**
@@ -46,12 +58,26 @@ typedef struct cmd {
     BranchCondition branch_condition;  // The branching condition for the command.
 } Command;
 
+struct label_map;
+struct source_location;
+struct source_map;
+
+/**
+ * @brief Finds the base a letter stands for in a `print` command.
+ *
+ * @param letter The letter: d, x, b or s.
+ * @param base A pointer to store the base in on success.
+ * @return True if the letter names a base, false otherwise.
+ */
+bool print_base_from_letter(char letter, PrintBase *base);
+
 /**
- * @brief Frees memory associated with a command.
+ * @brief Gives the letter a `print` command names a base with.
  *
- * @param command Pointer to the `Command` to be freed.
+ * @param base The base.
+ * @return The letter: d, x, b or s.
  */
-void free_command(Command *command);
+char print_base_letter(PrintBase base);
 
 /**
  * @brief Prints the details of a command.
@@ -60,8 +86,11 @@ void free_command(Command *command);
  * destination, and branching condition, in a human-readable format.
  *
  * @param cmd Pointer to the `Command` to print.
+ * @param labels Pointer to the label map naming the labels branched to.
+ * @param location Where the command is in the source, or NULL if unknown.
  */
-void print_command(Command *cmd);
+void print_command(Command *cmd, const struct label_map *labels,
+                   const struct source_location *location);
 
 /**
  * @brief Prints the details of a single operand.
@@ -82,7 +111,10 @@ void print_command_op(Operand op, bool is_imm, bool is_str);
  * format.
  *
  * @param cmd Pointer to the first `Command` in the list.
+ * @param labels Pointer to the label map naming the labels branched to.
+ * @param locations Pointer to the source map of the list, or NULL.
  */
-void print_commands(Command *cmd);
+void print_commands(Command *cmd, const struct label_map *labels,
+                    const struct source_map *locations);
 
 #endif
@@ -89,6 +89,29 @@ typedef enum {
     // sub x0 x1 5
     // Can either be variable variable variable or variable variable number
     CMD_SUB,
+
+    // Fixed-width forms of CMD_LOAD and CMD_STORE, substituted after linking
+    // when the size is 1, 2, 4 or 8. Operands are laid out as in the generic
+    // forms.
+    CMD_LOAD8,
+    CMD_LOAD16,
+    CMD_LOAD32,
+    CMD_LOAD64,
+    CMD_STORE8,
+    CMD_STORE16,
+    CMD_STORE32,
+    CMD_STORE64,
+
+    // Fixed-width forms whose constant address was bounds-checked when they
+    // were substituted; val_b holds the resolved pointer into memory.
+    CMD_LOAD8_ABS,
+    CMD_LOAD16_ABS,
+    CMD_LOAD32_ABS,
+    CMD_LOAD64_ABS,
+    CMD_STORE8_ABS,
+    CMD_STORE16_ABS,
+    CMD_STORE32_ABS,
+    CMD_STORE64_ABS,
 } CommandType;
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef CI_COUNTER_TABLE_H
+#define CI_COUNTER_TABLE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief An open addressing table of fixed size records keyed by a nonzero
+ * 64 bit key, such as a command's address, for the profilers to count into.
+ *
+ * Keys are probed linearly and the table doubles whenever it becomes half
+ * full. A record starts zeroed when its key is added.
+ */
+typedef struct {
+    uint64_t *keys;      // The key of each slot, or zero where a slot is empty.
+    void     *records;   // The record of each slot.
+    size_t    size;      // Bytes in one record.
+    size_t    count;     // Slots in use.
+    size_t    capacity;  // Slots in the table, zero or a power of two.
+} CounterTable;
+
+/**
+ * @brief Initializes an empty table.
+ *
+ * @param table Pointer to the `CounterTable` to initialize.
+ * @param size The size of one record.
+ */
+void counter_table_init(CounterTable *table, size_t size);
+
+/**
+ * @brief Frees the slots of a table, leaving it empty.
+ *
+ * @param table Pointer to the `CounterTable` to free.
+ */
+void counter_table_free(CounterTable *table);
+
+/**
+ * @brief Finds the record of a key.
+ *
+ * @param table Pointer to the `CounterTable` to search.
+ * @param key The key, which must not be zero.
+ * @return The record, or NULL if the key is not in the table.
+ */
+void *counter_table_find(const CounterTable *table, uint64_t key);
+
+/**
+ * @brief Finds the record of a key, adding a zeroed one if the key is new.
+ *
+ * @param table Pointer to the `CounterTable` to add to.
+ * @param key The key, which must not be zero.
+ * @return The record, valid until the next key is added, or NULL if the table
+ * could not grow.
+ */
+void *counter_table_add(CounterTable *table, uint64_t key);
+
+/**
+ * @brief Copies every record into an array, in no particular order, so it
+ * can be ranked while the table stays usable for lookups.
+ *
+ * @param table Pointer to the `CounterTable` to copy.
+ * @return An array of `count` records, or NULL if it could not be allocated.
+ * The caller frees it.
+ */
+void *counter_table_copy(const CounterTable *table);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef CI_DECODE_H
+#define CI_DECODE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Decodes a run of decimal digits.
+ *
+ * Full groups of eight digits are converted at once in a 64-bit word.
+ *
+ * @param digits The first digit, most significant first.
+ * @param count The number of digits, all of which must be `0` to `9`.
+ * @return The value, or `INT64_MAX` if it is larger.
+ */
+int64_t decode_decimal(const char *digits, size_t count);
+
+/**
+ * @brief Decodes a run of hexadecimal digits, in either case.
+ *
+ * @param digits The first digit, most significant first.
+ * @param count The number of digits, all of which must be hexadecimal.
+ * @return The value, or `INT64_MAX` if it is larger.
+ */
+int64_t decode_hex(const char *digits, size_t count);
+
+/**
+ * @brief Decodes a run of binary digits.
+ *
+ * @param digits The first digit, most significant first.
+ * @param count The number of digits, all of which must be `0` or `1`.
+ * @return The value, or `INT64_MAX` if it is larger.
+ */
+int64_t decode_binary(const char *digits, size_t count);
+
+#endif
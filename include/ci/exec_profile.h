@@ -0,0 +1,87 @@
+#ifndef CI_EXEC_PROFILE_H
+#define CI_EXEC_PROFILE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "command.h"
+#include "counter_table.h"
+#include "label_map.h"
+#include "source_map.h"
+
+#define EXEC_PROFILE_TOP 20  // Instructions shown in the hottest instructions ranking.
+
+/**
+ * @brief Execution counts for one instruction.
+ */
+typedef struct {
+    const Command *command;  // The instruction.
+    uint64_t       count;    // Times the instruction ran.
+    uint64_t       taken;    // Times a branch jumped; the rest of `count` fell through.
+} ExecSiteCount;
+
+/**
+ * @brief Everything recorded about which instructions a program ran.
+ */
+typedef struct {
+    CounterTable sites;         // An `ExecSiteCount` per instruction run, keyed by its address.
+    uint64_t     instructions;  // Instructions run so far.
+    double       started;       // When the run started, in seconds.
+    double       seconds;       // How long the run took.
+    bool         incomplete;    // Set if an allocation failed and counts were lost.
+} ExecProfile;
+
+/**
+ * @brief Initializes an empty profile.
+ *
+ * @param profile Pointer to the `ExecProfile` to initialize.
+ */
+void exec_profile_init(ExecProfile *profile);
+
+/**
+ * @brief Frees everything recorded in a profile.
+ *
+ * @param profile Pointer to the `ExecProfile` to free.
+ */
+void exec_profile_free(ExecProfile *profile);
+
+/**
+ * @brief Notes the time a run starts at.
+ *
+ * @param profile Pointer to the `ExecProfile` to time.
+ */
+void exec_profile_start(ExecProfile *profile);
+
+/**
+ * @brief Adds the time since `exec_profile_start` to the run time.
+ *
+ * @param profile Pointer to the `ExecProfile` to time.
+ */
+void exec_profile_stop(ExecProfile *profile);
+
+/**
+ * @brief Counts one execution of an instruction.
+ *
+ * @param profile Pointer to the `ExecProfile` to record into.
+ * @param cmd The instruction about to run.
+ * @return The counts of the instruction, valid until the next call, or NULL if
+ * they could not be allocated.
+ */
+ExecSiteCount *exec_profile_count(ExecProfile *profile, const Command *cmd);
+
+/**
+ * @brief Writes a report of the instruction count and rate, the opcode mix and
+ * the hottest instructions with their source lines and branch outcomes.
+ *
+ * @param profile Pointer to the `ExecProfile` to report on.
+ * @param commands The program, used to number the instructions in the report.
+ * @param labels The labels of the program, used to name where instructions are.
+ * @param locations The source map of the program, giving the line of each
+ * instruction, or NULL.
+ * @param out The stream to write to.
+ */
+void exec_profile_report(ExecProfile *profile, Command *commands, const LabelMap *labels,
+                         const SourceMap *locations, FILE *out);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef CI_FORMAT_H
+#define CI_FORMAT_H
+#include <stddef.h>
+#include <stdint.h>
+
+#define FORMAT_DECIMAL_MAX 20  // Most characters of a decimal int64_t: a sign and 19 digits.
+#define FORMAT_HEX_MAX     16  // Most characters of a hex uint64_t.
+#define FORMAT_BINARY_MAX  64  // Most characters of a binary uint64_t.
+
+/**
+ * @brief Writes a number in decimal, as `printf("%" PRId64)` would.
+ *
+ * Digits are produced two at a time from a table of every pair.
+ *
+ * @param out Where to write, with room for `FORMAT_DECIMAL_MAX` characters.
+ * @param value The number to write.
+ * @return The number of characters written; no NUL is added.
+ */
+size_t format_decimal(char *out, int64_t value);
+
+/**
+ * @brief Writes a number in lowercase hex, as `printf("%" PRIx64)` would.
+ *
+ * @param out Where to write, with room for `FORMAT_HEX_MAX` characters.
+ * @param value The number to write.
+ * @return The number of characters written; no NUL is added.
+ */
+size_t format_hex(char *out, uint64_t value);
+
+/**
+ * @brief Writes a number in lowercase hex padded with zeros, as
+ * `printf("%0*" PRIx64)` would.
+ *
+ * @param out Where to write, with room for `FORMAT_HEX_MAX` characters or
+ * `width`, whichever is more.
+ * @param value The number to write.
+ * @param width The fewest digits to write.
+ * @return The number of characters written; no NUL is added.
+ */
+size_t format_hex_padded(char *out, uint64_t value, int width);
+
+/**
+ * @brief Writes bytes as pairs of lowercase hex digits, taken from a table.
+ *
+ * @param out Where to write, with room for two characters per byte.
+ * @param bytes The bytes to write.
+ * @param count The number of bytes.
+ */
+void format_hex_bytes(char *out, const uint8_t *bytes, size_t count);
+
+/**
+ * @brief Writes a number in binary, with no leading zeros.
+ *
+ * The digits are counted from the leading zero bits and then produced eight
+ * at a time, each byte of the number spread into eight characters at once.
+ *
+ * @param out Where to write, with room for `FORMAT_BINARY_MAX` characters.
+ * @param value The number to write.
+ * @return The number of characters written; no NUL is added.
+ */
+size_t format_binary(char *out, uint64_t value);
+
+#endif
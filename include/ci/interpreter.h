@@ -1,7 +1,10 @@
 #ifndef CI_INTERPRETER_H
 #define CI_INTERPRETER_H
 #include "command.h"
+#include "exec_profile.h"
 #include "label_map.h"
+#include "mem_profile.h"
+#include "sample_profile.h"
 
 #define NUM_VARIABLES 32  // Maximum number of defined variables.
 
@@ -25,9 +28,18 @@ typedef struct {
     LabelMap *label_map;               // Pointer to the map of labels for branch resolution.
     bool      is_greater;              //  Flag indicating the result of the last comparison
                                        //  (greater).
-    bool        is_less;               // Flag indicating the result of the last comparison (less).
-    bool        is_equal;              // Flag indicating the result of the last comparison (equal).
-    StackEntry *the_stack;             // Pointer to the top of the interpreter's stack.
+    bool           is_less;            // Flag indicating the result of the last comparison (less).
+    bool           is_equal;           // Flag indicating the result of the last comparison (equal).
+    StackEntry    *the_stack;          // Pointer to the top of the interpreter's stack.
+    MemProfile    *mem_profile;        // Records memory accesses when set; NULL by default.
+    ExecProfile   *exec_profile;       // Counts executed instructions when set; NULL by default.
+    SampleProfile *sample_profile;     // Samples where the run is when set; NULL by default.
+    const Command *error_command;      // The command a runtime error stopped at, or NULL.
+    const char    *error;              // What the runtime error was, or NULL for none.
+
+    // The command accessing guarded memory, set before each access so a fault,
+    // which jumps out of the engine, can still report where it happened.
+    const Command *volatile guarded_command;
 } Interpreter;
 
 /**
@@ -38,6 +50,21 @@ typedef struct {
  */
 void interpreter_init(Interpreter *intr, LabelMap *map);
 
+/**
+ * @brief Rewrites loads and stores into their fixed-width forms.
+ *
+ * Must run after memory is initialized and before the commands are
+ * interpreted. Accesses with a valid size become fixed-width commands, and
+ * if `resolve` is set those whose constant address is in bounds also resolve
+ * it once here instead of on every execution. Invalid accesses keep their
+ * generic form so they still fail at runtime.
+ *
+ * @param commands Pointer to the first `Command` in the list to rewrite.
+ * @param resolve Whether to resolve constant addresses. Resolved accesses are
+ * not seen by a memory profile.
+ */
+void specialize_commands(Command *commands, bool resolve);
+
 /**
  * @brief Executes a list of commands using the interpreter.
  *
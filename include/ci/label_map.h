@@ -1,32 +1,44 @@
 #ifndef CI_LABEL_MAP_H
 #define CI_LABEL_MAP_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
 #include "command.h"
 
 /**
- * @brief Represents an entry in the label map.
+ * @brief Represents a label in the label map.
  *
- * Each entry contains an identifier (label), a corresponding command,
- * and a pointer to the next entry in the chain used for handling collisions.
+ * Each label is interned once and then referred to by its symbol ID, the index
+ * of its entry in the map.
  */
 typedef struct entry {
-    char         *id;       // The identifier for this label.
-    Command      *command;  // The command associated with this label.
-    struct entry *next;     // Pointer to the next entry in the chain.
+    char     *id;       // The identifier for this label.
+    Command  *command;  // The command associated with this label, or NULL.
+    uint32_t  hash;     // The hash of `id`.
+    uint32_t  length;   // The number of characters in `id`.
 } Entry;
 
 /**
- * @brief Represents a hash map for managing labels.
+ * @brief Represents a symbol table for managing labels.
+ *
+ * Labels are found through an open-addressed table of symbol IDs, probed
+ * linearly and doubled whenever it becomes half full.
  */
-typedef struct {
-    Entry **entries;   // Array of pointers to entry chains.
-    int     capacity;  // The number of buckets in the map.
+typedef struct label_map {
+    Entry   *entries;     // The labels, indexed by symbol ID in the order they were added.
+    int      count;       // The number of labels.
+    int      capacity;    // The number of entries allocated.
+    int32_t *slots;       // Symbol IDs by hash, or -1 where a slot is empty.
+    size_t   slot_count;  // The number of slots, a power of two.
+    Arena    names;       // Holds the identifiers of the labels.
 } LabelMap;
 
 /**
- * @brief Initializes a label map with the specified capacity.
+ * @brief Initializes a label map with room for the specified number of labels.
  *
  * @param map Pointer to the `LabelMap` to initialize.
- * @param capacity The number of buckets to allocate for the map.
+ * @param capacity The number of labels to make room for; the map grows past it.
  * @return true if the map was successfully initialized, false otherwise.
  */
 bool label_map_init(LabelMap *map, int capacity);
@@ -41,6 +53,18 @@ bool label_map_init(LabelMap *map, int capacity);
  */
 void label_map_free(LabelMap *map);
 
+/**
+ * @brief Finds the symbol ID of a label, adding it if it is new.
+ *
+ * A new label has no command until one is put on it.
+ *
+ * @param map Pointer to the label map.
+ * @param id The identifier for the label, which need not be NUL terminated.
+ * @param length The number of characters in `id`.
+ * @return The symbol ID of the label, or -1 if memory ran out.
+ */
+int intern_label(LabelMap *map, const char *id, size_t length);
+
 /**
  * @brief Inserts a label and its associated command into the map.
  *
@@ -52,17 +76,18 @@ void label_map_free(LabelMap *map);
  * @param command Pointer to the `Command` associated with the label.
  * @return true if the label was successfully added, false otherwise.
  */
-bool put_label(LabelMap *map, char *id, Command *command);
+bool put_label(LabelMap *map, const char *id, Command *command);
 
 /**
  * @brief Retrieves a label's entry from the map.
  *
  * Searches the label map for the given ID and returns the associated entry.
+ * The entry moves when labels are added, so it should not be kept.
  *
  * @param map Pointer to the label map.
  * @param id The identifier for the label to retrieve.
  * @return A pointer to the `Entry` if the label exists, or NULL if not found.
  */
-Entry *get_label(LabelMap *map, char *id);
+Entry *get_label(LabelMap *map, const char *id);
 
 #endif
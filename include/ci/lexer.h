@@ -1,7 +1,32 @@
 #ifndef CI_LEXER_H
 #define CI_LEXER_H
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "token.h"
 
+#ifndef LEXER_CHUNK_SIZE
+#define LEXER_CHUNK_SIZE 65536  // Bytes read from a stream at a time.
+#endif
+
+#define LEXER_RETAIN_TOKENS 3  // Tokens lexed before a replaced chunk is freed.
+
+/**
+ * @brief Reads up to `size` bytes of source into `buffer`.
+ *
+ * @return The number of bytes read; 0 at the end of the source or on error.
+ */
+typedef size_t (*LexerRead)(void *context, char *buffer, size_t size);
+
+/**
+ * @brief A chunk of streamed source text.
+ */
+typedef struct lexer_buffer {
+    struct lexer_buffer *next;    // The chunk replaced before this one.
+    long                 stamp;   // Tokens lexed when this chunk was replaced.
+    char                 text[];  // The source text, followed by a NUL.
+} LexerBuffer;
+
 /**
  * @brief Represents the state of a lexical analyzer.
  */
@@ -12,9 +37,20 @@ typedef struct {
                                    // source string, I.e, the character that is
                                    // about to be consumed.
 
+    const char *end_position;  // One past the last character of the source string,
+                               // where a NUL stops every scan. Moved back onto
+                               // an earlier NUL once the lexer reaches it.
+
     int current_line;  // The current line number in the source string.
 
     int current_column;  // The current column number in the source string.
+
+    LexerRead    read;          // Refills a streamed source; NULL for a whole string.
+    void        *read_context;  // Passed to `read`.
+    bool         exhausted;     // Set once `read` has reported the end of the source.
+    LexerBuffer *buffer;        // The chunk being lexed from a stream.
+    LexerBuffer *retired;       // Replaced chunks that tokens may still point into.
+    long         tokens;        // Number of tokens lexed so far.
 } Lexer;
 
 /**
@@ -25,6 +61,45 @@ typedef struct {
  */
 void lexer_init(Lexer *lex, const char *text);
 
+/**
+ * @brief Initializes the given lexer with a run of whole lines of a source.
+ *
+ * The lines are lexed as if they were all there is, so lines and columns count
+ * from their start. The run must end with a newline or at the NUL ending the
+ * source; the character after it is peeked at but never consumed. A NUL
+ * within them ends the source when the lexer reaches it, so the rest of the
+ * text is never read.
+ *
+ * @param lex The input stream to initialize.
+ * @param text A pointer to the first line.
+ * @param length The number of characters in the lines.
+ */
+void lexer_init_lines(Lexer *lex, const char *text, size_t length);
+
+/**
+ * @brief Initializes the given lexer to read its source through a callback.
+ *
+ * The source is read in chunks of about `LEXER_CHUNK_SIZE` bytes, so memory
+ * use stays bounded however long it is. A token is never split across chunks,
+ * and its lexeme stays valid until `LEXER_RETAIN_TOKENS` more tokens have been
+ * lexed. A NUL byte ends the source, as it does for `lexer_init`.
+ *
+ * @param lex The input stream to initialize.
+ * @param read The callback that reads the next part of the source.
+ * @param context Passed to every call of `read`.
+ */
+void lexer_init_stream(Lexer *lex, LexerRead read, void *context);
+
+/**
+ * @brief Frees the chunks held by a streaming lexer.
+ *
+ * Tokens lexed from a stream are invalid afterwards. Does nothing for a lexer
+ * made with `lexer_init`.
+ *
+ * @param lex The lexer to free.
+ */
+void lexer_free(Lexer *lex);
+
 /**
  * @brief Yields the next token in the input stream.
  *
@@ -3,8 +3,84 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
-#define MEM_CAPACITY 1024  // Maximum capacity of available memory.
+#define MEM_DEFAULT_CAPACITY 1024  // Capacity of memory when none is requested.
+#define MEM_PAGE_BITS        12    // Memory is allocated and tracked in 4 KiB pages.
+
+/**
+ * @brief The ways memory can be backed.
+ */
+typedef enum {
+    MEM_BACKEND_FLAT,    // One contiguous, bounds-checked region.
+    MEM_BACKEND_SPARSE,  // 4 KiB pages covering the full 64-bit address space,
+                         // allocated on first write.
+    MEM_BACKEND_GUARD,   // One contiguous region followed by an inaccessible guard
+                         // page; out of range accesses fault instead of being
+                         // bounds-checked.
+} MemBackend;
+
+/**
+ * @brief Guarded memory, laid open for the interpreter to access directly.
+ *
+ * An access clamps its address to at most `size` and copies its bytes at
+ * `base` plus the address. Whatever starts at or runs past `size` lands on the
+ * guard page and faults. A store then marks the first and last page it wrote
+ * in `dirty`.
+ */
+typedef struct {
+    uint8_t  *base;   // The first addressable byte; the guard page starts at `base + size`.
+    size_t    size;   // The number of addressable bytes.
+    uint64_t *dirty;  // One bit per `MEM_PAGE_BITS` page that may hold non-zero bytes.
+} MemGuardRegion;
+
+/**
+ * @brief Reserves the memory available to programs.
+ *
+ * Flat memory is backed by an anonymous mapping, so untouched pages cost
+ * nothing and start out zeroed; reserving a large capacity takes the same time
+ * as a small one. Sparse memory ignores `capacity` and `huge_pages`: every
+ * address is valid, and reads of pages never written return zero.
+ *
+ * @param kind The backend to use.
+ * @param capacity The number of addressable bytes.
+ * @param huge_pages Whether to ask for transparent huge pages.
+ * @return True if the memory was reserved, false otherwise.
+ */
+bool mem_init(MemBackend kind, size_t capacity, bool huge_pages);
+
+/**
+ * @brief Releases the memory reserved by `mem_init`.
+ */
+void mem_free(void);
+
+/**
+ * @brief Returns the number of addressable bytes of memory.
+ *
+ * @return The capacity passed to `mem_init`, or SIZE_MAX for sparse memory.
+ */
+size_t mem_capacity(void);
+
+/**
+ * @brief Runs the given function, turning guard page faults into an error.
+ *
+ * With guarded memory, a load or store out of range faults rather than
+ * returning false. Such a fault abandons `body` and makes this function return
+ * false. With other backends `body` simply runs.
+ *
+ * @param body The function performing memory accesses.
+ * @param context The argument passed to `body`.
+ * @return True if `body` ran to completion, false if it hit the guard.
+ */
+bool mem_run_guarded(void (*body)(void *), void *context);
+
+/**
+ * @brief Gives guarded memory's region, for accesses made inline.
+ *
+ * @param region Pointer to the `MemGuardRegion` to fill in.
+ * @return True if memory is guarded, false for the other backends.
+ */
+bool mem_guard_region(MemGuardRegion *region);
 
 /**
  * @brief Loads the value from memory into the given destination.
@@ -26,9 +102,75 @@ bool mem_load(uint8_t *destination, size_t offset, size_t bytes);
  */
 bool mem_store(uint8_t *source, size_t offset, size_t bytes);
 
+/**
+ * @brief Stores an arbitrary number of bytes starting at the given address.
+ *
+ * The range is validated once and copied in bulk. If it runs past the end of
+ * memory, the bytes that do fit are still stored.
+ *
+ * @param source The bytes to store.
+ * @param offset The offset in memory where to start storing.
+ * @param bytes The number of bytes to store.
+ * @return True if every byte was stored, false otherwise.
+ */
+bool mem_store_range(const uint8_t *source, size_t offset, size_t bytes);
+
+/**
+ * @brief Finds the length of the NUL-terminated string at the given address.
+ *
+ * @param offset The address of the first character.
+ * @param length A pointer to store the length, excluding the NUL, in.
+ * @return True if a terminating NUL lies within memory, false otherwise.
+ */
+bool mem_find_nul(size_t offset, size_t *length);
+
+/**
+ * @brief Writes a range of memory directly to the output.
+ *
+ * @param offset The address of the first byte.
+ * @param bytes The number of bytes to write.
+ * @return True if the whole range was in memory and written, false otherwise.
+ */
+bool mem_write_range(size_t offset, size_t bytes);
+
+/**
+ * @brief Resolves an in-range address to a pointer into memory.
+ *
+ * The pointer stays valid until memory is freed, letting accesses whose
+ * address is known in advance skip validation. If the bytes may be stored to,
+ * they are treated as modified from now on.
+ *
+ * @param offset The address of the first byte.
+ * @param bytes The number of bytes that will be accessed.
+ * @param for_store Whether the bytes will be stored to.
+ * @return The pointer, or NULL if the range is out of bounds or memory is not
+ * contiguous.
+ */
+uint8_t *mem_resolve(size_t offset, size_t bytes, bool for_store);
+
 /**
  * @brief Prints the memory state to the console
  */
 void mem_print(void);
 
+/**
+ * @brief Copies the contents of a binary image file into memory.
+ *
+ * The whole file is copied verbatim starting at `offset`. The image must fit
+ * entirely within the available memory.
+ *
+ * @param path The path of the image file to read.
+ * @param offset The offset in memory where the image should be placed.
+ * @return True if the image was loaded, false otherwise.
+ */
+bool mem_load_image(const char *path, size_t offset);
+
+/**
+ * @brief Writes the full contents of memory to a binary image file.
+ *
+ * @param path The path of the image file to write.
+ * @return True if the image was written, false otherwise.
+ */
+bool mem_save_image(const char *path);
+
 #endif
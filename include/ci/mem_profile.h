@@ -0,0 +1,107 @@
+#ifndef CI_MEM_PROFILE_H
+#define CI_MEM_PROFILE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "command.h"
+#include "counter_table.h"
+#include "source_map.h"
+
+#define MEM_PROFILE_LINE_BITS 6     // Accesses are counted per 64 byte cache line.
+#define MEM_PROFILE_WINDOW    1024  // Accesses per working set sample.
+#define MEM_PROFILE_TOP       10    // Entries shown in each ranking of the report.
+
+/**
+ * @brief The kinds of memory access a program can make.
+ */
+typedef enum {
+    MEM_ACCESS_LOAD,   // A `load` of 1 to 8 bytes.
+    MEM_ACCESS_STORE,  // A `store` of 1 to 8 bytes.
+    MEM_ACCESS_PUT,    // A `put` of a whole string.
+    MEM_ACCESS_PRINT,  // A string `print` read straight out of memory.
+} MemAccess;
+
+/**
+ * @brief Read and write counts for one cache line.
+ */
+typedef struct {
+    uint64_t line;    // Line number.
+    uint64_t reads;   // Accesses that read from the line.
+    uint64_t writes;  // Accesses that wrote to the line.
+    uint64_t window;  // The last working set window the line was touched in.
+} MemLineCount;
+
+/**
+ * @brief Access statistics for one instruction.
+ */
+typedef struct {
+    const Command *command;  // The instruction.
+    MemAccess      kind;     // What the instruction does to memory.
+    uint64_t       count;    // Number of accesses made.
+    size_t         last;     // Address of the previous access.
+    int64_t        stride;   // Most frequent distance between accesses so far.
+    uint64_t       votes;    // Majority vote weight backing `stride`.
+    uint64_t       matches;  // Accesses that were `stride` bytes after the previous one.
+} MemSiteCount;
+
+/**
+ * @brief Everything recorded about a program's memory accesses.
+ */
+typedef struct {
+    CounterTable lines;            // A `MemLineCount` per line touched, keyed by line plus one.
+    CounterTable sites;            // A `MemSiteCount` per instruction, keyed by its address.
+    uint64_t     loads[5];         // Loads of 1, 2, 4, 8 and other byte counts.
+    uint64_t     stores[5];        // Stores of 1, 2, 4, 8 and other byte counts.
+    uint64_t     bulk[2];          // Number of puts and string prints.
+    uint64_t     bulk_bytes[2];    // Bytes moved by puts and string prints.
+    uint64_t     accesses;         // Accesses recorded so far.
+    uint64_t     window;           // The current working set window, starting at 1.
+    uint64_t     window_lines;     // Distinct lines touched in the current window.
+    uint64_t    *working_set;      // Distinct lines touched in each finished window.
+    size_t       window_count;     // Finished windows.
+    size_t       window_capacity;  // Windows `working_set` has room for.
+    bool         incomplete;       // Set if an allocation failed and accesses were lost.
+} MemProfile;
+
+/**
+ * @brief Initializes an empty profile.
+ *
+ * @param profile Pointer to the `MemProfile` to initialize.
+ */
+void mem_profile_init(MemProfile *profile);
+
+/**
+ * @brief Frees everything recorded in a profile.
+ *
+ * @param profile Pointer to the `MemProfile` to free.
+ */
+void mem_profile_free(MemProfile *profile);
+
+/**
+ * @brief Records one memory access.
+ *
+ * @param profile Pointer to the `MemProfile` to record into.
+ * @param cmd The instruction making the access.
+ * @param kind What the access does.
+ * @param offset The address of the first byte accessed.
+ * @param bytes The number of bytes accessed.
+ */
+void mem_profile_record(MemProfile *profile, const Command *cmd, MemAccess kind, size_t offset,
+                        size_t bytes);
+
+/**
+ * @brief Writes a report of the hottest lines, per-instruction strides, size
+ * mix and working set over time.
+ *
+ * @param profile Pointer to the `MemProfile` to report on.
+ * @param commands The program, used to number the instructions in the report.
+ * @param locations The source map of the program, giving the line of each
+ * instruction, or NULL.
+ * @param out The stream to write to.
+ */
+void mem_profile_report(MemProfile *profile, Command *commands, const SourceMap *locations,
+                        FILE *out);
+
+#endif
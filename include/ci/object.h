@@ -0,0 +1,83 @@
+#ifndef CI_OBJECT_H
+#define CI_OBJECT_H
+#include <stdbool.h>
+#include "arena.h"
+#include "command.h"
+#include "label_map.h"
+#include "string_list.h"
+
+/**
+ * @brief Represents the set of object files linked into a program.
+ *
+ * Every object keeps its own command list, terminated like the main program's,
+ * so that falling off the end of one module never runs into another. Library
+ * code is only ever reached through its exported labels.
+ */
+typedef struct {
+    Command  **modules;   // Heads of the command lists of every linked object.
+    StringList paths;     // Paths of the linked objects, used to skip repeats.
+    StringList externs;   // Labels the linked objects expect another module to define.
+    Arena      arena;     // Holds the commands of every linked object and their strings.
+    int        count;     // The number of linked objects.
+    int        capacity;  // The number of objects `modules` can hold before growing.
+} ModuleList;
+
+/**
+ * @brief Writes a parsed module to a relocatable object file.
+ *
+ * The object holds the module's commands, every label it defines or
+ * references, and the `extern` and `include` directives it contained.
+ *
+ * @param path The path of the object file to write.
+ * @param commands Pointer to the first `Command` of the module.
+ * @param map Pointer to the label map produced while parsing the module.
+ * @param externs The labels declared with `extern` in the module.
+ * @param includes The object files named by `include` in the module.
+ * @return True if the object was written, false otherwise.
+ */
+bool object_write(const char *path, Command *commands, LabelMap *map, const StringList *externs,
+                  const StringList *includes);
+
+/**
+ * @brief Initializes an empty module list.
+ *
+ * @param mods Pointer to the `ModuleList` to initialize.
+ */
+void module_list_init(ModuleList *mods);
+
+/**
+ * @brief Frees every linked module along with the list itself.
+ *
+ * @param mods Pointer to the `ModuleList` to free.
+ */
+void module_list_free(ModuleList *mods);
+
+/**
+ * @brief Loads the given object files and links them into the label map.
+ *
+ * Objects named by `include` directives inside the loaded objects are linked
+ * as well, and every object is linked at most once. An object exports the
+ * labels it defines that the program or any linked object declares `extern`;
+ * an exported label that is already defined elsewhere is reported as a
+ * duplicate symbol. Its other labels stay local to it, so two modules may
+ * each have their own label of the same name.
+ *
+ * @param mods Pointer to the `ModuleList` receiving the loaded modules.
+ * @param map Pointer to the program's label map.
+ * @param includes The object files to link.
+ * @param externs The labels the program declares `extern`.
+ * @return True if every object was linked, false otherwise.
+ */
+bool link_objects(ModuleList *mods, LabelMap *map, const StringList *includes,
+                  const StringList *externs);
+
+/**
+ * @brief Verifies that every `extern` label is defined by some module.
+ *
+ * @param map Pointer to the fully linked label map.
+ * @param externs The labels that must be defined.
+ * @return True if every label resolved, false otherwise.
+ */
+bool check_externs(LabelMap *map, const StringList *externs);
+
+#endif
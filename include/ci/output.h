@@ -0,0 +1,115 @@
+#ifndef CI_OUTPUT_H
+#define CI_OUTPUT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)  // Bytes gathered before a write to a descriptor.
+
+/**
+ * @brief The places output can be sent.
+ */
+typedef enum {
+    OUTPUT_SINK_STDOUT,  // Standard output, written with write(2).
+    OUTPUT_SINK_FD,      // A file descriptor the output takes over and closes.
+    OUTPUT_SINK_MEMORY,  // A growing buffer, for embedders to read back.
+} OutputSink;
+
+/**
+ * @brief Directs all output to a sink.
+ *
+ * Output is gathered in a buffer and only handed to the sink when the buffer
+ * fills, on `output_flush` and on `output_free`, so printing costs no system
+ * call and no stdio lock. Before this is called, output is written straight to
+ * standard output. The output is not thread-safe.
+ *
+ * @param sink The sink to use.
+ * @param fd The descriptor to write to for `OUTPUT_SINK_FD`, ignored otherwise.
+ * @return True on success, false if the buffer could not be allocated.
+ */
+bool output_init(OutputSink sink, int fd);
+
+/**
+ * @brief Flushes the output and releases the sink.
+ *
+ * Closes the descriptor of an `OUTPUT_SINK_FD` sink and drops what an
+ * `OUTPUT_SINK_MEMORY` sink holds. Later output is written straight to
+ * standard output again.
+ *
+ * @return True if everything written since `output_init` reached the sink.
+ */
+bool output_free(void);
+
+/**
+ * @brief Hands everything buffered to the sink.
+ *
+ * Called before anything is written around the output, such as to stderr or
+ * an interactive prompt, and before a failing run ends.
+ *
+ * @return True if everything written so far reached the sink.
+ */
+bool output_flush(void);
+
+/**
+ * @brief Appends bytes to the output.
+ *
+ * @param data The bytes to write.
+ * @param length The number of bytes.
+ */
+void output_write(const void *data, size_t length);
+
+/**
+ * @brief Appends a single character to the output.
+ *
+ * @param c The character to write.
+ */
+void output_char(char c);
+
+/**
+ * @brief Appends a NUL terminated string to the output.
+ *
+ * @param text The string to write.
+ */
+void output_string(const char *text);
+
+/**
+ * @brief Appends formatted text to the output, as `printf` would print it.
+ *
+ * @param format The format string.
+ */
+void output_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Appends a number in decimal, formatted in place in the buffer.
+ *
+ * @param value The number to write.
+ */
+void output_decimal(int64_t value);
+
+/**
+ * @brief Appends a number in lowercase hex with no prefix, formatted in place
+ * in the buffer.
+ *
+ * @param value The number to write.
+ */
+void output_hex(uint64_t value);
+
+/**
+ * @brief Appends a number in binary with no prefix, formatted in place in the
+ * buffer.
+ *
+ * @param value The number to write.
+ */
+void output_binary(uint64_t value);
+
+/**
+ * @brief Returns what an `OUTPUT_SINK_MEMORY` sink holds.
+ *
+ * The contents move as more is written, so they should not be kept.
+ *
+ * @param length A pointer to store the number of bytes in.
+ * @return The bytes written so far, or NULL for any other sink.
+ */
+const char *output_contents(size_t *length);
+
+#endif
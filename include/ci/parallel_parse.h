@@ -0,0 +1,46 @@
+#ifndef CI_PARALLEL_PARSE_H
+#define CI_PARALLEL_PARSE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "command.h"
+#include "label_map.h"
+#include "parser.h"
+#include "source_map.h"
+
+#define PARALLEL_PARSE_MIN_CHUNK   (1024 * 1024)  // Fewest bytes worth a thread of their own.
+#define PARALLEL_PARSE_MAX_THREADS 64             // Most threads a source is parsed on.
+
+/**
+ * @brief Lexes and parses a whole source on several threads.
+ *
+ * The source is split into chunks of whole lines, and each chunk is lexed and
+ * parsed on its own thread into a command list and a log of its labels. The
+ * lists are then joined and the logs applied to `map` in source order, so the
+ * commands and labels are exactly those `parse_commands` gives. A label at the
+ * end of a chunk points at the first command of the chunks after it. A chunk
+ * whose lexer stopped at a NUL ends the source, and the chunks after it are
+ * dropped.
+ *
+ * @param parser Pointer to the `Parser` to initialize. On success it holds the
+ * externs and includes of the whole source and is at its end.
+ * @param source The source, followed by a NUL.
+ * @param length The number of characters in the source.
+ * @param map Pointer to the `LabelMap` to add the labels to.
+ * @param arena Pointer to the `Arena` to hand the commands over to.
+ * @param locations Pointer to the `SourceMap` to add the location of every
+ * command to, or NULL.
+ * @param threads The number of threads to use, or 0 for up to one per CPU with
+ * at least `PARALLEL_PARSE_MIN_CHUNK` bytes each.
+ * @param commands A pointer to store the head of the command list in.
+ * @return True if the source was parsed. False, with nothing changed, if it was
+ * not worth splitting, a chunk boundary fell inside a string, a chunk did not
+ * parse or a label was defined in two chunks; the source should then be parsed
+ * with `parse_commands`, which also reports any error where it is.
+ */
+bool parse_commands_parallel(Parser *parser, const char *source, size_t length, LabelMap *map,
+                             Arena *arena, SourceMap *locations, int threads,
+                             Command **commands);
+
+#endif
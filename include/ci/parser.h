@@ -1,47 +1,120 @@
 #ifndef CI_PARSER_H
 #define CI_PARSER_H
+#include "arena.h"
 #include "command.h"
 #include "label_map.h"
 #include "lexer.h"
+#include "source_map.h"
+#include "string_list.h"
 #include "token.h"
+#include "token_buffer.h"
+
+/**
+ * @brief A label definition, recorded to be made later.
+ */
+typedef struct {
+    int      symbol;   // The symbol ID of the label in the parser's label map.
+    Command *command;  // The command the label is on, or NULL at the end of the source.
+} LabelRecord;
+
+/**
+ * @brief The label definitions a parser would have made, in order.
+ *
+ * Parsers working on parts of a source at once each intern labels into a map of
+ * their own and record definitions here, to be applied in source order once all
+ * of them are done.
+ */
+typedef struct {
+    LabelRecord *records;        // The definitions, in the order they were made.
+    size_t       count;          // Records in `records`.
+    size_t       capacity;       // Records `records` has room for.
+    size_t       first_command;  // Records made before the first command was complete.
+} LabelLog;
 
 /**
  * @brief Represents a parser for processing tokens and generating commands.
  *
- * The `Parser` structure is responsible for consuming tokens from a `Lexer`,
- * maintaining state during parsing, and handling label-to-command mapping.
+ * The `Parser` structure is responsible for consuming tokens from a `Lexer`
+ * or a pre-lexed `TokenBuffer`, maintaining state during parsing, and handling
+ * label-to-command mapping.
  */
 typedef struct {
-    Lexer    *lexer;      // Pointer to the lexer providing tokens.
-    bool      had_error;  // Flag indicating if an error occurred during parsing.
-    Token     current;    // The current token being processed.
-    Token     next;       // The next token to be processed.
-    LabelMap *label_map;  // Pointer to the label map mapping labels to commands.
+    Lexer      *lexer;        // Pointer to the lexer providing tokens, or NULL.
+    TokenCursor tokens;       // Reads a pre-lexed buffer when there is no lexer.
+    bool        had_error;    // Flag indicating if an error occurred during parsing.
+    Token       current;      // The current token being processed.
+    Token       next;         // The next token to be processed.
+    LabelMap   *label_map;    // Pointer to the label map interning the labels read.
+    LabelLog   *label_log;    // Records label changes instead of making them, or NULL.
+    SourceMap  *source_map;   // Records where each command in the list starts, or NULL.
+    Token       instruction;  // The token naming the last instruction read.
+    Arena      *arena;        // Holds the commands and the strings and labels they use.
+    StringList  externs;      // Labels declared with `extern`, resolved at link time.
+    StringList  includes;     // Object files named by `include`, linked in at load time.
+    bool       *defined;      // Whether this parse has defined each label, by symbol ID.
+    int         defined_cap;  // Labels `defined` has room for.
 } Parser;
 
 /**
  * @brief Initializes a `Parser` structure.
  *
  * @param parser Pointer to the `Parser` structure to initialize.
- * @param lexer Pointer to the `Lexer` to be used for tokenizing input.
+ * @param lexer Pointer to the `Lexer` to be used for tokenizing input, or NULL
+ * for a parser with no source, which is at its end straight away.
+ * @param map Pointer to the `LabelMap` for associating labels with commands.
+ * @param arena Pointer to the `Arena` to allocate the commands from.
+ */
+void parser_init(Parser *parser, Lexer *lexer, LabelMap *map, Arena *arena);
+
+/**
+ * @brief Initializes a `Parser` structure to read a pre-lexed source.
+ *
+ * @param parser Pointer to the `Parser` structure to initialize.
+ * @param tokens Pointer to the filled `TokenBuffer` to parse.
  * @param map Pointer to the `LabelMap` for associating labels with commands.
+ * @param arena Pointer to the `Arena` to allocate the commands from.
  */
-void parser_init(Parser *parser, Lexer *lexer, LabelMap *map);
+void parser_init_tokens(Parser *parser, const TokenBuffer *tokens, LabelMap *map, Arena *arena);
+
+/**
+ * @brief Frees the resources owned by a `Parser` structure.
+ *
+ * The lexer, label map and arena are not owned by the parser and are left
+ * untouched.
+ *
+ * @param parser Pointer to the `Parser` structure to free.
+ */
+void parser_free(Parser *parser);
 
 /**
  * @brief Parses commands from the input token stream.
  *
  * Reads tokens from the associated `Lexer` and builds a linked list of
- * commands. Updates the label map for any labels encountered during parsing. If
- * an error occurs, sets `parser->had_error` to `true`.
+ * commands. Updates the label map for any labels encountered during parsing,
+ * and the source map, if there is one, for every command. If an error occurs,
+ * sets `parser->had_error` to `true`; defining a label a second time is one,
+ * reported at its second definition.
  *
  * @param parser Pointer to the initialized `Parser` structure.
  * @return Pointer to the head of a linked list of parsed `Command` objects.
  *         Returns NULL if no commands were parsed or an error occurred.
  *
- * @note The caller is responsible for freeing the memory associated with the
- * returned commands.
+ * @note The commands live in the parser's arena, and are freed with it.
  */
 Command *parse_commands(Parser *parser);
 
+/**
+ * @brief Initializes an empty label log.
+ *
+ * @param log Pointer to the `LabelLog` to initialize.
+ */
+void label_log_init(LabelLog *log);
+
+/**
+ * @brief Frees a label log.
+ *
+ * @param log Pointer to the `LabelLog` to free.
+ */
+void label_log_free(LabelLog *log);
+
 #endif
@@ -0,0 +1,140 @@
+#ifndef CI_SAMPLE_PROFILE_H
+#define CI_SAMPLE_PROFILE_H
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "command.h"
+#include "label_map.h"
+#include "source_map.h"
+
+#define SAMPLE_PROFILE_DEFAULT_HZ  1000       // Samples per second of CPU time unless asked.
+#define SAMPLE_PROFILE_MAX_HZ      100000     // Most samples per second that can be asked for.
+#define SAMPLE_PROFILE_MAX_DEPTH   128        // Calls kept per sample, outermost first.
+#define SAMPLE_PROFILE_MAX_SAMPLES (1 << 20)  // Samples kept; later ones are only counted.
+#define SAMPLE_PROFILE_MAX_FRAMES  (1 << 24)  // Commands kept across every sample.
+#define SAMPLE_PROFILE_TOP         20         // Entries shown in each ranking of the report.
+
+/**
+ * @brief One sample: the command running and the calls that led to it.
+ */
+typedef struct {
+    uint32_t first;  // Index in `frames` of the outermost call, followed by the others and
+                     // then the command running.
+    uint32_t depth;  // Calls in progress; at most `SAMPLE_PROFILE_MAX_DEPTH` are kept.
+} Sample;
+
+/**
+ * @brief Where a run is, sampled on a CPU time timer.
+ *
+ * The timer's signal handler only raises `pending`. The engine checks it at
+ * each branch, call and return and takes the sample itself, so a sample is
+ * charged to the command ending the run of commands it fell in and the calls
+ * leading to it are always consistent. Nothing is recorded in the handler,
+ * which needs neither locks nor allocation.
+ *
+ * The kernel only checks CPU time timers on its scheduler tick, so samples
+ * come no faster than the tick, often 250 Hz, whatever rate is asked for.
+ */
+typedef struct {
+    volatile sig_atomic_t pending;                          // Set when a sample is due.
+    uint32_t              depth;                            // Calls in progress.
+    const Command        *calls[SAMPLE_PROFILE_MAX_DEPTH];  // The outermost calls in progress.
+    int                   hz;                               // Samples per second of CPU time.
+    Sample               *samples;                          // The samples taken, in order.
+    size_t                sample_count;                     // Samples in `samples`.
+    size_t                sample_capacity;                  // Samples `samples` has room for.
+    const Command       **frames;                           // The commands of every sample.
+    size_t                frame_count;                      // Commands in `frames`.
+    size_t                frame_capacity;                   // Commands `frames` has room for.
+    uint64_t              dropped;                          // Samples that could not be kept.
+    double                cpu_time;                         // Seconds of CPU time sampled.
+    bool                  incomplete;                       // Set if the timer could not start.
+} SampleProfile;
+
+/**
+ * @brief Initializes an empty profile.
+ *
+ * @param profile Pointer to the `SampleProfile` to initialize.
+ * @param hz Samples to take per second of CPU time.
+ */
+void sample_profile_init(SampleProfile *profile, int hz);
+
+/**
+ * @brief Frees the buffers of a profile.
+ *
+ * @param profile Pointer to the `SampleProfile` to free.
+ */
+void sample_profile_free(SampleProfile *profile);
+
+/**
+ * @brief Starts the timer, sampling into the profile on every `SIGPROF`.
+ *
+ * @param profile Pointer to the `SampleProfile` to sample into.
+ */
+void sample_profile_start(SampleProfile *profile);
+
+/**
+ * @brief Stops the timer and restores the previous `SIGPROF` handler.
+ *
+ * @param profile Pointer to the `SampleProfile` sampled into.
+ */
+void sample_profile_stop(SampleProfile *profile);
+
+/**
+ * @brief Records a sample of the command about to run and the calls leading
+ * to it, and clears `pending`.
+ *
+ * @param profile Pointer to the `SampleProfile` to record into.
+ * @param cmd The command about to run.
+ */
+void sample_profile_take(SampleProfile *profile, const Command *cmd);
+
+/**
+ * @brief Notes that a call is starting, for samples to see.
+ *
+ * @param profile Pointer to the `SampleProfile` of the run.
+ * @param call The call command.
+ */
+void sample_profile_enter(SampleProfile *profile, const Command *call);
+
+/**
+ * @brief Notes that the innermost call has returned.
+ *
+ * @param profile Pointer to the `SampleProfile` of the run.
+ */
+void sample_profile_leave(SampleProfile *profile);
+
+/**
+ * @brief Writes a report of the samples by instruction and by label, with
+ * their source lines, and the call depths seen.
+ *
+ * @param profile Pointer to the `SampleProfile` to report on.
+ * @param commands The program, used to number the instructions in the report.
+ * @param labels The labels of the program, naming the labels called.
+ * @param locations The source map of the program, or NULL.
+ * @param out The stream to write to.
+ */
+void sample_profile_report(SampleProfile *profile, Command *commands, const LabelMap *labels,
+                           const SourceMap *locations, FILE *out);
+
+/**
+ * @brief Writes the samples as folded stacks, one line per distinct stack with
+ * its frames separated by semicolons and followed by its count, as flame graph
+ * tools read.
+ *
+ * Each frame is the label called, or `main` for the program itself, and the
+ * line running in it.
+ *
+ * @param profile Pointer to the `SampleProfile` to write.
+ * @param commands The program, used to find the source lines.
+ * @param labels The labels of the program, naming the labels called.
+ * @param locations The source map of the program, or NULL.
+ * @param out The stream to write to.
+ */
+void sample_profile_write_folded(SampleProfile *profile, Command *commands,
+                                 const LabelMap *labels, const SourceMap *locations, FILE *out);
+
+#endif
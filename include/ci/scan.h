@@ -0,0 +1,34 @@
+#ifndef CI_SCAN_H
+#define CI_SCAN_H
+
+/**
+ * @brief Skips a run of blanks: spaces, tabs, commas and carriage returns.
+ *
+ * Uses AVX2 or SSE2 when the CPU supports them and falls back to a scalar
+ * loop otherwise. Never reads at or past `end`.
+ *
+ * @param p The first character to examine.
+ * @param end One past the last character that may be read.
+ * @return The first character that is not a blank, or `end`.
+ */
+const char *scan_blanks(const char *p, const char *end);
+
+/**
+ * @brief Finds the end of the current line.
+ *
+ * @param p The first character to examine.
+ * @param end One past the last character that may be read.
+ * @return The first newline or NUL, or `end`.
+ */
+const char *scan_line(const char *p, const char *end);
+
+/**
+ * @brief Finds the next character that ends or interrupts a string literal.
+ *
+ * @param p The first character to examine.
+ * @param end One past the last character that may be read.
+ * @return The first double quote, newline or NUL, or `end`.
+ */
+const char *scan_string(const char *p, const char *end);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef CI_SOURCE_MAP_H
+#define CI_SOURCE_MAP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "command.h"
+
+/**
+ * @brief Where in the source a command starts.
+ */
+typedef struct source_location {
+    uint32_t line;    // The line of the command's first token (1-based).
+    uint32_t column;  // The column of the command's first token (1-based).
+} SourceLocation;
+
+/**
+ * @brief The source location of every command of a program, kept beside the
+ * commands rather than in them.
+ *
+ * Locations are indexed by a command's position in the program's list, the
+ * same number profiles report instructions by, so commands stay as small as
+ * they are for the interpreter. Finding the location of a command means
+ * finding its position first, which is only done when reporting.
+ */
+typedef struct source_map {
+    SourceLocation *locations;  // The locations, one per command, in program order.
+    size_t          count;      // Locations in `locations`.
+    size_t          capacity;   // Locations `locations` has room for.
+} SourceMap;
+
+/**
+ * @brief Initializes an empty source map.
+ *
+ * @param map Pointer to the `SourceMap` to initialize.
+ */
+void source_map_init(SourceMap *map);
+
+/**
+ * @brief Frees the locations of a source map.
+ *
+ * @param map Pointer to the `SourceMap` to free.
+ */
+void source_map_free(SourceMap *map);
+
+/**
+ * @brief Records the location of the next command of the program.
+ *
+ * @param map Pointer to the `SourceMap` to append to.
+ * @param line The line the command starts on.
+ * @param column The column the command starts at.
+ * @return True on success, false if memory ran out.
+ */
+bool source_map_push(SourceMap *map, int line, int column);
+
+/**
+ * @brief Appends the locations of a later part of the program, whose lines
+ * were counted from its own start.
+ *
+ * @param map Pointer to the `SourceMap` to append to.
+ * @param part Pointer to the `SourceMap` of the part.
+ * @param lines_before The number of lines of the program before the part.
+ * @return True on success, false if memory ran out.
+ */
+bool source_map_append(SourceMap *map, const SourceMap *part, size_t lines_before);
+
+/**
+ * @brief Gives the location of the command at a position in the program.
+ *
+ * @param map Pointer to the `SourceMap` of the program, or NULL.
+ * @param index The position of the command.
+ * @return The location, or NULL if it is not known.
+ */
+const SourceLocation *source_map_at(const SourceMap *map, size_t index);
+
+/**
+ * @brief Finds the location of a command by walking the program to it.
+ *
+ * @param map Pointer to the `SourceMap` of the program, or NULL.
+ * @param commands The program.
+ * @param cmd The command to find.
+ * @return The location, or NULL if it is not known, such as for a command of
+ * an included object.
+ */
+const SourceLocation *source_map_find(const SourceMap *map, const Command *commands,
+                                      const Command *cmd);
+
+#endif
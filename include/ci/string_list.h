@@ -0,0 +1,47 @@
+#ifndef CI_STRING_LIST_H
+#define CI_STRING_LIST_H
+#include <stdbool.h>
+
+/**
+ * @brief Represents a growable list of owned, NUL-terminated strings.
+ */
+typedef struct {
+    char **items;     // The strings held by this list.
+    int    count;     // The number of strings in the list.
+    int    capacity;  // The number of strings the list can hold before growing.
+} StringList;
+
+/**
+ * @brief Initializes an empty string list.
+ *
+ * @param list Pointer to the `StringList` to initialize.
+ */
+void string_list_init(StringList *list);
+
+/**
+ * @brief Frees every string in the list along with the list itself.
+ *
+ * @param list Pointer to the `StringList` to free.
+ */
+void string_list_free(StringList *list);
+
+/**
+ * @brief Appends a copy of the given string to the list.
+ *
+ * @param list Pointer to the `StringList` to append to.
+ * @param str The start of the string to copy.
+ * @param length The number of characters of `str` to copy.
+ * @return True if the string was appended, false otherwise.
+ */
+bool string_list_push(StringList *list, const char *str, int length);
+
+/**
+ * @brief Determines whether the list holds the given string.
+ *
+ * @param list Pointer to the `StringList` to search.
+ * @param str The string to search for.
+ * @return True if the string is present, false otherwise.
+ */
+bool string_list_contains(const StringList *list, const char *str);
+
+#endif
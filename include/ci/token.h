@@ -1,5 +1,7 @@
 #ifndef CI_TOKEN_H
 #define CI_TOKEN_H
+#include <stdint.h>
+
 #include "token_type.h"
 
 /**
@@ -7,14 +9,15 @@
  */
 typedef struct {
     TokenType   type;    // The type of this token.
-    const char *lexeme;  // Pointer to the start of this token in the source text.
     int         length;  // The length of the token.
+    const char *lexeme;  // Pointer to the start of this token in the source text.
     int         line;    // The line number where this token is located (1-based).
     int         column;  // The column number where this token starts (1-based).
+    int64_t     value;   // A number's value, or the register an identifier names; else -1.
 } Token;
 
 /**
- * @brief Initializes a `Token` structure.
+ * @brief Initializes a `Token` structure with no value.
  *
  * @param tok Pointer to the `Token` to initialize.
  * @param tok_type The type of the token.
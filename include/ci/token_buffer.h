@@ -0,0 +1,117 @@
+#ifndef CI_TOKEN_BUFFER_H
+#define CI_TOKEN_BUFFER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "token.h"
+
+#define TOKEN_BUFFER_MAX_SOURCE UINT32_MAX  // Longest source a buffer can hold offsets into.
+
+/**
+ * @brief A token whose position cannot be recovered from the newline table.
+ *
+ * Error tokens point at their message rather than the source, and a few
+ * tokens after malformed input have columns that do not follow from their
+ * offset. These are kept whole.
+ */
+typedef struct {
+    size_t index;  // The position of the token in the buffer.
+    Token  token;  // The token exactly as the lexer made it.
+} TokenOverride;
+
+/**
+ * @brief Every token of a source, lexed in one pass and stored as parallel
+ * arrays.
+ *
+ * Only the type, offset, length and value of each token are stored. Lines
+ * and columns are recovered from the offsets of the newlines in the source,
+ * so a token takes 17 bytes instead of the 32 of a `Token`.
+ */
+typedef struct {
+    const char    *source;             // The source the offsets are into.
+    uint8_t       *types;              // The `TokenType` of each token.
+    uint32_t      *offsets;            // Where each token starts in `source`.
+    uint32_t      *lengths;            // The length of each token.
+    int64_t       *values;             // The value of each token.
+    size_t         count;              // Tokens in the buffer, the last being EOF.
+    size_t         capacity;           // Tokens the arrays have room for.
+    uint32_t      *newlines;           // Offsets of the newlines in `source`, ascending.
+    size_t         newline_count;      // Newlines in `newlines`.
+    size_t         newline_capacity;   // Newlines `newlines` has room for.
+    TokenOverride *overrides;          // Tokens stored whole, by ascending index.
+    size_t         override_count;     // Tokens in `overrides`.
+    size_t         override_capacity;  // Tokens `overrides` has room for.
+} TokenBuffer;
+
+/**
+ * @brief A position in a `TokenBuffer` that yields its tokens in order.
+ */
+typedef struct {
+    const TokenBuffer *buffer;    // The buffer being read.
+    size_t             index;     // The next token to yield.
+    size_t             newline;   // Newlines before the next token.
+    size_t             override;  // Overrides before the next token.
+} TokenCursor;
+
+/**
+ * @brief Initializes an empty token buffer.
+ *
+ * @param buffer Pointer to the `TokenBuffer` to initialize.
+ */
+void token_buffer_init(TokenBuffer *buffer);
+
+/**
+ * @brief Frees the arrays of a token buffer. The source is not owned by it.
+ *
+ * @param buffer Pointer to the `TokenBuffer` to free.
+ */
+void token_buffer_free(TokenBuffer *buffer);
+
+/**
+ * @brief Lexes a whole source into a token buffer.
+ *
+ * The tokens are exactly those `lexer_next_token` yields, up to and including
+ * the first EOF. The source must stay alive for as long as the buffer is used.
+ *
+ * @param buffer Pointer to an initialized, empty `TokenBuffer`.
+ * @param text The NUL terminated source to lex.
+ * @return True on success, false if the source is longer than
+ * `TOKEN_BUFFER_MAX_SOURCE` or memory ran out.
+ */
+bool token_buffer_lex(TokenBuffer *buffer, const char *text);
+
+/**
+ * @brief Lexes a run of whole lines of a source into a token buffer.
+ *
+ * The tokens are those of a lexer made with `lexer_init_lines`.
+ *
+ * @param buffer Pointer to an initialized, empty `TokenBuffer`.
+ * @param text A pointer to the first line, which must stay alive for as long
+ * as the buffer is used.
+ * @param length The number of characters in the lines.
+ * @return True on success, false if the lines are longer than
+ * `TOKEN_BUFFER_MAX_SOURCE` or memory ran out.
+ */
+bool token_buffer_lex_lines(TokenBuffer *buffer, const char *text, size_t length);
+
+/**
+ * @brief Positions a cursor at a token of a buffer.
+ *
+ * @param cursor Pointer to the `TokenCursor` to initialize.
+ * @param buffer The filled buffer to read.
+ * @param index The first token to yield.
+ */
+void token_cursor_init(TokenCursor *cursor, const TokenBuffer *buffer, size_t index);
+
+/**
+ * @brief Yields the next token of a buffer.
+ *
+ * Past the end the final EOF is yielded again, as the lexer does.
+ *
+ * @param cursor Pointer to the `TokenCursor` to read from.
+ * @return The token, with its line and column.
+ */
+Token token_cursor_next(TokenCursor *cursor);
+
+#endif
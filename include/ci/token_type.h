@@ -38,6 +38,8 @@ typedef enum {
     TOK_STORE,       // store
     TOK_STR,         // "string"
     TOK_SUB,         // sub
+    TOK_EXTERN,      // extern
+    TOK_INCLUDE,     // include
 } TokenType;
 
 #endif
@@ -0,0 +1,132 @@
+#include "arena.h"
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGNMENT alignof(max_align_t)  // Alignment of every piece handed out.
+
+static ArenaBlock *add_block(Arena *arena, size_t size);
+
+void arena_init(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    arena->blocks     = NULL;
+    arena->next_block = ARENA_FIRST_BLOCK;
+}
+
+void arena_free(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    if (!arena || size > SIZE_MAX - ALIGNMENT) {
+        return NULL;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    if (block) {
+        uintptr_t at      = (uintptr_t) (block->data + block->used);
+        size_t    padding = (size_t) (-at & (ALIGNMENT - 1));
+        if (block->size - block->used >= padding + size) {
+            block->used += padding + size;
+            return (void *) (at + padding);
+        }
+    }
+
+    // Room for the padding too, as the data need not start aligned
+    block = add_block(arena, size + ALIGNMENT);
+    if (!block) {
+        return NULL;
+    }
+    uintptr_t at      = (uintptr_t) block->data;
+    size_t    padding = (size_t) (-at & (ALIGNMENT - 1));
+    block->used       = padding + size;
+    return (void *) (at + padding);
+}
+
+char *arena_copy_string(Arena *arena, const char *str, size_t length) {
+    if (length == SIZE_MAX) {
+        return NULL;
+    }
+
+    char *copy = arena_alloc(arena, length + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_adopt(Arena *to, Arena *from) {
+    if (!to || !from || !from->blocks) {
+        return;
+    }
+
+    // The oldest block of `from` goes behind the block `to` is filling
+    ArenaBlock *last = from->blocks;
+    while (last->next) {
+        last = last->next;
+    }
+    if (to->blocks) {
+        last->next       = to->blocks->next;
+        to->blocks->next = from->blocks;
+    } else {
+        to->blocks = from->blocks;
+    }
+    arena_init(from);
+}
+
+/**
+ * @brief Allocates a new block to fill, at least large enough for one piece.
+ *
+ * The space left in the block being filled is given up. A piece too large for
+ * a normal block gets a block of its own instead, put behind the one being
+ * filled so that none of it is lost.
+ *
+ * @param arena Pointer to the `Arena` to add the block to.
+ * @param size The fewest bytes the block must hold.
+ * @return The new block, or NULL if memory ran out.
+ */
+static ArenaBlock *add_block(Arena *arena, size_t size) {
+    bool   oversized  = size > arena->next_block;
+    size_t block_size = oversized ? size : arena->next_block;
+    if (block_size > SIZE_MAX - sizeof(ArenaBlock)) {
+        return NULL;
+    }
+
+    // Fresh from calloc, every piece is handed out zeroed
+    ArenaBlock *block = calloc(1, sizeof(ArenaBlock) + block_size);
+    if (!block) {
+        return NULL;
+    }
+    block->size = block_size;
+    block->used = 0;
+
+    if (oversized && arena->blocks) {
+        block->next         = arena->blocks->next;
+        arena->blocks->next = block;
+        return block;
+    }
+
+    block->next   = arena->blocks;
+    arena->blocks = block;
+    if (arena->next_block < ARENA_MAX_BLOCK) {
+        arena->next_block *= 2;
+    }
+    return block;
+}
@@ -1,197 +1,814 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "arena.h"
 #include "cmd_args_config.h"
 #include "command.h"
+#include "exec_profile.h"
 #include "interpreter.h"
 #include "label_map.h"
 #include "lexer.h"
 #include "mem.h"
+#include "mem_profile.h"
+#include "object.h"
+#include "output.h"
+#include "parallel_parse.h"
 #include "parser.h"
+#include "sample_profile.h"
+#include "source_map.h"
 #include "token.h"
+#include "token_buffer.h"
 #include "token_type.h"
 #include <ctype.h>
 
-#define CAPACITY 50
+#define BATCH_LIMIT (256 * 1024 * 1024)  // Largest source lexed ahead; larger ones as parsed.
 
-static int   run_interpreter(CmdArgsConfig *conf);
-static char *run_repl(void);
-static char *read_file(const char *path);
-static int   run_file(const char *src, bool print_lex, bool print_parse);
+/**
+ * @brief A source file read in chunks by a streaming lexer.
+ */
+typedef struct {
+    int         fd;    // The open file.
+    const char *path;  // The file's name, for error messages.
+} SourceFile;
+
+/**
+ * @brief A source held whole in memory, mapped from its file where possible.
+ */
+typedef struct {
+    char  *text;    // The source, followed by a NUL.
+    size_t length;  // The number of characters in the source.
+    size_t mapped;  // The bytes mapped at `text`, or 0 if it was read into the heap.
+} SourceText;
+
+/**
+ * @brief The program a REPL session has built up, and the state it runs in.
+ *
+ * Each block entered is parsed on its own and appended to the program, so
+ * labels and calls reach code entered earlier.
+ */
+typedef struct {
+    LabelMap    labels;   // Every label seen so far.
+    Arena       arena;    // Holds every command entered so far.
+    ModuleList  mods;     // The objects included so far.
+    StringList  externs;  // Every label declared `extern` so far, which included objects export.
+    Interpreter intr;     // Keeps the registers and flags between blocks.
+    LabelLog    log;      // Labels at the end of earlier blocks, waiting for a command.
+    Command    *tail;     // The last command of the program, or NULL.
+} Repl;
+
+static bool     redirect_output(const char *path);
+static int      run_interpreter(CmdArgsConfig *conf);
+static int      run_repl(void);
+static char    *read_block(void);
+static bool     run_block(Repl *repl, const char *block);
+static void     apply_block_labels(Repl *repl, size_t pending, Command *head);
+static bool     load_source(const char *path, SourceText *source);
+static bool     map_source(int fd, size_t length, SourceText *source);
+static void     unload_source(SourceText *source);
+static char    *read_file(const char *path, size_t *length);
+static bool     is_regular_file(const char *path);
+static size_t   read_source(void *context, char *buffer, size_t size);
+static int      run_file(Lexer *l, const SourceText *src, CmdArgsConfig *conf);
+static Command *parse_source(Parser *p, Lexer *l, const SourceText *src, LabelMap *lbm,
+                             Arena *arena, SourceMap *locations, CmdArgsConfig *conf);
+static void     report_runtime_error(const Interpreter *intr, Command *commands,
+                                     const SourceMap *locations, const char *path);
+static void     write_mem_profile(MemProfile *profile, Command *commands,
+                                  const SourceMap *locations, const char *path);
+static void     write_exec_profile(ExecProfile *profile, Command *commands, const LabelMap *labels,
+                                   const SourceMap *locations, const char *path);
+static void     write_sample_profile(SampleProfile *profile, Command *commands,
+                                     const LabelMap *labels, const SourceMap *locations,
+                                     const char *folded_path);
 
 int main(int argc, char **argv) {
-    CmdArgsConfig conf = {false, false, false, NULL, NULL};
+    if (!output_init(OUTPUT_SINK_STDOUT, -1)) {
+        fprintf(stderr, "Could not allocate the output buffer\n");
+        return 1;
+    }
+
+    CmdArgsConfig conf = {.mem_size = MEM_DEFAULT_CAPACITY, .dump = DUMP_ALL};
     if (!parse_cmd_args(&conf, argv + 1, argc - 1)) {
-        printf("Aborting\n");
+        output_printf("Aborting\n");
         config_free(&conf);
+        output_free();
         return 1;
     }
-    FILE *file = NULL;
-    if (conf.out_filename != NULL) {
-        file = freopen(conf.out_filename, "w", stdout);
-        if (file == NULL) {
-            perror("Failed to redirect stdout");
-            return 1;
-        }
+    MemBackend backend = MEM_BACKEND_FLAT;
+    if (conf.mem_sparse) {
+        backend = MEM_BACKEND_SPARSE;
+    } else if (conf.mem_guard) {
+        backend = MEM_BACKEND_GUARD;
+    }
+    if (!mem_init(backend, conf.mem_size, conf.mem_huge_pages)) {
+        output_printf("Could not reserve %zu bytes of memory. Aborting\n", conf.mem_size);
+        config_free(&conf);
+        output_free();
+        return 1;
+    }
+    if (conf.out_filename != NULL && !redirect_output(conf.out_filename)) {
+        config_free(&conf);
+        mem_free();
+        output_free();
+        return 1;
     }
 
+    // Whether the run failed or not, everything printed is flushed here
     int status = run_interpreter(&conf);
     config_free(&conf);
-    if (file) {
-        fclose(file);
+    mem_free();
+    if (!output_free()) {
+        fprintf(stderr, "Could not write the output\n");
+        status = 1;
     }
     return status;
 }
 
+/**
+ * @brief Sends the output to a file instead of standard output.
+ *
+ * What was printed before goes to standard output first.
+ *
+ * @param path The name of the file, which is created or truncated.
+ * @return True on success, false if the file could not be opened.
+ */
+static bool redirect_output(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        perror("Failed to redirect stdout");
+        return false;
+    }
+
+    output_free();
+    if (!output_init(OUTPUT_SINK_FD, fd)) {
+        fprintf(stderr, "Could not allocate the output buffer\n");
+        close(fd);
+        return false;
+    }
+    return true;
+}
+
 static int run_interpreter(CmdArgsConfig *conf) {
-    char *src;
-    int   status;
+    SourceText src    = {NULL, 0, 0};
+    SourceFile source = {-1, conf->in_filename};
+    Lexer      l;
+    int        status;
 
     if (conf->repl) {
-        src = run_repl();
-        if (!src) {
+        return run_repl();
+    }
+    if (conf->in_filename == NULL) {
+        output_printf("No file specified.\n");
+        return -1;
+    }
+
+    if (conf->print_lex || is_regular_file(conf->in_filename)) {
+        // Mapped whole, however large; printing the tokens lexes the source
+        // twice
+        if (!load_source(conf->in_filename, &src)) {
             return -1;
         }
-    } else {
-        if (conf->in_filename == NULL) {
-            printf("No file specified.\n");
-            return -1;
+
+        lexer_init_lines(&l, src.text, src.length);
+        if (conf->print_lex) {
+            print_lexed_tokens(&l);
+            // Reset so we can parse
+            lexer_init_lines(&l, src.text, src.length);
         }
-        src = read_file(conf->in_filename);
-        if (!src) {
+    } else {
+        // Streamed, as pipes cannot be mapped
+        source.fd = open(conf->in_filename, O_RDONLY);
+        if (source.fd < 0) {
+            output_printf("Failed to open file %s\n", conf->in_filename);
             return -1;
         }
+        lexer_init_stream(&l, read_source, &source);
+    }
+
+    bool loaded = !conf->mem_in_filename ||
+                  mem_load_image(conf->mem_in_filename, conf->mem_in_offset);
+    if (loaded) {
+        status = run_file(&l, src.text ? &src : NULL, conf);
+    }
+
+    lexer_free(&l);
+    unload_source(&src);
+    if (source.fd >= 0) {
+        close(source.fd);
+    }
+    if (!loaded) {
+        return -1;
+    }
+
+    if (conf->mem_out_filename && !mem_save_image(conf->mem_out_filename)) {
+        return -1;
     }
-    status = run_file(src, conf->print_lex, conf->print_parse);
-    free(src);
     return status;
 }
 
-static char *run_repl(void) {
-    // Allocate initial buffer
-    char *buffer = (char *) malloc(CAPACITY * sizeof(char));
-    if (!buffer) {
-        printf("Could not allocate memory for REPL buffer\n");
-        return NULL;
+/**
+ * @brief Runs an interactive session, executing each block as it is entered.
+ *
+ * A line ending in `;` continues the block and any other line completes it.
+ * Only the new block is lexed and parsed; it then runs against the registers,
+ * flags and memory left by the blocks before it. The session ends at the end
+ * of the input, with the final state printed as after running a file.
+ *
+ * @return 0 if every block parsed and ran without error, -1 otherwise.
+ */
+static int run_repl(void) {
+    Repl repl;
+    if (!label_map_init(&repl.labels, 100)) {
+        output_printf("Unable to allocate label hashmap. Aborting\n");
+        return -1;
+    }
+    arena_init(&repl.arena);
+    module_list_init(&repl.mods);
+    string_list_init(&repl.externs);
+    interpreter_init(&repl.intr, &repl.labels);
+    label_log_init(&repl.log);
+    repl.tail = NULL;
+
+    output_printf("Enter commands:\n");
+
+    bool  ok = true;
+    char *block;
+    while ((block = read_block()) != NULL) {
+        ok = run_block(&repl, block) && ok;
+        free(block);
     }
 
-    size_t total_size   = CAPACITY;
-    size_t current_size = 0;
-    char   line[256];
-    bool   continue_input = true;
+    repl.intr.had_error = !ok;
+    print_interpreter_state(&repl.intr);
+    mem_print();
+
+    label_log_free(&repl.log);
+    module_list_free(&repl.mods);
+    string_list_free(&repl.externs);
+    arena_free(&repl.arena);
+    label_map_free(&repl.labels);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Reads lines from standard input until one completes a block.
+ *
+ * @return The block, or NULL at the end of the input.
+ */
+static char *read_block(void) {
+    char  *block  = NULL;
+    size_t length = 0;
+    char  *line   = NULL;
+    size_t size   = 0;
 
-    printf("Enter commands:\n");
+    for (;;) {
+        output_printf("CI> ");
+        output_flush();
 
-    while (continue_input) {
-        printf("CI> ");
-        if (!fgets(line, sizeof(line), stdin)) {
+        ssize_t line_len = getline(&line, &size, stdin);
+        if (line_len < 0) {
             break;
         }
 
-        size_t line_len = strlen(line);
-
-        // Check if we need to resize the buffer
-        if (current_size + line_len >= total_size) {
-            total_size *= 2;
-            char *new_buffer = (char *) realloc(buffer, total_size);
-            if (!new_buffer) {
-                printf("Could not allocate more memory for REPL buffer\n");
-                free(buffer);
-                return NULL;
-            }
-            buffer = new_buffer;
+        char *grown = realloc(block, length + (size_t) line_len + 1);
+        if (!grown) {
+            output_printf("Could not allocate more memory for REPL buffer\n");
+            break;
+        }
+        block = grown;
+        memcpy(block + length, line, (size_t) line_len + 1);
+        length += (size_t) line_len;
+
+        // The block goes on while lines end with a semicolon
+        ssize_t last = line_len - 1;
+        while (last >= 0 && isspace((unsigned char) line[last])) {
+            last--;
+        }
+        if (last < 0 || line[last] != ';') {
+            free(line);
+            return block;
+        }
+    }
+
+    // A block cut short by the end of the input still runs
+    free(line);
+    return block;
+}
+
+/**
+ * @brief Parses a block, appends it to the program and runs it.
+ *
+ * A block that fails to parse or link is dropped, leaving the program as it
+ * was.
+ *
+ * @param repl Pointer to the session to run the block in.
+ * @param block The NUL terminated text of the block.
+ * @return True if the block parsed and ran without error, false otherwise.
+ */
+static bool run_block(Repl *repl, const char *block) {
+    size_t pending = repl->log.count;
+
+    Lexer  l;
+    Parser p;
+    lexer_init(&l, block);
+    parser_init(&p, &l, &repl->labels, &repl->arena);
+    p.label_log   = &repl->log;
+    Command *head = parse_commands(&p);
+    lexer_free(&l);
+
+    if (p.had_error) {
+        output_printf("Parser encountered an error:\n");
+        output_printf("At ");
+        print_token(p.current);
+        output_printf("\n");
+        repl->log.count = pending;
+        parser_free(&p);
+        return false;
+    }
+
+    // An object links against every extern declared so far, so a label can be
+    // declared in one block and included in a later one
+    bool declared = true;
+    for (int i = 0; declared && i < p.externs.count; i++) {
+        const char *id = p.externs.items[i];
+        declared       = string_list_contains(&repl->externs, id) ||
+                         string_list_push(&repl->externs, id, (int) strlen(id));
+    }
+
+    int linked = repl->mods.count;
+    if (!declared || !link_objects(&repl->mods, &repl->labels, &p.includes, &repl->externs)) {
+        output_printf("Linking failed\n");
+        repl->log.count = pending;
+        parser_free(&p);
+        return false;
+    }
+    for (int m = linked; m < repl->mods.count; m++) {
+        specialize_commands(repl->mods.modules[m], true);
+    }
+
+    apply_block_labels(repl, pending, head);
+    if (head) {
+        if (repl->tail) {
+            repl->tail->next = head;
+        }
+        repl->tail = head;
+        while (repl->tail->next) {
+            repl->tail = repl->tail->next;
         }
+        specialize_commands(head, true);
+    }
+
+    bool resolved = check_externs(&repl->labels, &p.externs) &&
+                    check_externs(&repl->labels, &repl->mods.externs);
+    parser_free(&p);
+    if (!resolved) {
+        output_printf("Linking failed\n");
+        return false;
+    }
+
+    repl->intr.had_error = false;
+    interpret(&repl->intr, head);
+    return !repl->intr.had_error;
+}
 
-        strcpy(buffer + current_size, line);
-        current_size += line_len;
-
-        // Check if line ends with semicolon
-        bool has_semicolon = false;
-        for (int i = line_len - 1; i >= 0; i--) {
-            if (line[i] == ';') {
-                has_semicolon = true;
-                break;
-            }
-            if (!isspace(line[i])) {
-                break;
-            }
+/**
+ * @brief Points the labels of a parsed block at their commands.
+ *
+ * Labels at the end of a block have no command yet. They point at nothing, as
+ * at the end of a file, and stay in the log until a later block brings the
+ * command they belong to.
+ *
+ * @param repl Pointer to the session the block was parsed in.
+ * @param pending The number of log records from earlier blocks.
+ * @param head The first command of the block, or NULL if it has none.
+ */
+static void apply_block_labels(Repl *repl, size_t pending, Command *head) {
+    LabelRecord *records = repl->log.records;
+    size_t       waiting = 0;
+    for (size_t i = 0; i < repl->log.count; i++) {
+        Command *command = (i < pending) ? head : records[i].command;
+        repl->labels.entries[records[i].symbol].command = command;
+        if (!command) {
+            records[waiting++] = records[i];
         }
+    }
+    repl->log.count         = waiting;
+    repl->log.first_command = 0;
+}
 
-        if (!has_semicolon) {
-            continue_input = false;
+/**
+ * @brief Loads a whole source, mapping it rather than copying it in.
+ *
+ * The tokens point into the mapping and the parser copies what it keeps, so
+ * nothing refers to it after parsing. Files that cannot be mapped are read
+ * into the heap instead. A NUL ends the source, but is left for the lexer to
+ * find, so no page is read before it is lexed.
+ *
+ * @param path The name of the source.
+ * @param source Pointer to the `SourceText` to fill in.
+ * @return True on success, false if the file could not be opened or memory ran
+ * out.
+ */
+static bool load_source(const char *path, SourceText *source) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        output_printf("Failed to open file %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    bool        mapped = false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        mapped = map_source(fd, (size_t) st.st_size, source);
+    }
+    close(fd);
+    if (!mapped) {
+        source->mapped = 0;
+        source->text   = read_file(path, &source->length);
+        if (!source->text) {
+            return false;
         }
     }
+    return true;
+}
 
-    return buffer;
+/**
+ * @brief Maps a regular file so that a NUL follows it.
+ *
+ * The rest of the file's last page reads as zeros. A file ending exactly on a
+ * page has a page of zeros reserved behind it instead, so the lexer finds its
+ * terminator either way without the file being copied.
+ *
+ * @param fd The open file.
+ * @param length The size of the file, at least 1.
+ * @param source Pointer to the `SourceText` to fill in.
+ * @return True on success, false if the file could not be mapped.
+ */
+static bool map_source(int fd, size_t length, SourceText *source) {
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0 || length > SIZE_MAX - (size_t) page) {
+        return false;
+    }
+
+    // Reserve room for the terminator, then lay the file over the start of it
+    size_t mapped = (length / (size_t) page + 1) * (size_t) page;
+    char  *text   = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (text == MAP_FAILED) {
+        return false;
+    }
+    if (mmap(text, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(text, mapped);
+        return false;
+    }
+    // Read front to back, so ask for the pages ahead early and drop those behind
+    madvise(text, length, MADV_SEQUENTIAL);
+
+    source->text   = text;
+    source->length = length;
+    source->mapped = mapped;
+    return true;
 }
 
-static char *read_file(const char *path) {
+/**
+ * @brief Releases a source loaded by `load_source`.
+ *
+ * @param source Pointer to the `SourceText` to release.
+ */
+static void unload_source(SourceText *source) {
+    if (source->mapped) {
+        munmap(source->text, source->mapped);
+    } else {
+        free(source->text);
+    }
+    source->text   = NULL;
+    source->length = 0;
+    source->mapped = 0;
+}
+
+/**
+ * @brief Reads a whole source into the heap and terminates it with a NUL.
+ *
+ * @param path The name of the source.
+ * @param length A pointer to store the number of characters read in.
+ * @return The source, or NULL if it could not be opened or memory ran out.
+ */
+static char *read_file(const char *path, size_t *length) {
     FILE *file = fopen(path, "rb");
     if (!file) {
-        printf("Failed to open file %s\n", path);
+        output_printf("Failed to open file %s\n", path);
         return NULL;
     }
 
-    fseek(file, 0L, SEEK_END);
-    size_t filesize = ftell(file);
-    rewind(file);
+    // Grown as it fills, since the size of a pipe is not known up front
+    size_t capacity = LEXER_CHUNK_SIZE;
+    size_t used     = 0;
+    char  *buffer   = (char *) malloc(capacity + 1);
+    while (buffer) {
+        used += fread(buffer + used, sizeof(char), capacity - used, file);
+        if (used < capacity) {
+            break;
+        }
+
+        capacity *= 2;
+        char *grown = (char *) realloc(buffer, capacity + 1);
+        if (!grown) {
+            free(buffer);
+        }
+        buffer = grown;
+    }
 
-    char *buffer = (char *) calloc(filesize + 1, sizeof(char));
     if (!buffer) {
-        printf("Could not allocate enough space for %s\n", path);
+        output_printf("Could not allocate enough space for %s\n", path);
+        fclose(file);
         return NULL;
     }
-
-    size_t bytes_read = fread(buffer, sizeof(char), filesize, file);
-    if (bytes_read < filesize) {
-        printf("Could not read %s\n", path);
+    if (ferror(file)) {
+        output_printf("Could not read %s\n", path);
     }
 
+    buffer[used] = '\0';
+    *length      = used;
     fclose(file);
     return buffer;
 }
 
-static int run_file(const char *src, bool print_lex, bool print_parse) {
-    Lexer l;
-    lexer_init(&l, src);
-    if (print_lex) {
-        print_lexed_tokens(&l);
-        // Reset so we can parse
-        lexer_init(&l, src);
+/**
+ * @brief Determines whether a source can be mapped whole.
+ *
+ * Pipes and other special files are streamed instead.
+ *
+ * @param path The name of the source.
+ * @return True for a regular file.
+ */
+static bool is_regular_file(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * @brief Reads the next chunk of a `SourceFile` for a streaming lexer.
+ *
+ * @param context The `SourceFile` to read.
+ * @param buffer Where to store what was read.
+ * @param size The most bytes to read.
+ * @return The number of bytes read, or 0 at the end of the file or on error.
+ */
+static size_t read_source(void *context, char *buffer, size_t size) {
+    SourceFile *source = context;
+    for (;;) {
+        ssize_t bytes_read = read(source->fd, buffer, size);
+        if (bytes_read >= 0) {
+            return (size_t) bytes_read;
+        }
+        if (errno != EINTR) {
+            output_printf("Could not read %s\n", source->path);
+            return 0;
+        }
     }
+}
 
+static int run_file(Lexer *l, const SourceText *src, CmdArgsConfig *conf) {
     LabelMap lbm;
     if (!label_map_init(&lbm, 100)) {
-        printf("Unable to allocate label hashmap. Aborting\n");
+        output_printf("Unable to allocate label hashmap. Aborting\n");
         return -1;
     }
 
-    Parser p;
-    parser_init(&p, &l, &lbm);
-    Command *commands = parse_commands(&p);
-    if (print_parse) {
-        print_commands(commands);
+    // Everything parsed lives in the arena and is released with it
+    Arena arena;
+    arena_init(&arena);
+
+    // Kept beside the commands, for reports and errors to name source lines by
+    SourceMap locations;
+    source_map_init(&locations);
+
+    Parser   p;
+    Command *commands = parse_source(&p, l, src, &lbm, &arena, &locations, conf);
+    if (conf->print_parse) {
+        print_commands(commands, &lbm, &locations);
     }
 
     if (p.had_error) {
-        printf("Parser encountered an error:\n");
-        printf("At ");
+        output_printf("Parser encountered an error:\n");
+        output_printf("At ");
         print_token(p.current);
-        printf("\nParsed commands up to this point:\n");
-        print_commands(commands);
-        free_command(commands);
+        output_printf("\nParsed commands up to this point:\n");
+        // The parse error report keeps the format it always had, without locations
+        print_commands(commands, &lbm, NULL);
+        source_map_free(&locations);
+        arena_free(&arena);
+        parser_free(&p);
+        label_map_free(&lbm);
+        return -1;
+    }
+
+    if (conf->obj_filename) {
+        bool written = object_write(conf->obj_filename, commands, &lbm, &p.externs, &p.includes);
+        source_map_free(&locations);
+        arena_free(&arena);
+        parser_free(&p);
+        label_map_free(&lbm);
+        return written ? 0 : -1;
+    }
+
+    ModuleList mods;
+    module_list_init(&mods);
+    if (!link_objects(&mods, &lbm, &p.includes, &p.externs) ||
+        !check_externs(&lbm, &p.externs) || !check_externs(&lbm, &mods.externs)) {
+        output_printf("Linking failed. Aborting\n");
+        module_list_free(&mods);
+        source_map_free(&locations);
+        arena_free(&arena);
+        parser_free(&p);
         label_map_free(&lbm);
         return -1;
     }
 
-    Interpreter i;
+    // Resolved addresses bypass the profiled engine, so keep them when profiling
+    specialize_commands(commands, !conf->mem_profile);
+    for (int m = 0; m < mods.count; m++) {
+        specialize_commands(mods.modules[m], !conf->mem_profile);
+    }
+
+    MemProfile    profile;
+    ExecProfile   exec;
+    SampleProfile sampler;
+    Interpreter   i;
     interpreter_init(&i, &lbm);
+    if (conf->mem_profile) {
+        mem_profile_init(&profile);
+        i.mem_profile = &profile;
+    }
+    if (conf->exec_profile) {
+        exec_profile_init(&exec);
+        i.exec_profile = &exec;
+    }
+    if (conf->sample_hz) {
+        sample_profile_init(&sampler, conf->sample_hz);
+        i.sample_profile = &sampler;
+    }
     interpret(&i, commands);
-    print_interpreter_state(&i);
-    mem_print();
+    if (i.had_error) {
+        report_runtime_error(&i, commands, &locations, conf->in_filename);
+    }
+    if (conf->dump & DUMP_REGS) {
+        print_interpreter_state(&i);
+    }
+    if (conf->dump & DUMP_MEM) {
+        mem_print();
+    }
 
-    free_command(commands);
+    if (conf->mem_profile) {
+        write_mem_profile(&profile, commands, &locations, conf->mem_profile_filename);
+        mem_profile_free(&profile);
+    }
+    if (conf->exec_profile) {
+        write_exec_profile(&exec, commands, &lbm, &locations, conf->exec_profile_filename);
+        exec_profile_free(&exec);
+    }
+    if (conf->sample_hz) {
+        write_sample_profile(&sampler, commands, &lbm, &locations, conf->sample_folded_filename);
+        sample_profile_free(&sampler);
+    }
+
+    module_list_free(&mods);
+    source_map_free(&locations);
+    arena_free(&arena);
+    parser_free(&p);
     label_map_free(&lbm);
 
     return (i.had_error) ? -1 : 0;
 }
+
+/**
+ * @brief Parses a program into commands, labels, externs and includes.
+ *
+ * A source held whole is split across threads if it is large enough, and is
+ * otherwise lexed into a token buffer first. Sources larger than `BATCH_LIMIT`,
+ * whose tokens would take several times their size, and streamed sources are
+ * parsed straight from the lexer.
+ *
+ * @param p Pointer to the `Parser` to initialize and parse with.
+ * @param l Pointer to the lexer over the source.
+ * @param src The whole source, or NULL if it is streamed.
+ * @param lbm Pointer to the label map to fill in.
+ * @param arena Pointer to the arena to allocate the commands from.
+ * @param locations Pointer to the source map to record where commands start in.
+ * @param conf The configuration, giving the number of threads to use.
+ * @return The head of the command list.
+ */
+static Command *parse_source(Parser *p, Lexer *l, const SourceText *src, LabelMap *lbm,
+                             Arena *arena, SourceMap *locations, CmdArgsConfig *conf) {
+    Command *commands;
+    bool     batch = src && src->length <= BATCH_LIMIT;
+    if (batch && parse_commands_parallel(p, src->text, src->length, lbm, arena, locations,
+                                         conf->parse_threads, &commands)) {
+        return commands;
+    }
+
+    // The parser copies what it keeps out of the tokens, so they can go after
+    TokenBuffer tokens;
+    token_buffer_init(&tokens);
+    if (batch && token_buffer_lex_lines(&tokens, src->text, src->length)) {
+        parser_init_tokens(p, &tokens, lbm, arena);
+    } else {
+        parser_init(p, l, lbm, arena);
+    }
+    p->source_map = locations;
+    commands      = parse_commands(p);
+    token_buffer_free(&tokens);
+    return commands;
+}
+
+/**
+ * @brief Reports where a run stopped with a runtime error, on stderr.
+ *
+ * @param intr Pointer to the `Interpreter` that stopped.
+ * @param commands The program.
+ * @param locations Pointer to the source map of the program.
+ * @param path The path of the source, to name it by.
+ */
+static void report_runtime_error(const Interpreter *intr, Command *commands,
+                                 const SourceMap *locations, const char *path) {
+    if (!intr->error) {
+        return;
+    }
+
+    // Keeps the report after the output that led up to it
+    output_flush();
+    const SourceLocation *location = source_map_find(locations, commands, intr->error_command);
+    if (location) {
+        fprintf(stderr, "%s:%" PRIu32 ":%" PRIu32 ": runtime error: %s\n", path, location->line,
+                location->column, intr->error);
+    } else {
+        fprintf(stderr, "%s: runtime error: %s\n", path, intr->error);
+    }
+}
+
+static void write_mem_profile(MemProfile *profile, Command *commands, const SourceMap *locations,
+                              const char *path) {
+    // Keeps the report after the output when both go to a terminal
+    output_flush();
+    if (!path) {
+        mem_profile_report(profile, commands, locations, stderr);
+        return;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open memory profile %s\n", path);
+        return;
+    }
+
+    mem_profile_report(profile, commands, locations, file);
+    fclose(file);
+}
+
+static void write_exec_profile(ExecProfile *profile, Command *commands, const LabelMap *labels,
+                               const SourceMap *locations, const char *path) {
+    // Keeps the report after the output when both go to a terminal
+    output_flush();
+    if (!path) {
+        exec_profile_report(profile, commands, labels, locations, stderr);
+        return;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open execution profile %s\n", path);
+        return;
+    }
+
+    exec_profile_report(profile, commands, labels, locations, file);
+    fclose(file);
+}
+
+static void write_sample_profile(SampleProfile *profile, Command *commands,
+                                 const LabelMap *labels, const SourceMap *locations,
+                                 const char *folded_path) {
+    // Keeps the report after the output when both go to a terminal
+    output_flush();
+    sample_profile_report(profile, commands, labels, locations, stderr);
+    if (!folded_path) {
+        fprintf(stderr, "\nFolded stacks:\n");
+        sample_profile_write_folded(profile, commands, labels, locations, stderr);
+        return;
+    }
+
+    FILE *file = fopen(folded_path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open folded stacks %s\n", folded_path);
+        return;
+    }
+
+    sample_profile_write_folded(profile, commands, labels, locations, file);
+    fclose(file);
+}
@@ -1,8 +1,14 @@
 #include "cmd_args_config.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "output.h"
+#include "sample_profile.h"
+
 void config_free(CmdArgsConfig *conf) {
     if (!conf) {
         return;
@@ -10,8 +16,162 @@ void config_free(CmdArgsConfig *conf) {
 
     free(conf->in_filename);
     free(conf->out_filename);
-    conf->in_filename  = NULL;
-    conf->out_filename = NULL;
+    free(conf->mem_in_filename);
+    free(conf->mem_out_filename);
+    free(conf->obj_filename);
+    free(conf->mem_profile_filename);
+    free(conf->exec_profile_filename);
+    free(conf->sample_folded_filename);
+    conf->in_filename            = NULL;
+    conf->out_filename           = NULL;
+    conf->mem_in_filename        = NULL;
+    conf->mem_out_filename       = NULL;
+    conf->obj_filename           = NULL;
+    conf->mem_profile_filename   = NULL;
+    conf->exec_profile_filename  = NULL;
+    conf->sample_folded_filename = NULL;
+}
+
+/**
+ * @brief Copies the given argument into a newly allocated string.
+ *
+ * @param arg The argument to copy.
+ * @param length The number of characters of `arg` to copy.
+ * @return The copy, or NULL if it could not be allocated.
+ */
+static char *copy_arg(const char *arg, size_t length) {
+    char *copy = calloc(length + 1, sizeof(char));
+    if (!copy) {
+        output_printf("Failed to allocate space for filename\n");
+        return NULL;
+    }
+
+    memcpy(copy, arg, length);
+    return copy;
+}
+
+/**
+ * @brief Determines whether a number is negative, which `strtoull` accepts and
+ * wraps around.
+ *
+ * @param text The number, possibly after whitespace.
+ * @return True if its first non-space character is a minus sign.
+ */
+static bool is_negative(const char *text) {
+    while (isspace((unsigned char) *text)) {
+        text++;
+    }
+    return *text == '-';
+}
+
+/**
+ * @brief Parses a memory image argument of the form `file[@offset]`.
+ *
+ * @param conf The config to store the filename and offset in.
+ * @param arg The argument to parse.
+ * @return True if the argument was valid, false otherwise.
+ */
+static bool parse_mem_in(CmdArgsConfig *conf, const char *arg) {
+    const char *at     = strrchr(arg, '@');
+    size_t      length = at ? (size_t) (at - arg) : strlen(arg);
+
+    conf->mem_in_offset = 0;
+    if (at) {
+        char              *endptr;
+        unsigned long long offset = strtoull(at + 1, &endptr, 0);
+        if (at[1] == '\0' || *endptr != '\0' || is_negative(at + 1)) {
+            output_printf("Invalid memory image offset %s\n", at + 1);
+            return false;
+        }
+        conf->mem_in_offset = (size_t) offset;
+    }
+
+    free(conf->mem_in_filename);
+    conf->mem_in_filename = copy_arg(arg, length);
+    return conf->mem_in_filename != NULL;
+}
+
+/**
+ * @brief Parses a memory size such as `4096`, `64K`, `512M` or `8G`.
+ *
+ * @param arg The argument to parse.
+ * @param size A pointer to store the size in bytes on success.
+ * @return True if the argument was a valid, non-zero size, false otherwise.
+ */
+static bool parse_mem_size(const char *arg, size_t *size) {
+    char              *endptr;
+    unsigned long long value = strtoull(arg, &endptr, 0);
+    unsigned           shift = 0;
+
+    switch (*endptr) {
+        case 'k':
+        case 'K':
+            shift = 10;
+            endptr++;
+            break;
+        case 'm':
+        case 'M':
+            shift = 20;
+            endptr++;
+            break;
+        case 'g':
+        case 'G':
+            shift = 30;
+            endptr++;
+            break;
+        default:
+            break;
+    }
+
+    if (endptr == arg || *endptr != '\0' || is_negative(arg) || value == 0 ||
+        value > (SIZE_MAX >> shift)) {
+        output_printf("Invalid memory size %s\n", arg);
+        return false;
+    }
+
+    *size = (size_t) value << shift;
+    return true;
+}
+
+/**
+ * @brief Parses which parts of the final state to print: `regs`, `mem` or
+ * `all`.
+ *
+ * @param arg The argument to parse.
+ * @param dump A pointer to store the `DUMP_` flags in on success.
+ * @return True if the argument was valid, false otherwise.
+ */
+static bool parse_dump(const char *arg, int *dump) {
+    if (strcmp(arg, "regs") == 0) {
+        *dump = DUMP_REGS;
+    } else if (strcmp(arg, "mem") == 0) {
+        *dump = DUMP_MEM;
+    } else if (strcmp(arg, "all") == 0) {
+        *dump = DUMP_ALL;
+    } else {
+        output_printf("Invalid dump %s; expected regs, mem or all\n", arg);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses the rate to take profiling samples at, in samples per second.
+ *
+ * @param arg The argument to parse.
+ * @param hz A pointer to store the rate in on success.
+ * @return True if the argument was valid, false otherwise.
+ */
+static bool parse_sample_hz(const char *arg, int *hz) {
+    char *endptr;
+    long  value = strtol(arg, &endptr, 10);
+    if (endptr == arg || *endptr != '\0' || value < 1 || value > SAMPLE_PROFILE_MAX_HZ) {
+        output_printf("Invalid sample rate %s; expected 1 to %d\n", arg, SAMPLE_PROFILE_MAX_HZ);
+        return false;
+    }
+
+    *hz = (int) value;
+    return true;
 }
 
 bool parse_cmd_args(CmdArgsConfig *conf, char **args, int arg_count) {
@@ -24,34 +184,137 @@ bool parse_cmd_args(CmdArgsConfig *conf, char **args, int arg_count) {
     }
 
     for (int i = 0; i < arg_count; i++) {
-        if (strncmp(args[i], "-l", 2) == 0) {
+        if (strcmp(args[i], "--mem-in") == 0) {
+            i++;
+            if (i >= arg_count) {
+                output_printf("Memory image not specified\n");
+                return false;
+            }
+
+            if (!parse_mem_in(conf, args[i])) {
+                return false;
+            }
+        } else if (strcmp(args[i], "--mem-size") == 0) {
+            i++;
+            if (i >= arg_count) {
+                output_printf("Memory size not specified\n");
+                return false;
+            }
+
+            if (!parse_mem_size(args[i], &conf->mem_size)) {
+                return false;
+            }
+        } else if (strcmp(args[i], "--mem-huge") == 0) {
+            conf->mem_huge_pages = true;
+        } else if (strcmp(args[i], "--mem-sparse") == 0) {
+            conf->mem_sparse = true;
+        } else if (strcmp(args[i], "--mem-guard") == 0) {
+            conf->mem_guard = true;
+        } else if (strcmp(args[i], "--mem-profile") == 0) {
+            conf->mem_profile = true;
+        } else if (strncmp(args[i], "--mem-profile=", 14) == 0) {
+            conf->mem_profile = true;
+            free(conf->mem_profile_filename);
+            conf->mem_profile_filename = copy_arg(args[i] + 14, strlen(args[i] + 14));
+            if (!conf->mem_profile_filename) {
+                return false;
+            }
+        } else if (strcmp(args[i], "--profile") == 0) {
+            conf->exec_profile = true;
+        } else if (strncmp(args[i], "--profile=", 10) == 0) {
+            conf->exec_profile = true;
+            free(conf->exec_profile_filename);
+            conf->exec_profile_filename = copy_arg(args[i] + 10, strlen(args[i] + 10));
+            if (!conf->exec_profile_filename) {
+                return false;
+            }
+        } else if (strcmp(args[i], "--sample-profile") == 0) {
+            conf->sample_hz = SAMPLE_PROFILE_DEFAULT_HZ;
+        } else if (strncmp(args[i], "--sample-profile=", 17) == 0) {
+            if (!parse_sample_hz(args[i] + 17, &conf->sample_hz)) {
+                return false;
+            }
+        } else if (strncmp(args[i], "--sample-folded=", 16) == 0) {
+            if (conf->sample_hz == 0) {
+                conf->sample_hz = SAMPLE_PROFILE_DEFAULT_HZ;
+            }
+            free(conf->sample_folded_filename);
+            conf->sample_folded_filename = copy_arg(args[i] + 16, strlen(args[i] + 16));
+            if (!conf->sample_folded_filename) {
+                return false;
+            }
+        } else if (strcmp(args[i], "--no-dump") == 0) {
+            conf->dump = 0;
+        } else if (strncmp(args[i], "--dump=", 7) == 0) {
+            if (!parse_dump(args[i] + 7, &conf->dump)) {
+                return false;
+            }
+        } else if (strcmp(args[i], "--parse-threads") == 0) {
+            i++;
+            if (i >= arg_count) {
+                output_printf("Thread count not specified\n");
+                return false;
+            }
+
+            char *endptr;
+            long  threads = strtol(args[i], &endptr, 10);
+            if (endptr == args[i] || *endptr != '\0' || threads < 0 || threads > INT_MAX) {
+                output_printf("Invalid thread count %s\n", args[i]);
+                return false;
+            }
+            conf->parse_threads = (int) threads;
+        } else if (strcmp(args[i], "--mem-out") == 0) {
+            i++;
+            if (i >= arg_count) {
+                output_printf("Memory image not specified\n");
+                return false;
+            }
+
+            free(conf->mem_out_filename);
+            conf->mem_out_filename = copy_arg(args[i], strlen(args[i]));
+            if (!conf->mem_out_filename) {
+                return false;
+            }
+        } else if (strncmp(args[i], "-l", 2) == 0) {
             conf->print_lex = true;
         } else if (strncmp(args[i], "-p", 2) == 0) {
             conf->print_parse = true;
         } else if (strncmp(args[i], "-i", 2) == 0) {
             i++;
             if (i >= arg_count) {
-                printf("Filename not specified\n");
+                output_printf("Filename not specified\n");
                 return false;
             }
 
             conf->in_filename = calloc(strlen(args[i]) + 1, sizeof(char));
             if (!conf->in_filename) {
-                printf("Failed to allocate space for filename\n");
+                output_printf("Failed to allocate space for filename\n");
                 return false;
             }
 
             strcpy(conf->in_filename, args[i]);
+        } else if (strncmp(args[i], "-c", 2) == 0) {
+            i++;
+            if (i >= arg_count) {
+                output_printf("Filename not specified\n");
+                return false;
+            }
+
+            free(conf->obj_filename);
+            conf->obj_filename = copy_arg(args[i], strlen(args[i]));
+            if (!conf->obj_filename) {
+                return false;
+            }
         } else if (strncmp(args[i], "-o", 2) == 0) {
             i++;
             if (i >= arg_count) {
-                printf("Filename not specified\n");
+                output_printf("Filename not specified\n");
                 return false;
             }
 
             conf->out_filename = calloc(strlen(args[i]) + 1, sizeof(char));
             if (!conf->out_filename) {
-                printf("Failed to allocate space for filename\n");
+                output_printf("Failed to allocate space for filename\n");
                 return false;
             }
 
@@ -1,61 +1,79 @@
 #include "command.h"
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
-#include <stdlib.h>
 
-void free_command(Command *command) {
-    while (command) {
-        Command *next = command->next;
+#include "label_map.h"
+#include "output.h"
+#include "source_map.h"
 
-        if (command->is_a_string && command->val_a.str_val) {
-            free(command->val_a.str_val);
-        }
-        if (command->is_b_string && command->val_b.str_val) {
-            free(command->val_b.str_val);
-        }
+static const char BASE_LETTERS[] = {'d', 'x', 'b', 's'};  // Indexed by `PrintBase`.
 
-        free(command);
-        command = next;
+bool print_base_from_letter(char letter, PrintBase *base) {
+    for (size_t i = 0; i < sizeof(BASE_LETTERS); i++) {
+        if (BASE_LETTERS[i] == letter) {
+            *base = (PrintBase) i;
+            return true;
+        }
     }
+    return false;
+}
+
+char print_base_letter(PrintBase base) {
+    return BASE_LETTERS[base];
 }
 
-void print_command(Command *cmd) {
-    printf("Command type: %u\n", cmd->type);
-    printf("Destination: %" PRId64 "\n", cmd->destination.num_val);
-    printf("Operands:\n");
-    printf("A:\n");
-    print_command_op(cmd->val_a, cmd->is_a_immediate, cmd->is_a_string);
-    printf("\n");
-    printf("B:\n");
+void print_command(Command *cmd, const LabelMap *labels, const SourceLocation *location) {
+    output_printf("Command type: %u\n", cmd->type);
+    if (location) {
+        output_printf("Line: %" PRIu32 ", column: %" PRIu32 "\n", location->line, location->column);
+    }
+    output_printf("Destination: %" PRId64 "\n", cmd->destination.num_val);
+    output_printf("Operands:\n");
+    output_printf("A:\n");
+    if (cmd->type == CMD_PRINT) {
+        // Shown as the letter it was written as
+        char    letter[] = {print_base_letter(cmd->val_a.print_base), '\0'};
+        Operand base     = {.str_val = letter};
+        print_command_op(base, false, true);
+    } else if (cmd->type == CMD_BRANCH || cmd->type == CMD_CALL) {
+        // Shown by the name of the label its symbol stands for
+        Operand label = {.str_val = labels->entries[cmd->val_a.num_val].id};
+        print_command_op(label, false, true);
+    } else {
+        print_command_op(cmd->val_a, cmd->is_a_immediate, cmd->is_a_string);
+    }
+    output_printf("\n");
+    output_printf("B:\n");
     print_command_op(cmd->val_b, cmd->is_b_immediate, cmd->is_b_string);
-    printf("\n");
-    printf("Branch condition: %d\n", cmd->branch_condition);
-    printf("\n\n");
+    output_printf("\n");
+    output_printf("Branch condition: %d\n", cmd->branch_condition);
+    output_printf("\n\n");
 }
 
 void print_command_op(Operand op, bool is_imm, bool is_str) {
-    printf("Is immediate: %d\n", is_imm);
-    printf("Is a string: %d\n", is_str);
-    printf("Value: ");
+    output_printf("Is immediate: %d\n", is_imm);
+    output_printf("Is a string: %d\n", is_str);
+    output_printf("Value: ");
     if (!is_str) {
-        printf("%" PRId64 "", op.num_val);
+        output_printf("%" PRId64 "", op.num_val);
     } else {
-        printf("%s", op.str_val);
+        output_printf("%s", op.str_val);
     }
 
-    printf("\n");
+    output_printf("\n");
 }
 
-void print_commands(Command *cmd) {
+void print_commands(Command *cmd, const LabelMap *labels, const SourceMap *locations) {
     if (!cmd) {
-        printf("No commands found.\n");
+        output_printf("No commands found.\n");
     }
 
-    while (cmd) {
-        print_command(cmd);
+    for (size_t index = 0; cmd; index++) {
+        print_command(cmd, labels, source_map_at(locations, index));
         cmd = cmd->next;
         if (cmd) {
-            printf("\n");
+            output_printf("\n");
         }
     }
 }
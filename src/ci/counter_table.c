@@ -0,0 +1,119 @@
+#include "counter_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_SLOTS 256
+
+static size_t hash_key(uint64_t key, size_t capacity);
+static size_t find_slot(const CounterTable *table, uint64_t key);
+static bool   grow(CounterTable *table);
+
+void counter_table_init(CounterTable *table, size_t size) {
+    table->keys     = NULL;
+    table->records  = NULL;
+    table->size     = size;
+    table->count    = 0;
+    table->capacity = 0;
+}
+
+void counter_table_free(CounterTable *table) {
+    free(table->keys);
+    free(table->records);
+    counter_table_init(table, table->size);
+}
+
+void *counter_table_find(const CounterTable *table, uint64_t key) {
+    if (table->count == 0) {
+        return NULL;
+    }
+
+    size_t slot = find_slot(table, key);
+    return table->keys[slot] ? (char *) table->records + slot * table->size : NULL;
+}
+
+void *counter_table_add(CounterTable *table, uint64_t key) {
+    if ((table->count + 1) * 2 > table->capacity && !grow(table)) {
+        return NULL;
+    }
+
+    size_t slot = find_slot(table, key);
+    if (!table->keys[slot]) {
+        table->keys[slot] = key;
+        table->count++;
+    }
+    return (char *) table->records + slot * table->size;
+}
+
+void *counter_table_copy(const CounterTable *table) {
+    // One extra record so an empty table still gets an array
+    char *copy = malloc((table->count + 1) * table->size);
+    if (!copy) {
+        return NULL;
+    }
+
+    size_t copied = 0;
+    for (size_t slot = 0; slot < table->capacity; slot++) {
+        if (table->keys[slot]) {
+            memcpy(copy + copied * table->size, (char *) table->records + slot * table->size,
+                   table->size);
+            copied++;
+        }
+    }
+    return copy;
+}
+
+/**
+ * @brief Hashes a key into a slot of a power of two sized table.
+ *
+ * @param key The key to hash.
+ * @param capacity The number of slots in the table.
+ * @return The first slot to probe.
+ */
+static size_t hash_key(uint64_t key, size_t capacity) {
+    return (size_t) ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (capacity - 1);
+}
+
+/**
+ * @brief Finds the slot of a key, which is empty if the key is new.
+ *
+ * @param table The table to search, which must have slots.
+ * @param key The key.
+ * @return The slot.
+ */
+static size_t find_slot(const CounterTable *table, uint64_t key) {
+    size_t slot = hash_key(key, table->capacity);
+    while (table->keys[slot] && table->keys[slot] != key) {
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return slot;
+}
+
+/**
+ * @brief Doubles the table, or creates it if it does not exist yet.
+ *
+ * @param table The table to grow.
+ * @return True on success, false if memory could not be allocated.
+ */
+static bool grow(CounterTable *table) {
+    size_t       grown = table->capacity ? table->capacity * 2 : INITIAL_SLOTS;
+    CounterTable next  = {calloc(grown, sizeof(uint64_t)), calloc(grown, table->size),
+                          table->size, table->count, grown};
+    if (!next.keys || !next.records) {
+        free(next.keys);
+        free(next.records);
+        return false;
+    }
+
+    for (size_t slot = 0; slot < table->capacity; slot++) {
+        if (table->keys[slot]) {
+            size_t moved     = find_slot(&next, table->keys[slot]);
+            next.keys[moved] = table->keys[slot];
+            memcpy((char *) next.records + moved * next.size,
+                   (char *) table->records + slot * table->size, table->size);
+        }
+    }
+    free(table->keys);
+    free(table->records);
+    *table = next;
+    return true;
+}
@@ -0,0 +1,175 @@
+#include "decode.h"
+
+#define GROUP      8                      // Digits converted at once in a word.
+#define ZEROS      0x3030303030303030ULL  // The character '0' in every byte.
+#define LOW_BYTES  0x00ff00ff00ff00ffULL  // The low byte of every 16 bits.
+#define LOW_HALVES 0x0000ffff0000ffffULL  // The low 16 bits of every 32 bits.
+#define LOW_WORD   0x00000000ffffffffULL  // The low 32 bits.
+
+static uint64_t load_group(const char *digits);
+static uint64_t decimal_group(const char *digits);
+static uint64_t hex_group(const char *digits);
+static uint64_t binary_group(const char *digits);
+static int      hex_digit(char c);
+static size_t   skip_zeros(const char *digits, size_t count);
+static int64_t  clamp(uint64_t value);
+
+int64_t decode_decimal(const char *digits, size_t count) {
+    // The digits that do not fill a group lead, so every group after is whole
+    size_t   lead  = count % GROUP;
+    uint64_t value = 0;
+    for (size_t i = 0; i < lead; i++) {
+        value = value * 10 + (uint64_t) (digits[i] - '0');
+    }
+
+    for (size_t i = lead; i < count; i += GROUP) {
+        uint64_t group = decimal_group(digits + i);
+        if (value > (UINT64_MAX - group) / 100000000) {
+            return INT64_MAX;
+        }
+        value = value * 100000000 + group;
+    }
+    return clamp(value);
+}
+
+int64_t decode_hex(const char *digits, size_t count) {
+    size_t zeros = skip_zeros(digits, count);
+    digits += zeros;
+    count -= zeros;
+
+    // Sixteen digits fill a word, so a value with more is too large
+    if (count > 16) {
+        return INT64_MAX;
+    }
+
+    size_t   lead  = count % GROUP;
+    uint64_t value = 0;
+    for (size_t i = 0; i < lead; i++) {
+        value = (value << 4) | (uint64_t) hex_digit(digits[i]);
+    }
+    for (size_t i = lead; i < count; i += GROUP) {
+        value = (value << 32) | hex_group(digits + i);
+    }
+    return clamp(value);
+}
+
+int64_t decode_binary(const char *digits, size_t count) {
+    size_t zeros = skip_zeros(digits, count);
+    digits += zeros;
+    count -= zeros;
+
+    if (count > 64) {
+        return INT64_MAX;
+    }
+
+    size_t   lead  = count % GROUP;
+    uint64_t value = 0;
+    for (size_t i = 0; i < lead; i++) {
+        value = (value << 1) | (uint64_t) (digits[i] - '0');
+    }
+    for (size_t i = lead; i < count; i += GROUP) {
+        value = (value << 8) | binary_group(digits + i);
+    }
+    return clamp(value);
+}
+
+/**
+ * @brief Loads eight characters into a word, the first in the lowest byte.
+ *
+ * Written byte by byte so it means the same on any byte order; compilers turn
+ * it into a single load on little-endian machines.
+ *
+ * @param digits The first of the characters.
+ * @return The word.
+ */
+static uint64_t load_group(const char *digits) {
+    uint64_t word = 0;
+    for (int i = 0; i < GROUP; i++) {
+        word |= (uint64_t) (unsigned char) digits[i] << (8 * i);
+    }
+    return word;
+}
+
+/**
+ * @brief Converts eight decimal digits at once.
+ *
+ * Neighbouring digits are paired into numbers below 100, the pairs into
+ * numbers below 10000 and those into the result, each step with one multiply
+ * across the whole word.
+ *
+ * @param digits The first of the digits.
+ * @return Their value, below 100000000.
+ */
+static uint64_t decimal_group(const char *digits) {
+    uint64_t word = load_group(digits) - ZEROS;
+    word          = (word * 10 + (word >> 8)) & LOW_BYTES;
+    word          = (word * 100 + (word >> 16)) & LOW_HALVES;
+    word          = (word * 10000 + (word >> 32)) & LOW_WORD;
+    return word;
+}
+
+/**
+ * @brief Converts eight hexadecimal digits at once.
+ *
+ * A digit's low four bits are its value, plus 9 for a letter, which is told
+ * apart by bit 6. The nibbles are then packed together in three steps.
+ *
+ * @param digits The first of the digits.
+ * @return Their value, below 2^32.
+ */
+static uint64_t hex_group(const char *digits) {
+    uint64_t word = load_group(digits);
+    word          = (word & 0x0f0f0f0f0f0f0f0fULL) + 9 * ((word >> 6) & 0x0101010101010101ULL);
+    word          = ((word << 4) | (word >> 8)) & LOW_BYTES;
+    word          = ((word << 8) | (word >> 16)) & LOW_HALVES;
+    word          = ((word << 16) | (word >> 32)) & LOW_WORD;
+    return word;
+}
+
+/**
+ * @brief Converts eight binary digits at once.
+ *
+ * One multiply moves the bit in each byte to its place in the top byte.
+ *
+ * @param digits The first of the digits.
+ * @return Their value, below 256.
+ */
+static uint64_t binary_group(const char *digits) {
+    uint64_t word = load_group(digits) - ZEROS;
+    return (word * 0x8040201008040201ULL) >> 56;
+}
+
+/**
+ * @brief Converts a single hexadecimal digit.
+ *
+ * @param c The digit.
+ * @return Its value.
+ */
+static int hex_digit(char c) {
+    return (c & 0xf) + ((c & 0x40) ? 9 : 0);
+}
+
+/**
+ * @brief Counts the zeros leading a run of digits.
+ *
+ * @param digits The first digit.
+ * @param count The number of digits.
+ * @return The number of leading zeros.
+ */
+static size_t skip_zeros(const char *digits, size_t count) {
+    size_t zeros = 0;
+    while (zeros < count && digits[zeros] == '0') {
+        zeros++;
+    }
+    return zeros;
+}
+
+/**
+ * @brief Limits a decoded value to what an immediate can hold.
+ *
+ * @param value The value.
+ * @return The value, or `INT64_MAX` if it is larger.
+ */
+static int64_t clamp(uint64_t value) {
+    return (value > (uint64_t) INT64_MAX) ? INT64_MAX : (int64_t) value;
+}
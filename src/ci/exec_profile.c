@@ -0,0 +1,297 @@
+#define _DEFAULT_SOURCE
+#include "exec_profile.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "command_type.h"
+
+#define OPCODE_COUNT  (CMD_STORE64_ABS + 1)
+
+/**
+ * @brief Where an instruction sits in the program.
+ */
+typedef struct {
+    long         index;   // Position in the program, or -1 if it is in an included object.
+    const Entry *label;   // The nearest label at or before the instruction, or NULL.
+    long         offset;  // Instructions from `label` to the instruction.
+} Placement;
+
+static void           place_sites(const ExecSiteCount *sites, size_t count, Placement *places,
+                                  Command *commands, const LabelMap *labels);
+static double         now(void);
+static double         percent(uint64_t part, uint64_t whole);
+static int            compare_sites(const void *a, const void *b);
+static int            compare_targets(const void *a, const void *b);
+static const char    *opcode_name(CommandType type);
+static const char    *branch_name(BranchCondition cond);
+
+void exec_profile_init(ExecProfile *profile) {
+    memset(profile, 0, sizeof(*profile));
+    counter_table_init(&profile->sites, sizeof(ExecSiteCount));
+}
+
+void exec_profile_free(ExecProfile *profile) {
+    counter_table_free(&profile->sites);
+    exec_profile_init(profile);
+}
+
+void exec_profile_start(ExecProfile *profile) {
+    profile->started = now();
+}
+
+void exec_profile_stop(ExecProfile *profile) {
+    profile->seconds += now() - profile->started;
+}
+
+ExecSiteCount *exec_profile_count(ExecProfile *profile, const Command *cmd) {
+    profile->instructions++;
+
+    ExecSiteCount *site = counter_table_add(&profile->sites, (uint64_t) (uintptr_t) cmd);
+    if (!site) {
+        profile->incomplete = true;
+        return NULL;
+    }
+    site->command = cmd;
+    site->count++;
+    return site;
+}
+
+void exec_profile_report(ExecProfile *profile, Command *commands, const LabelMap *labels,
+                         const SourceMap *locations, FILE *out) {
+    fprintf(out, "Execution profile:\n");
+    fprintf(out, "Instructions: %" PRIu64 "\n", profile->instructions);
+    if (profile->seconds > 0) {
+        fprintf(out, "Time: %.3f s, %.0f instructions per second while profiling\n",
+                profile->seconds, (double) profile->instructions / profile->seconds);
+    }
+    if (profile->incomplete) {
+        fprintf(out, "Ran out of memory while profiling; the report is incomplete\n");
+    }
+
+    ExecSiteCount *sites      = counter_table_copy(&profile->sites);
+    size_t         site_count = profile->sites.count;
+    if (!sites) {
+        fprintf(out, "Not enough memory to rank the profile\n");
+        return;
+    }
+
+    // Opcode totals follow from the instruction counts
+    uint64_t opcodes[OPCODE_COUNT] = {0};
+    for (size_t i = 0; i < site_count; i++) {
+        opcodes[sites[i].command->type] += sites[i].count;
+    }
+
+    fprintf(out, "\nOpcodes:\n");
+    for (;;) {
+        // Few enough opcodes that picking the next busiest each time is cheap
+        size_t busiest = 0;
+        for (size_t type = 1; type < OPCODE_COUNT; type++) {
+            if (opcodes[type] > opcodes[busiest]) {
+                busiest = type;
+            }
+        }
+        if (opcodes[busiest] == 0) {
+            break;
+        }
+        fprintf(out, "    %-12s %" PRIu64 " (%.1f%%)\n", opcode_name((CommandType) busiest),
+                opcodes[busiest], percent(opcodes[busiest], profile->instructions));
+        opcodes[busiest] = 0;
+    }
+
+    qsort(sites, site_count, sizeof(ExecSiteCount), compare_sites);
+    size_t shown = (site_count < EXEC_PROFILE_TOP) ? site_count : EXEC_PROFILE_TOP;
+
+    Placement places[EXEC_PROFILE_TOP];
+    place_sites(sites, shown, places, commands, labels);
+
+    fprintf(out, "\nHottest instructions (%zu run):\n", site_count);
+    for (size_t i = 0; i < shown; i++) {
+        const Command *cmd = sites[i].command;
+        if (places[i].index >= 0) {
+            fprintf(out, "    #%ld", places[i].index);
+            const SourceLocation *location = source_map_at(locations, (size_t) places[i].index);
+            if (location) {
+                fprintf(out, " line %" PRIu32, location->line);
+            }
+        } else {
+            fprintf(out, "    included");
+        }
+        if (places[i].label) {
+            fprintf(out, " %s+%ld", places[i].label->id, places[i].offset);
+        }
+
+        const char *name = (cmd->type == CMD_BRANCH) ? branch_name(cmd->branch_condition)
+                                                      : opcode_name(cmd->type);
+        fprintf(out, " %s: %" PRIu64 " (%.1f%%)", name, sites[i].count,
+                percent(sites[i].count, profile->instructions));
+        if (cmd->type == CMD_BRANCH) {
+            fprintf(out, ", taken %" PRIu64 ", not taken %" PRIu64, sites[i].taken,
+                    sites[i].count - sites[i].taken);
+        }
+        fprintf(out, "\n");
+    }
+
+    free(sites);
+}
+
+/**
+ * @brief Finds the position and nearest label of each ranked instruction in
+ * one pass over the program.
+ *
+ * @param sites The ranked instructions.
+ * @param count The number of instructions to place, at most `EXEC_PROFILE_TOP`.
+ * @param places Where to store the placements, one per instruction.
+ * @param commands The program.
+ * @param labels The labels of the program.
+ */
+static void place_sites(const ExecSiteCount *sites, size_t count, Placement *places,
+                        Command *commands, const LabelMap *labels) {
+    for (size_t i = 0; i < count; i++) {
+        places[i] = (Placement) {-1, NULL, 0};
+    }
+
+    // The labeled instructions, sorted so each step of the walk can look one up
+    const Entry **targets      = malloc(((size_t) labels->count + 1) * sizeof(Entry *));
+    size_t        target_count = 0;
+    for (int i = 0; targets && i < labels->count; i++) {
+        if (labels->entries[i].command) {
+            targets[target_count++] = &labels->entries[i];
+        }
+    }
+    if (targets) {
+        qsort(targets, target_count, sizeof(Entry *), compare_targets);
+    }
+
+    const Entry *label  = NULL;
+    long         offset = 0;
+    long         index  = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next, index++, offset++) {
+        Entry         key   = {.command = cmd};
+        const Entry  *probe = &key;
+        const Entry **found = targets ? bsearch(&probe, targets, target_count, sizeof(Entry *),
+                                                compare_targets)
+                                      : NULL;
+        if (found) {
+            label  = *found;
+            offset = 0;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (sites[i].command == cmd) {
+                places[i] = (Placement) {index, label, offset};
+            }
+        }
+    }
+    free(targets);
+}
+
+/**
+ * @brief Returns a monotonic time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Returns what percentage one count is of another, or 0 of nothing.
+ */
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? (double) part * 100 / (double) whole : 0;
+}
+
+/**
+ * @brief Orders instructions from most to least run, and ties by address,
+ * which keeps instructions parsed together in program order.
+ */
+static int compare_sites(const void *a, const void *b) {
+    const ExecSiteCount *left  = a;
+    const ExecSiteCount *right = b;
+    if (left->count != right->count) {
+        return (left->count < right->count) ? 1 : -1;
+    }
+    uintptr_t l = (uintptr_t) left->command;
+    uintptr_t r = (uintptr_t) right->command;
+    return (l > r) - (l < r);
+}
+
+/**
+ * @brief Orders labels by the address of the instruction they name.
+ */
+static int compare_targets(const void *a, const void *b) {
+    uintptr_t left  = (uintptr_t) (*(const Entry *const *) a)->command;
+    uintptr_t right = (uintptr_t) (*(const Entry *const *) b)->command;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @brief Returns the name of an opcode for the report.
+ */
+static const char *opcode_name(CommandType type) {
+    static const char *const names[OPCODE_COUNT] = {
+        [CMD_ADD] = "add",
+        [CMD_AND] = "and",
+        [CMD_ASR] = "asr",
+        [CMD_BRANCH] = "branch",
+        [CMD_CALL] = "call",
+        [CMD_CMP] = "cmp",
+        [CMD_CMP_U] = "cmp_u",
+        [CMD_ERR] = "error",
+        [CMD_EOR] = "eor",
+        [CMD_LOAD] = "load",
+        [CMD_LSL] = "lsl",
+        [CMD_LSR] = "lsr",
+        [CMD_MOV] = "mov",
+        [CMD_ORR] = "orr",
+        [CMD_PRINT] = "print",
+        [CMD_PUT] = "put",
+        [CMD_RET] = "ret",
+        [CMD_STORE] = "store",
+        [CMD_SUB] = "sub",
+        [CMD_LOAD8] = "load8",
+        [CMD_LOAD16] = "load16",
+        [CMD_LOAD32] = "load32",
+        [CMD_LOAD64] = "load64",
+        [CMD_STORE8] = "store8",
+        [CMD_STORE16] = "store16",
+        [CMD_STORE32] = "store32",
+        [CMD_STORE64] = "store64",
+        [CMD_LOAD8_ABS] = "load8_abs",
+        [CMD_LOAD16_ABS] = "load16_abs",
+        [CMD_LOAD32_ABS] = "load32_abs",
+        [CMD_LOAD64_ABS] = "load64_abs",
+        [CMD_STORE8_ABS] = "store8_abs",
+        [CMD_STORE16_ABS] = "store16_abs",
+        [CMD_STORE32_ABS] = "store32_abs",
+        [CMD_STORE64_ABS] = "store64_abs",
+    };
+    return ((size_t) type < OPCODE_COUNT && names[type]) ? names[type] : "unknown";
+}
+
+/**
+ * @brief Returns the mnemonic of a branch for the report.
+ */
+static const char *branch_name(BranchCondition cond) {
+    switch (cond) {
+        case BRANCH_ALWAYS:
+            return "b";
+        case BRANCH_EQUAL:
+            return "b.eq";
+        case BRANCH_NOT_EQUAL:
+            return "b.ne";
+        case BRANCH_GREATER:
+            return "b.gt";
+        case BRANCH_LESS:
+            return "b.lt";
+        case BRANCH_GREATER_EQUAL:
+            return "b.ge";
+        case BRANCH_LESS_EQUAL:
+            return "b.le";
+        case BRANCH_NONE:
+            break;
+    }
+    return "branch";
+}
@@ -0,0 +1,122 @@
+#include "format.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Every pair of decimal digits, "00" to "99", in order.
+static const char digit_pairs[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Every byte as two hex digits, "00" to "ff", in order.
+static const char hex_pairs[] = "000102030405060708090a0b0c0d0e0f"
+                                "101112131415161718191a1b1c1d1e1f"
+                                "202122232425262728292a2b2c2d2e2f"
+                                "303132333435363738393a3b3c3d3e3f"
+                                "404142434445464748494a4b4c4d4e4f"
+                                "505152535455565758595a5b5c5d5e5f"
+                                "606162636465666768696a6b6c6d6e6f"
+                                "707172737475767778797a7b7c7d7e7f"
+                                "808182838485868788898a8b8c8d8e8f"
+                                "909192939495969798999a9b9c9d9e9f"
+                                "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+                                "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+                                "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+                                "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+                                "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+                                "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static uint64_t spread_byte(uint8_t byte);
+
+size_t format_decimal(char *out, int64_t value) {
+    // The magnitude as unsigned, so that INT64_MIN has one too
+    uint64_t magnitude = (value < 0) ? 0 - (uint64_t) value : (uint64_t) value;
+
+    char  digits[FORMAT_DECIMAL_MAX];
+    char *start = digits + sizeof(digits);
+    while (magnitude >= 100) {
+        size_t pair = (size_t) (magnitude % 100) * 2;
+        magnitude /= 100;
+        start -= 2;
+        memcpy(start, &digit_pairs[pair], 2);
+    }
+    if (magnitude >= 10) {
+        start -= 2;
+        memcpy(start, &digit_pairs[magnitude * 2], 2);
+    } else {
+        *--start = (char) ('0' + magnitude);
+    }
+    if (value < 0) {
+        *--start = '-';
+    }
+
+    size_t length = (size_t) (digits + sizeof(digits) - start);
+    memcpy(out, start, length);
+    return length;
+}
+
+size_t format_hex(char *out, uint64_t value) {
+    return format_hex_padded(out, value, 0);
+}
+
+size_t format_hex_padded(char *out, uint64_t value, int width) {
+    // One digit per nibble below the highest set bit, and one for zero
+    size_t length = (size_t) (64 - __builtin_clzll(value | 1) + 3) / 4;
+    if (width > 0 && (size_t) width > length) {
+        length = (size_t) width;
+    }
+    for (size_t i = length; i > 0; i--) {
+        out[i - 1] = hex_digits[value & 0xF];
+        value >>= 4;
+    }
+    return length;
+}
+
+void format_hex_bytes(char *out, const uint8_t *bytes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out + i * 2, &hex_pairs[bytes[i] * 2], 2);
+    }
+}
+
+size_t format_binary(char *out, uint64_t value) {
+    size_t length = (size_t) (64 - __builtin_clzll(value | 1));
+
+    // Only the bytes holding the digits are spread, most significant first
+    char digits[FORMAT_BINARY_MAX];
+    for (size_t byte = (FORMAT_BINARY_MAX - length) / 8; byte < 8; byte++) {
+        uint64_t characters = spread_byte((uint8_t) (value >> (56 - byte * 8)));
+        memcpy(digits + byte * 8, &characters, 8);
+    }
+    memcpy(out, digits + FORMAT_BINARY_MAX - length, length);
+    return length;
+}
+
+/**
+ * @brief Turns the bits of a byte into eight '0' and '1' characters.
+ *
+ * @param byte The byte to spread.
+ * @return The characters, most significant bit first in memory.
+ */
+static uint64_t spread_byte(uint8_t byte) {
+    // Move bit k into the lowest bit of byte k, halving the distance each step
+    uint64_t bits = byte;
+    bits          = (bits | (bits << 28)) & 0x0000000F0000000FULL;
+    bits          = (bits | (bits << 14)) & 0x0003000300030003ULL;
+    bits          = (bits | (bits << 7)) & 0x0101010101010101ULL;
+
+    // The most significant bit goes first, which is where a big-endian
+    // machine already stores byte 7
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    bits = __builtin_bswap64(bits);
+#endif
+    return bits | 0x3030303030303030ULL;
+}
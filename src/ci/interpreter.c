@@ -1,5 +1,6 @@
 #include "interpreter.h"
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -8,22 +9,53 @@
 
 #include "command_type.h"
 #include "mem.h"
+#include "output.h"
 
+/**
+ * @brief Bundles the arguments of `execute` for `mem_run_guarded`.
+ */
+typedef struct {
+    Interpreter    *intr;      // The interpreter running the commands.
+    Command        *commands;  // The first command to run.
+    MemGuardRegion *guard;     // Guarded memory to access inline, or NULL.
+} Execution;
+
+static void    execute(void *context);
+static void    execute_guarded(void *context);
+static void    execute_profiled(void *context);
+static void    execute_sampled(void *context);
+static void    run_commands(Interpreter *intr, Command *current, const MemGuardRegion *guard,
+                            MemProfile *profile, ExecProfile *exec, SampleProfile *sampler);
 static bool    cond_holds(Interpreter *intr, BranchCondition cond);
 static int64_t fetch_number_value(Interpreter *intr, Operand *op, bool is_im);
-static bool    print_base(Interpreter *intr, Command *cmd);
+static bool    print_base(Interpreter *intr, Command *cmd, MemProfile *profile);
+static void    load_fixed(Interpreter *intr, Command *cmd, size_t size, const MemGuardRegion *guard,
+                          MemProfile *profile);
+static void    store_fixed(Interpreter *intr, Command *cmd, size_t size,
+                           const MemGuardRegion *guard, MemProfile *profile);
+static void    load_resolved(Interpreter *intr, Command *cmd, size_t size);
+static void    store_resolved(Interpreter *intr, Command *cmd, size_t size);
+static void    note_guarded(Interpreter *intr, const Command *cmd);
+static void    print_flag(const char *name, bool value);
+static void    fail(Interpreter *intr, const Command *cmd, const char *error);
 
 void interpreter_init(Interpreter *intr, LabelMap *map) {
     if (!intr) {
         return;
     }
 
-    intr->had_error  = false;
-    intr->label_map  = map;
-    intr->is_greater = false;
-    intr->is_equal   = false;
-    intr->is_less    = false;
-    intr->the_stack  = NULL;
+    intr->had_error      = false;
+    intr->label_map      = map;
+    intr->is_greater     = false;
+    intr->is_equal       = false;
+    intr->is_less        = false;
+    intr->the_stack      = NULL;
+    intr->mem_profile    = NULL;
+    intr->exec_profile   = NULL;
+    intr->sample_profile = NULL;
+    intr->error_command   = NULL;
+    intr->error           = NULL;
+    intr->guarded_command = NULL;
 
     for (size_t i = 0; i < NUM_VARIABLES; i++) {
         intr->variables[i] = 0;
@@ -38,13 +70,161 @@ static void free_stack(Interpreter *intr) {
     }
 }
 
+void specialize_commands(Command *commands, bool resolve) {
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        int64_t size;
+        bool    is_store;
+        if (cmd->type == CMD_LOAD && cmd->is_a_immediate) {
+            size     = cmd->val_a.num_val;
+            is_store = false;
+        } else if (cmd->type == CMD_STORE) {
+            size     = cmd->destination.num_val;
+            is_store = true;
+        } else {
+            continue;
+        }
+
+        // The widths are consecutive in the enum, so the offset picks one
+        int width;
+        switch (size) {
+            case 1:
+                width = 0;
+                break;
+            case 2:
+                width = 1;
+                break;
+            case 4:
+                width = 2;
+                break;
+            case 8:
+                width = 3;
+                break;
+            default:
+                continue;
+        }
+
+        uint8_t *address = NULL;
+        if (resolve && cmd->is_b_immediate && cmd->val_b.num_val >= 0) {
+            address = mem_resolve((size_t) cmd->val_b.num_val, (size_t) size, is_store);
+        }
+
+        if (address) {
+            cmd->type          = (is_store ? CMD_STORE8_ABS : CMD_LOAD8_ABS) + width;
+            cmd->val_b.address = address;
+        } else {
+            cmd->type = (is_store ? CMD_STORE8 : CMD_LOAD8) + width;
+        }
+    }
+}
+
 void interpret(Interpreter *intr, Command *commands) {
     if (!intr || !commands) {
         return;
     }
 
-    Command *current = commands;
+    // Profiling runs a separately compiled engine so normal runs pay nothing for
+    // it, as does guarded memory, whose accesses are made inline
+    MemGuardRegion region;
+    Execution      execution = {intr, commands, mem_guard_region(&region) ? &region : NULL};
+
+    void (*engine)(void *) = execution.guard ? execute_guarded : execute;
+    if (intr->mem_profile || intr->exec_profile) {
+        engine = execute_profiled;
+    } else if (intr->sample_profile) {
+        engine = execute_sampled;
+    }
+    if (intr->exec_profile) {
+        exec_profile_start(intr->exec_profile);
+    }
+    if (intr->sample_profile) {
+        sample_profile_start(intr->sample_profile);
+    }
+    intr->guarded_command = NULL;
+    if (!mem_run_guarded(engine, &execution)) {
+        // An access hit the guard page; the same error a bounds check raises
+        fail(intr, intr->guarded_command, "memory access out of range");
+    }
+    if (intr->sample_profile) {
+        sample_profile_stop(intr->sample_profile);
+    }
+    if (intr->exec_profile) {
+        exec_profile_stop(intr->exec_profile);
+    }
+
+    free_stack(intr);
+}
+
+/**
+ * @brief Runs commands until the program ends or an error occurs.
+ *
+ * @param context A pointer to the `Execution` to run.
+ */
+static void execute(void *context) {
+    run_commands(((Execution *) context)->intr, ((Execution *) context)->commands, NULL, NULL,
+                 NULL, NULL);
+}
+
+/**
+ * @brief Runs commands like `execute`, with loads and stores going straight to
+ * guarded memory.
+ *
+ * @param context A pointer to the `Execution` to run.
+ */
+static void execute_guarded(void *context) {
+    // A local copy, which the region's fields can be kept in registers from
+    Execution     *execution = context;
+    MemGuardRegion guard     = *execution->guard;
+    run_commands(execution->intr, execution->commands, &guard, NULL, NULL, NULL);
+}
+
+/**
+ * @brief Runs commands like `execute`, recording into whichever profiles the
+ * interpreter has.
+ *
+ * @param context A pointer to the `Execution` to run.
+ */
+static void execute_profiled(void *context) {
+    Interpreter *intr = ((Execution *) context)->intr;
+    run_commands(intr, ((Execution *) context)->commands, ((Execution *) context)->guard,
+                 intr->mem_profile, intr->exec_profile, intr->sample_profile);
+}
+
+/**
+ * @brief Runs commands like `execute`, taking samples for the sampling profile
+ * and recording nothing else.
+ *
+ * @param context A pointer to the `Execution` to run.
+ */
+static void execute_sampled(void *context) {
+    Interpreter *intr = ((Execution *) context)->intr;
+    run_commands(intr, ((Execution *) context)->commands, ((Execution *) context)->guard, NULL,
+                 NULL, intr->sample_profile);
+}
+
+/**
+ * @brief The interpreter loop shared by both engines.
+ *
+ * Always inlined, so the engine passing NULL profiles is compiled without any
+ * of the recording.
+ *
+ * @param intr Pointer to the `Interpreter` running the commands.
+ * @param current The first command to run.
+ * @param guard Guarded memory to access inline, or NULL to go through `mem_load`
+ * and `mem_store`.
+ * @param profile The profile to record memory accesses into, or NULL.
+ * @param exec The profile to count executed instructions into, or NULL.
+ * @param sampler The profile to take samples into when its timer asks, or NULL.
+ * Only branches, calls and returns check whether it has asked, so a sample is
+ * charged to the one ending the run of commands it fell in.
+ */
+__attribute__((always_inline)) static inline void run_commands(Interpreter          *intr,
+                                                               Command              *current,
+                                                               const MemGuardRegion *guard,
+                                                               MemProfile           *profile,
+                                                               ExecProfile          *exec,
+                                                               SampleProfile        *sampler) {
     while (current && !intr->had_error) {
+        ExecSiteCount *site = exec ? exec_profile_count(exec, current) : NULL;
         switch (current->type) {
             case CMD_ADD: {
                 int64_t val_a = fetch_number_value(intr, &current->val_a, current->is_a_immediate);
@@ -99,7 +279,7 @@ void interpret(Interpreter *intr, Command *commands) {
             }
 
             case CMD_PRINT: {
-                if (!print_base(intr, current)) {
+                if (!print_base(intr, current, profile)) {
                     intr->had_error = true;
                 }
                 current = current->next;
@@ -168,15 +348,22 @@ void interpret(Interpreter *intr, Command *commands) {
                     fetch_number_value(intr, &current->val_b, current->is_b_immediate);
 
                 if (size != 1 && size != 2 && size != 4 && size != 8) {
-                    intr->had_error = true;
+                    fail(intr, current, "invalid load size");
                     break;
                 }
 
                 uint8_t data[8] = {0};
+                if (guard) {
+                    note_guarded(intr, current);
+                }
                 if (!mem_load(data, (size_t) address, (size_t) size)) {
-                    intr->had_error = true;
+                    fail(intr, current, "memory access out of range");
                     break;
                 }
+                if (profile) {
+                    mem_profile_record(profile, current, MEM_ACCESS_LOAD, (size_t) address,
+                                       (size_t) size);
+                }
 
                 intr->variables[(int) current->destination.base] = *((int64_t *) data);
                 current                                          = current->next;
@@ -188,31 +375,119 @@ void interpret(Interpreter *intr, Command *commands) {
                 int64_t address =
                     fetch_number_value(intr, &current->val_b, current->is_b_immediate);
                 int64_t size = current->destination.num_val;
+                if (guard) {
+                    note_guarded(intr, current);
+                }
                 if (!mem_store((uint8_t *) &value, (size_t) address, (size_t) size)) {
-                    intr->had_error = true;
+                    fail(intr, current, "memory access out of range");
                     break;
                 }
+                if (profile) {
+                    mem_profile_record(profile, current, MEM_ACCESS_STORE, (size_t) address,
+                                       (size_t) size);
+                }
                 current = current->next;
                 break;
             }
 
+            case CMD_LOAD8:
+                load_fixed(intr, current, 1, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_LOAD16:
+                load_fixed(intr, current, 2, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_LOAD32:
+                load_fixed(intr, current, 4, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_LOAD64:
+                load_fixed(intr, current, 8, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_STORE8:
+                store_fixed(intr, current, 1, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_STORE16:
+                store_fixed(intr, current, 2, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_STORE32:
+                store_fixed(intr, current, 4, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_STORE64:
+                store_fixed(intr, current, 8, guard, profile);
+                current = current->next;
+                break;
+
+            case CMD_LOAD8_ABS:
+                load_resolved(intr, current, 1);
+                current = current->next;
+                break;
+
+            case CMD_LOAD16_ABS:
+                load_resolved(intr, current, 2);
+                current = current->next;
+                break;
+
+            case CMD_LOAD32_ABS:
+                load_resolved(intr, current, 4);
+                current = current->next;
+                break;
+
+            case CMD_LOAD64_ABS:
+                load_resolved(intr, current, 8);
+                current = current->next;
+                break;
+
+            case CMD_STORE8_ABS:
+                store_resolved(intr, current, 1);
+                current = current->next;
+                break;
+
+            case CMD_STORE16_ABS:
+                store_resolved(intr, current, 2);
+                current = current->next;
+                break;
+
+            case CMD_STORE32_ABS:
+                store_resolved(intr, current, 4);
+                current = current->next;
+                break;
+
+            case CMD_STORE64_ABS:
+                store_resolved(intr, current, 8);
+                current = current->next;
+                break;
+
             case CMD_PUT: {
                 const char *str = current->val_a.str_val;
                 int64_t     address =
                     fetch_number_value(intr, &current->val_b, current->is_b_immediate);
 
                 if (!str || address < 0) {
-                    intr->had_error = true;
+                    fail(intr, current, "memory access out of range");
                     break;
                 }
 
-                size_t length = strlen(str) + 1;
-
-                for (size_t i = 0; i < length; i++) {
-                    if (!mem_store((uint8_t *) &str[i], address + i, 1)) {
-                        intr->had_error = true;
-                        break;
-                    }
+                // The length was measured when parsing; include the NUL
+                size_t length = (size_t) current->destination.num_val + 1;
+                if (!mem_store_range((const uint8_t *) str, (size_t) address, length)) {
+                    fail(intr, current, "memory access out of range");
+                    break;
+                }
+                if (profile) {
+                    mem_profile_record(profile, current, MEM_ACCESS_PUT, (size_t) address, length);
                 }
 
                 current = current->next;
@@ -220,21 +495,21 @@ void interpret(Interpreter *intr, Command *commands) {
             }
 
             case CMD_BRANCH: {
+                if (sampler && sampler->pending) {
+                    sample_profile_take(sampler, current);
+                }
                 if (current->branch_condition == BRANCH_ALWAYS ||
                     cond_holds(intr, current->branch_condition)) {
-                    Entry *entry = get_label(intr->label_map, current->val_a.str_val);
-                    if (entry == NULL) {
-                        printf("Label not found: %s\n", current->val_a.str_val);
-                        intr->had_error = true;
-                        free_stack(intr);
-                        return;
+                    if (site) {
+                        site->taken++;
                     }
+                    Entry *entry = &intr->label_map->entries[current->val_a.num_val];
                     if (entry->command == NULL) {
-                        if (current->val_a.str_val[0] == '.') {
+                        if (entry->id[0] == '.') {
                             current = NULL;
                         } else {
-                            printf("Label not found: %s\n", current->val_a.str_val);
-                            intr->had_error = true;
+                            output_printf("Label not found: %s\n", entry->id);
+                            fail(intr, current, "label not found");
                             free_stack(intr);
                             return;
                         }
@@ -248,9 +523,13 @@ void interpret(Interpreter *intr, Command *commands) {
             }
 
             case CMD_CALL: {
+                // Sampled in the caller, before the call is entered
+                if (sampler && sampler->pending) {
+                    sample_profile_take(sampler, current);
+                }
                 StackEntry *new_entry = malloc(sizeof(StackEntry));
                 if (!new_entry) {
-                    intr->had_error = true;
+                    fail(intr, current, "out of memory for the call stack");
                     free_stack(intr);
                     return;
                 }
@@ -258,12 +537,15 @@ void interpret(Interpreter *intr, Command *commands) {
                 new_entry->command = current->next;
                 new_entry->next    = intr->the_stack;
                 intr->the_stack    = new_entry;
-                Entry *entry       = get_label(intr->label_map, current->val_a.str_val);
-                if (entry && entry->command != NULL) {
+                Entry *entry       = &intr->label_map->entries[current->val_a.num_val];
+                if (entry->command != NULL) {
+                    if (sampler) {
+                        sample_profile_enter(sampler, current);
+                    }
                     current = entry->command;
                 } else {
-                    printf("Label not found: %s\n", current->val_a.str_val);
-                    intr->had_error = true;
+                    output_printf("Label not found: %s\n", entry->id);
+                    fail(intr, current, "label not found");
                     free_stack(intr);
                     return;
                 }
@@ -271,6 +553,10 @@ void interpret(Interpreter *intr, Command *commands) {
             }
 
             case CMD_RET: {
+                // Sampled in the callee, before the call is left
+                if (sampler && sampler->pending) {
+                    sample_profile_take(sampler, current);
+                }
                 if (intr->the_stack) {
                     StackEntry *return_entry = intr->the_stack;
                     intr->the_stack          = return_entry->next;
@@ -281,6 +567,9 @@ void interpret(Interpreter *intr, Command *commands) {
 
                     current = return_entry->command;
                     free(return_entry);
+                    if (sampler) {
+                        sample_profile_leave(sampler);
+                    }
                 } else {
                     current = NULL;
                 }
@@ -288,13 +577,107 @@ void interpret(Interpreter *intr, Command *commands) {
             }
 
             default:
-                intr->had_error = true;
+                fail(intr, current, "unknown instruction");
                 current         = current->next;
                 break;
         }
     }
+}
 
-    free_stack(intr);
+/**
+ * @brief Executes a fixed-width load from a computed address.
+ *
+ * Called with a constant size so each width compiles to its own access. With
+ * guarded memory the address is clamped onto the guard page, a conditional
+ * move, and the load made directly, so there is no bounds branch to take.
+ *
+ * @param intr Pointer to the `Interpreter`.
+ * @param cmd The load command.
+ * @param size The number of bytes to load.
+ * @param guard Guarded memory to load from, or NULL.
+ * @param profile The profile to record the access into, or NULL.
+ */
+__attribute__((always_inline)) static inline void load_fixed(Interpreter          *intr,
+                                                             Command              *cmd,
+                                                             size_t                size,
+                                                             const MemGuardRegion *guard,
+                                                             MemProfile           *profile) {
+    int64_t  address = fetch_number_value(intr, &cmd->val_b, cmd->is_b_immediate);
+    uint64_t value   = 0;
+    if (guard) {
+        size_t index = ((size_t) address < guard->size) ? (size_t) address : guard->size;
+        note_guarded(intr, cmd);
+        memcpy(&value, guard->base + index, size);
+    } else if (!mem_load((uint8_t *) &value, (size_t) address, size)) {
+        fail(intr, cmd, "memory access out of range");
+        return;
+    }
+    if (profile) {
+        mem_profile_record(profile, cmd, MEM_ACCESS_LOAD, (size_t) address, size);
+    }
+    intr->variables[(int) cmd->destination.base] = (int64_t) value;
+}
+
+/**
+ * @brief Executes a fixed-width store to a computed address.
+ *
+ * Guarded memory is stored to like `load_fixed` loads from it. The pages are
+ * only marked once the store is through, so a store that faults marks none.
+ *
+ * @param intr Pointer to the `Interpreter`.
+ * @param cmd The store command.
+ * @param size The number of bytes to store.
+ * @param guard Guarded memory to store to, or NULL.
+ * @param profile The profile to record the access into, or NULL.
+ */
+__attribute__((always_inline)) static inline void store_fixed(Interpreter          *intr,
+                                                              Command              *cmd,
+                                                              size_t                size,
+                                                              const MemGuardRegion *guard,
+                                                              MemProfile           *profile) {
+    int64_t value   = fetch_number_value(intr, &cmd->val_a, cmd->is_a_immediate);
+    int64_t address = fetch_number_value(intr, &cmd->val_b, cmd->is_b_immediate);
+    if (guard) {
+        size_t index = ((size_t) address < guard->size) ? (size_t) address : guard->size;
+        note_guarded(intr, cmd);
+        memcpy(guard->base + index, &value, size);
+
+        size_t first = index >> MEM_PAGE_BITS;
+        size_t last  = (index + size - 1) >> MEM_PAGE_BITS;
+        guard->dirty[first / 64] |= (uint64_t) 1 << (first % 64);
+        guard->dirty[last / 64] |= (uint64_t) 1 << (last % 64);
+    } else if (!mem_store((uint8_t *) &value, (size_t) address, size)) {
+        fail(intr, cmd, "memory access out of range");
+        return;
+    }
+    if (profile) {
+        mem_profile_record(profile, cmd, MEM_ACCESS_STORE, (size_t) address, size);
+    }
+}
+
+/**
+ * @brief Executes a fixed-width load from an address resolved in advance.
+ *
+ * @param intr Pointer to the `Interpreter`.
+ * @param cmd The load command.
+ * @param size The number of bytes to load.
+ */
+static void load_resolved(Interpreter *intr, Command *cmd, size_t size) {
+    uint64_t value = 0;
+    memcpy(&value, cmd->val_b.address, size);
+    intr->variables[(int) cmd->destination.base] = (int64_t) value;
+}
+
+/**
+ * @brief Executes a fixed-width store to an address resolved in advance.
+ *
+ * @param intr Pointer to the `Interpreter`.
+ * @param cmd The store command.
+ * @param size The number of bytes to store.
+ */
+static void store_resolved(Interpreter *intr, Command *cmd, size_t size) {
+    int64_t value = fetch_number_value(intr, &cmd->val_a, cmd->is_a_immediate);
+    memcpy(cmd->val_b.address, &value, size);
 }
 
 void print_interpreter_state(Interpreter *intr) {
@@ -302,28 +685,73 @@ void print_interpreter_state(Interpreter *intr) {
         return;
     }
 
-    printf("Error: %d\n", intr->had_error);
-    printf("Flags:\n");
-    printf("Is greater: %d\n", intr->is_greater);
-    printf("Is equal: %d\n", intr->is_equal);
-    printf("Is less: %d\n", intr->is_less);
+    // Fixed text and formatted numbers, with no format string to interpret
+    print_flag("Error: ", intr->had_error);
+    output_string("Flags:\n");
+    print_flag("Is greater: ", intr->is_greater);
+    print_flag("Is equal: ", intr->is_equal);
+    print_flag("Is less: ", intr->is_less);
 
-    printf("\n");
+    output_char('\n');
 
-    printf("Variable values:\n");
+    output_string("Variable values:\n");
     for (size_t i = 0; i < NUM_VARIABLES; i++) {
-        printf("x%zu: %" PRId64 "", i, intr->variables[i]);
+        output_char('x');
+        output_decimal((int64_t) i);
+        output_write(": ", 2);
+        output_decimal(intr->variables[i]);
 
         if (i < NUM_VARIABLES - 1) {
-            printf(", ");
+            output_write(", ", 2);
         }
 
         if ((i + 1) % 8 == 0) {
-            printf("\n");
+            output_char('\n');
         }
     }
 
-    printf("\n");
+    output_char('\n');
+}
+
+/**
+ * @brief Prints a line of the final state holding a flag.
+ *
+ * @param name The text before the flag, including the colon and space.
+ * @param value The flag.
+ */
+static void print_flag(const char *name, bool value) {
+    output_string(name);
+    output_char(value ? '1' : '0');
+    output_char('\n');
+}
+
+/**
+ * @brief Records the command about to access guarded memory, so that a fault
+ * on the guard page can name it.
+ *
+ * The fence keeps the compiler from moving the access ahead of the record,
+ * without emitting an instruction.
+ *
+ * @param intr Pointer to the `Interpreter`.
+ * @param cmd The command making the access.
+ */
+__attribute__((always_inline)) static inline void note_guarded(Interpreter   *intr,
+                                                               const Command *cmd) {
+    intr->guarded_command = cmd;
+    atomic_signal_fence(memory_order_seq_cst);
+}
+
+/**
+ * @brief Stops the program with a runtime error.
+ *
+ * @param intr Pointer to the `Interpreter`.
+ * @param cmd The command that failed, or NULL if it is not known.
+ * @param error What went wrong.
+ */
+static void fail(Interpreter *intr, const Command *cmd, const char *error) {
+    intr->had_error     = true;
+    intr->error_command = cmd;
+    intr->error         = error;
 }
 
 /**
@@ -377,53 +805,40 @@ static bool cond_holds(Interpreter *intr, BranchCondition cond) {
  *
  * @param intr The pointer to the interpreter holding variable state.
  * @param cmd The command being processed.
+ * @param profile The profile to record string reads into, or NULL.
  * @return True whether the print was successful, false otherwise.
  */
-static bool print_base(Interpreter *intr, Command *cmd) {
-    const char *base  = cmd->val_a.str_val;
-    int64_t     value = fetch_number_value(intr, &cmd->val_b, cmd->is_b_immediate);
-
-    if (base[0] == 's') {
-        char   buffer[256] = {0};
-        size_t i           = 0;
-        while (i < sizeof(buffer) - 1) {
-            if (!mem_load((uint8_t *) &buffer[i], value + i, 1)) {
-                intr->had_error = true;
-                return false;
-            }
-            if (buffer[i] == '\0') {
-                break;
-            }
-            i++;
+__attribute__((always_inline)) static inline bool print_base(Interpreter *intr,
+                                                             Command     *cmd,
+                                                             MemProfile  *profile) {
+    PrintBase base  = cmd->val_a.print_base;
+    int64_t   value = fetch_number_value(intr, &cmd->val_b, cmd->is_b_immediate);
+
+    if (base == PRINT_STRING) {
+        // Written straight out of memory, however long the string is
+        size_t length;
+        if (!mem_find_nul((size_t) value, &length) ||
+            !mem_write_range((size_t) value, length)) {
+            fail(intr, cmd, "string out of range");
+            return false;
         }
-        printf("%s\n", buffer);
-    } else if (base[0] == 'd') {
-        printf("%" PRId64 "\n", value);
-    } else if (base[0] == 'x') {
-        printf("0x%" PRIx64 "\n", (uint64_t) value);
-    } else if (base[0] == 'b') {
-        char     binary[65] = {0};
-        int      started    = 0;
-        int      index      = 0;
-        uint64_t uvalue     = (uint64_t) value;
-
-        for (int i = 63; i >= 0; i--) {
-            char bit = ((uvalue >> i) & 1) ? '1' : '0';
-
-            if (bit == '1' || started) {
-                started         = 1;
-                binary[index++] = bit;
-            }
+        if (profile) {
+            mem_profile_record(profile, cmd, MEM_ACCESS_PRINT, (size_t) value, length + 1);
         }
-
-        if (!started) {
-            binary[0] = '0';
-            binary[1] = '\0';
-        }
-
-        printf("0b%s\n", binary);
+        output_char('\n');
+    } else if (base == PRINT_DECIMAL) {
+        output_decimal(value);
+        output_char('\n');
+    } else if (base == PRINT_HEX) {
+        output_write("0x", 2);
+        output_hex((uint64_t) value);
+        output_char('\n');
+    } else if (base == PRINT_BINARY) {
+        output_write("0b", 2);
+        output_binary((uint64_t) value);
+        output_char('\n');
     } else {
-        intr->had_error = true;
+        fail(intr, cmd, "invalid print base");
         return false;
     }
 
@@ -1,146 +1,209 @@
 #include "label_map.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void          free_entry(Entry *e);
-static void          free_entries(Entry *e);
-static unsigned long hash_function(char *s);
-static Entry        *entry_init(char *id, Command *command);
+#define MIN_SLOTS 16  // Fewest slots a map has.
+
+#define FNV_OFFSET_BASIS 2166136261u  // Starting value of a 32-bit FNV-1a hash.
+#define FNV_PRIME        16777619u    // Multiplier of a 32-bit FNV-1a hash.
+
+static uint32_t hash_function(const char *s, size_t length);
+static size_t   find_slot(const LabelMap *map, const char *id, size_t length, uint32_t hash);
+static bool     grow_slots(LabelMap *map);
+static bool     grow_entries(LabelMap *map);
 
 bool label_map_init(LabelMap *map, int capacity) {
     if (!map || capacity <= 0) {
         return false;
     }
-    map->capacity = capacity;
-    map->entries  = (Entry **) calloc(capacity, sizeof(Entry *));
-    if (!map->entries) {
+
+    // Twice the slots there are labels, to stay below the load limit
+    size_t slot_count = MIN_SLOTS;
+    while (slot_count < (size_t) capacity * 2) {
+        slot_count *= 2;
+    }
+
+    map->count      = 0;
+    map->capacity   = capacity;
+    map->slot_count = slot_count;
+    map->entries    = malloc((size_t) capacity * sizeof(Entry));
+    map->slots      = malloc(slot_count * sizeof(int32_t));
+    arena_init(&map->names);
+    if (!map->entries || !map->slots) {
+        free(map->entries);
+        free(map->slots);
+        map->entries = NULL;
+        map->slots   = NULL;
         return false;
     }
+    memset(map->slots, 0xff, slot_count * sizeof(int32_t));
     return true;
 }
 
-/**
- * @brief Frees the resources for a `singular` entry.
- *
- * @param e The pointer to the entry to free.
- */
-static void free_entry(Entry *e) {
-    if (!e)
+void label_map_free(LabelMap *map) {
+    if (!map || !map->entries)
         return;
-    free(e->id);
-    free(e);
+    free(map->entries);
+    free(map->slots);
+    arena_free(&map->names);
+    map->entries = NULL;
+    map->slots   = NULL;
+    map->count   = 0;
 }
 
 /**
- * @brief Frees the given list of entries.
+ * @brief Returns a hash of the specified id.
+ *
+ * Uses FNV-1a, which mixes every character into the whole hash, so labels
+ * made of the same characters in a different order hash apart.
  *
- * @param e A pointer to the first entry to free.
+ * @param s The string to hash.
+ * @param length The number of characters in `s`.
+ * @return The hash of `s`
  */
-static void free_entries(Entry *e) {
-    while (e) {
-        Entry *next = e->next;
-        free_entry(e);
-        e = next;
+static uint32_t hash_function(const char *s, size_t length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) s[i];
+        hash *= FNV_PRIME;
     }
+    return hash;
 }
 
-void label_map_free(LabelMap *map) {
-    if (!map || !map->entries)
-        return;
-    for (int i = 0; i < map->capacity; i++) {
-        free_entries(map->entries[i]);
+/**
+ * @brief Finds the slot holding a label, or the empty slot it would go in.
+ *
+ * @param map Pointer to the label map.
+ * @param id The identifier for the label.
+ * @param length The number of characters in `id`.
+ * @param hash The hash of `id`.
+ * @return The index of the slot.
+ */
+static size_t find_slot(const LabelMap *map, const char *id, size_t length, uint32_t hash) {
+    size_t mask = map->slot_count - 1;
+    size_t slot = hash & mask;
+    while (map->slots[slot] >= 0) {
+        const Entry *entry = &map->entries[map->slots[slot]];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->id, id, length) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
     }
-    free(map->entries);
+    return slot;
 }
 
 /**
- * @brief Returns a hash of the specified id.
+ * @brief Doubles the number of slots and places every label again.
  *
- * @param s The string to hash.
- * @return The hash of `s`
+ * @param map Pointer to the label map.
+ * @return True on success, false if memory ran out.
  */
-static unsigned long hash_function(char *s) {
-    unsigned long i = 0;
-    for (int j = 0; s[j]; j++) {
-        i += s[j];
+static bool grow_slots(LabelMap *map) {
+    size_t   slot_count = map->slot_count * 2;
+    int32_t *slots      = malloc(slot_count * sizeof(int32_t));
+    if (!slots) {
+        return false;
     }
-    return i;
+    memset(slots, 0xff, slot_count * sizeof(int32_t));
+
+    // Each label is known to be new, so only an empty slot is looked for
+    size_t mask = slot_count - 1;
+    for (int i = 0; i < map->count; i++) {
+        size_t slot = map->entries[i].hash & mask;
+        while (slots[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = i;
+    }
+
+    free(map->slots);
+    map->slots      = slots;
+    map->slot_count = slot_count;
+    return true;
 }
 
 /**
- * @brief Initializes the given entry's state.
+ * @brief Doubles the number of entries allocated.
  *
- * @param id The id associated with this entry.
- * @param command The command associated with this entry.
- * @return True if the entry was initialized successfully, false otherwise.
+ * @param map Pointer to the label map.
+ * @return True on success, false if memory ran out.
  */
-static Entry *entry_init(char *id, Command *command) {
-    Entry *new_entry = (Entry *) malloc(sizeof(Entry));
-    if (!new_entry) {
-        return NULL;
-    }
-    new_entry->id = malloc(strlen(id) + 1);
-    if (!new_entry->id) {
-        free(new_entry);
-        return NULL;
+static bool grow_entries(LabelMap *map) {
+    if (map->capacity > INT32_MAX / 2) {
+        return false;
     }
-    strcpy(new_entry->id, id);
 
-    if (!new_entry->id) {
-        free(new_entry);
-        return NULL;
+    int    capacity = map->capacity * 2;
+    Entry *entries  = realloc(map->entries, (size_t) capacity * sizeof(Entry));
+    if (!entries) {
+        return false;
     }
-    new_entry->command = command;
-    new_entry->next    = NULL;
-    return new_entry;
+    map->entries  = entries;
+    map->capacity = capacity;
+    return true;
 }
 
-bool put_label(LabelMap *map, char *id, Command *command) {
-    if (!map || !id) {
-        return false;
+int intern_label(LabelMap *map, const char *id, size_t length) {
+    if (!map || !map->entries || !id || length > UINT32_MAX) {
+        return -1;
     }
-    unsigned long index   = hash_function(id) % map->capacity;
-    Entry        *prev    = NULL;
-    Entry        *current = map->entries[index];
 
-    while (current) {
-        if (strcmp(current->id, id) == 0) {
-            current->command = command;
-            return true;
-        }
-        prev    = current;
-        current = current->next;
+    uint32_t hash = hash_function(id, length);
+    size_t   slot = find_slot(map, id, length, hash);
+    if (map->slots[slot] >= 0) {
+        return map->slots[slot];
     }
 
-    Entry *new_entry = entry_init(id, command);
-    if (!new_entry) {
-        return false;
+    // Kept at most half full, so probes stay short
+    if ((size_t) map->count + 1 > map->slot_count / 2) {
+        if (!grow_slots(map)) {
+            return -1;
+        }
+        slot = find_slot(map, id, length, hash);
+    }
+    if (map->count == map->capacity && !grow_entries(map)) {
+        return -1;
     }
 
-    if (prev) {
-        prev->next = new_entry;
-    } else {
-        map->entries[index] = new_entry;
+    char *copy = arena_copy_string(&map->names, id, length);
+    if (!copy) {
+        return -1;
     }
 
-    return true;
+    int    symbol  = map->count++;
+    Entry *entry   = &map->entries[symbol];
+    entry->id      = copy;
+    entry->command = NULL;
+    entry->hash    = hash;
+    entry->length  = (uint32_t) length;
+
+    map->slots[slot] = symbol;
+    return symbol;
 }
 
-Entry *get_label(LabelMap *map, char *id) {
+bool put_label(LabelMap *map, const char *id, Command *command) {
     if (!map || !id) {
-        return NULL;
+        return false;
     }
-    unsigned long index   = hash_function(id) % map->capacity;
-    Entry        *current = map->entries[index];
 
-    while (current) {
-        if (strcmp(current->id, id) == 0) {
-            return current;
-        }
-        current = current->next;
+    int symbol = intern_label(map, id, strlen(id));
+    if (symbol < 0) {
+        return false;
+    }
+    map->entries[symbol].command = command;
+    return true;
+}
+
+Entry *get_label(LabelMap *map, const char *id) {
+    if (!map || !map->entries || !id) {
+        return NULL;
     }
 
-    return NULL;
+    size_t length = strlen(id);
+    size_t slot   = find_slot(map, id, length, hash_function(id, length));
+    return (map->slots[slot] >= 0) ? &map->entries[map->slots[slot]] : NULL;
 }
@@ -1,9 +1,14 @@
 #include "lexer.h"
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "decode.h"
+#include "output.h"
+#include "scan.h"
 #include "token_type.h"
 
 static const char *BAD_BASE_MSG = "Either no or invalid digit in the specified base";
@@ -17,34 +22,67 @@ typedef struct {
     TokenType   type;   /** The token type to return if matched */
 } Keyword;
 
+#define KEYWORD_SLOTS 64  // Size of the keyword hash table, a power of two.
+
 /**
- * @brief Array of reserved keywords.
+ * @brief Hashes an identifier by its first, middle and last characters and
+ * its length.
+ *
+ * The weights make the hash perfect over the keywords: each one gets its own
+ * slot, so a lookup is a single comparison. `keywords` is indexed with this
+ * macro, so a keyword that collides overrides an initializer and fails to
+ * compile.
  */
-static const Keyword keywords[] = {
-    {"add", 3, TOK_ADD},         {"and", 3, TOK_AND},        {"asr", 3, TOK_ASR},
-    {"b", 1, TOK_BRANCH},        {"b.eq", 4, TOK_BRANCH_EQ}, {"b.gt", 4, TOK_BRANCH_GT},
-    {"b.ge", 4, TOK_BRANCH_GE},  {"b.lt", 4, TOK_BRANCH_LT}, {"b.le", 4, TOK_BRANCH_LE},
-    {"b.ne", 4, TOK_BRANCH_NEQ}, {"call", 4, TOK_CALL},      {"cmp", 3, TOK_CMP},
-    {"cmp_u", 5, TOK_CMP_U},     {"eor", 3, TOK_EOR},        {"load", 4, TOK_LOAD},
-    {"lsl", 3, TOK_LSL},         {"lsr", 3, TOK_LSR},        {"mov", 3, TOK_MOV},
-    {"orr", 3, TOK_ORR},         {"print", 5, TOK_PRINT},    {"put", 3, TOK_PUT},
-    {"ret", 3, TOK_RET},         {"store", 5, TOK_STORE},    {"sub", 3, TOK_SUB},
-};
+#define KEYWORD_HASH(first, middle, last, length)                                                  \
+    (((first) + 9 * (middle) + 34 * (last) + (length)) & (KEYWORD_SLOTS - 1))
 
-// Calculate on the fly so you only have to modify the array
-static const int num_keywords = sizeof(keywords) / sizeof(keywords[0]);
+/**
+ * @brief Hash table of reserved keywords. Unused slots have a length of 0.
+ */
+static const Keyword keywords[KEYWORD_SLOTS] = {
+    [KEYWORD_HASH('a', 'd', 'd', 3)] = {"add", 3, TOK_ADD},
+    [KEYWORD_HASH('a', 'n', 'd', 3)] = {"and", 3, TOK_AND},
+    [KEYWORD_HASH('a', 's', 'r', 3)] = {"asr", 3, TOK_ASR},
+    [KEYWORD_HASH('b', 'b', 'b', 1)] = {"b", 1, TOK_BRANCH},
+    [KEYWORD_HASH('b', 'e', 'q', 4)] = {"b.eq", 4, TOK_BRANCH_EQ},
+    [KEYWORD_HASH('b', 'g', 't', 4)] = {"b.gt", 4, TOK_BRANCH_GT},
+    [KEYWORD_HASH('b', 'g', 'e', 4)] = {"b.ge", 4, TOK_BRANCH_GE},
+    [KEYWORD_HASH('b', 'l', 't', 4)] = {"b.lt", 4, TOK_BRANCH_LT},
+    [KEYWORD_HASH('b', 'l', 'e', 4)] = {"b.le", 4, TOK_BRANCH_LE},
+    [KEYWORD_HASH('b', 'n', 'e', 4)] = {"b.ne", 4, TOK_BRANCH_NEQ},
+    [KEYWORD_HASH('c', 'l', 'l', 4)] = {"call", 4, TOK_CALL},
+    [KEYWORD_HASH('c', 'm', 'p', 3)] = {"cmp", 3, TOK_CMP},
+    [KEYWORD_HASH('c', 'p', 'u', 5)] = {"cmp_u", 5, TOK_CMP_U},
+    [KEYWORD_HASH('e', 'o', 'r', 3)] = {"eor", 3, TOK_EOR},
+    [KEYWORD_HASH('e', 'e', 'n', 6)] = {"extern", 6, TOK_EXTERN},
+    [KEYWORD_HASH('i', 'l', 'e', 7)] = {"include", 7, TOK_INCLUDE},
+    [KEYWORD_HASH('l', 'a', 'd', 4)] = {"load", 4, TOK_LOAD},
+    [KEYWORD_HASH('l', 's', 'l', 3)] = {"lsl", 3, TOK_LSL},
+    [KEYWORD_HASH('l', 's', 'r', 3)] = {"lsr", 3, TOK_LSR},
+    [KEYWORD_HASH('m', 'o', 'v', 3)] = {"mov", 3, TOK_MOV},
+    [KEYWORD_HASH('o', 'r', 'r', 3)] = {"orr", 3, TOK_ORR},
+    [KEYWORD_HASH('p', 'i', 't', 5)] = {"print", 5, TOK_PRINT},
+    [KEYWORD_HASH('p', 'u', 't', 3)] = {"put", 3, TOK_PUT},
+    [KEYWORD_HASH('r', 'e', 't', 3)] = {"ret", 3, TOK_RET},
+    [KEYWORD_HASH('s', 'o', 'e', 5)] = {"store", 5, TOK_STORE},
+    [KEYWORD_HASH('s', 'u', 'b', 3)] = {"sub", 3, TOK_SUB},
+};
 
 static char advance(Lexer *lex);
 static bool is_at_end(Lexer *lex);
 static char peek(Lexer *lex);
 static char peek_next(Lexer *lex);
 static void skip_whitespace(Lexer *lex);
+static bool refill(Lexer *lex);
+static void stop_at_nul(Lexer *lex);
+static void release_retired(Lexer *lex, long before);
 
 static Token make_token(Lexer *lex, TokenType tok_type);
 static Token error_token(Lexer *lex, const char *message);
 
 static Token     make_ident(Lexer *lex);
 static TokenType ident_type(Lexer *lex);
+static int64_t   register_index(const char *word, int length);
 static Token     make_number(Lexer *lex, char first_digit);
 static Token     make_binary(Lexer *lex);
 static Token     make_hex(Lexer *lex);
@@ -60,10 +98,122 @@ void lexer_init(Lexer *lex, const char *text) {
         return;
     }
 
+    lexer_init_lines(lex, text, strlen(text));
+}
+
+void lexer_init_lines(Lexer *lex, const char *text, size_t length) {
+    if (!lex) {
+        return;
+    }
+
     lex->start_position   = text;
     lex->current_position = text;
+    lex->end_position     = text + length;
     lex->current_line     = 1;
     lex->current_column   = 1;
+    lex->read             = NULL;
+    lex->read_context     = NULL;
+    lex->exhausted        = true;
+    lex->buffer           = NULL;
+    lex->retired          = NULL;
+    lex->tokens           = 0;
+}
+
+void lexer_init_stream(Lexer *lex, LexerRead read, void *context) {
+    if (!lex) {
+        return;
+    }
+
+    // Start empty; the first token reads the first chunk
+    lexer_init(lex, "");
+    lex->read         = read;
+    lex->read_context = context;
+    lex->exhausted    = false;
+}
+
+void lexer_free(Lexer *lex) {
+    if (!lex) {
+        return;
+    }
+
+    release_retired(lex, LONG_MAX);
+    free(lex->buffer);
+    lex->buffer = NULL;
+}
+
+/**
+ * @brief Reads the next chunk of a streamed source.
+ *
+ * The unfinished token from `start_position` on is carried over to the front
+ * of the new chunk, so it is never split. The old chunk is kept until the
+ * tokens pointing into it can no longer be in use.
+ *
+ * @param lex A pointer to the lexer, the input stream.
+ * @return True if more source was read, false at the end of the source.
+ */
+static bool refill(Lexer *lex) {
+    if (lex->exhausted) {
+        return false;
+    }
+
+    size_t       kept   = (size_t) (lex->end_position - lex->start_position);
+    LexerBuffer *buffer = malloc(sizeof(LexerBuffer) + kept + LEXER_CHUNK_SIZE + 1);
+    if (!buffer) {
+        output_printf("Could not allocate space to read the source\n");
+        lex->exhausted = true;
+        return false;
+    }
+
+    memcpy(buffer->text, lex->start_position, kept);
+    size_t read = lex->read(lex->read_context, buffer->text + kept, LEXER_CHUNK_SIZE);
+
+    // Like a string, the source ends at a NUL
+    const char *nul = memchr(buffer->text + kept, '\0', read);
+    if (nul) {
+        read           = (size_t) (nul - (buffer->text + kept));
+        lex->exhausted = true;
+    }
+    if (read == 0) {
+        lex->exhausted = true;
+        free(buffer);
+        return false;
+    }
+    buffer->text[kept + read] = '\0';
+
+    if (lex->buffer) {
+        lex->buffer->stamp = lex->tokens;
+        lex->buffer->next  = lex->retired;
+        lex->retired       = lex->buffer;
+    }
+
+    lex->buffer           = buffer;
+    lex->current_position = buffer->text + (lex->current_position - lex->start_position);
+    lex->start_position   = buffer->text;
+    lex->end_position     = buffer->text + kept + read;
+    return true;
+}
+
+/**
+ * @brief Frees the replaced chunks retired before the given token count.
+ *
+ * @param lex A pointer to the lexer, the input stream.
+ * @param before Chunks retired when fewer tokens than this had been lexed are
+ * freed.
+ */
+static void release_retired(Lexer *lex, long before) {
+    // Newest first, so everything after the first chunk to free goes too
+    LexerBuffer **link = &lex->retired;
+    while (*link && (*link)->stamp >= before) {
+        link = &(*link)->next;
+    }
+
+    LexerBuffer *buffer = *link;
+    *link               = NULL;
+    while (buffer) {
+        LexerBuffer *next = buffer->next;
+        free(buffer);
+        buffer = next;
+    }
 }
 
 /**
@@ -78,6 +228,21 @@ static char advance(Lexer *lex) {
     return lex->current_position[-1];
 }
 
+/**
+ * @brief Ends the source at a NUL the lexer has reached before its end.
+ *
+ * Every scan stops at a NUL, so one inside the text is found without the text
+ * being searched for it in advance. A streamed chunk holds none before its
+ * end, as `refill` cuts it short at the first.
+ *
+ * @param lex A pointer to the lexer, the input stream.
+ */
+static void stop_at_nul(Lexer *lex) {
+    if (!is_at_end(lex) && *lex->current_position == '\0') {
+        lex->end_position = lex->current_position;
+    }
+}
+
 /**
  * @brief Determines if the lexer is at the end of the given string.
  *
@@ -85,7 +250,7 @@ static char advance(Lexer *lex) {
  * @return True if the lexer is at the end, false otherwise.
  */
 static bool is_at_end(Lexer *lex) {
-    return *lex->current_position == '\0';
+    return lex->current_position >= lex->end_position;
 }
 
 /**
@@ -121,40 +286,45 @@ static Token error_token(Lexer *lex, const char *message) {
  * @brief Skips over the whitespace in the input stream.
  *
  * Whitespace characters are considered to be space (' '), tab ('\t'), comma
- * (,), and carriage return ('\r').
+ * (,), and carriage return ('\r'). A comment after them is skipped up to the
+ * end of its line.
  *
  * @param lex A pointer to the lexer, the input stream.
  */
 static void skip_whitespace(Lexer *lex) {
-    for (;;) {
-        char c = peek(lex);
-        switch (c) {
-            case ' ':
-            case ',':
-            case '\r':
-            case '\t':
-                advance(lex);
-                break;
-            case '/':
-                if (peek_next(lex) == '/') {
-                    // Go to end of line
-                    while (peek(lex) != '\n' && !is_at_end(lex)) {
-                        advance(lex);
-                    }
-                } else {
-                    // Found *only* one slash
-                    return;
-                }
-            default:
-                return;
-        }
+    // Neither run crosses a newline, so the column moves by the bytes skipped.
+    // Nothing skipped needs to be kept when the next chunk is read.
+    do {
+        lex->start_position = lex->current_position;
+
+        const char *end = scan_blanks(lex->current_position, lex->end_position);
+        lex->current_column += (int) (end - lex->current_position);
+        lex->current_position = end;
+        stop_at_nul(lex);
+    } while (is_at_end(lex) && refill(lex));
+
+    if (peek(lex) == '/' && peek_next(lex) == '/') {
+        // Go to end of line
+        do {
+            lex->start_position = lex->current_position;
+
+            const char *end = scan_line(lex->current_position, lex->end_position);
+            lex->current_column += (int) (end - lex->current_position);
+            lex->current_position = end;
+            stop_at_nul(lex);
+        } while (is_at_end(lex) && refill(lex));
     }
 }
 
 Token lexer_next_token(Lexer *lex) {
+    if (lex->retired) {
+        release_retired(lex, lex->tokens - LEXER_RETAIN_TOKENS + 1);
+    }
+    lex->tokens++;
+
     skip_whitespace(lex);
     lex->start_position = lex->current_position;
-    if (is_at_end(lex)) {
+    if (is_at_end(lex) && !refill(lex)) {
         return make_token(lex, TOK_EOF);
     }
 
@@ -187,7 +357,12 @@ Token lexer_next_token(Lexer *lex) {
  * @return The peeked character.
  */
 static char peek(Lexer *lex) {
-    return *lex->current_position;
+    // Only at a NUL can this be the end of a chunk
+    char c = *lex->current_position;
+    if (c == '\0' && is_at_end(lex) && refill(lex)) {
+        c = *lex->current_position;
+    }
+    return c;
 }
 
 /**
@@ -197,6 +372,9 @@ static char peek(Lexer *lex) {
  * @return The peeked character.
  */
 static char peek_next(Lexer *lex) {
+    if (lex->end_position - lex->current_position < 2) {
+        refill(lex);
+    }
     if (is_at_end(lex)) {
         return '\0';
     }
@@ -252,14 +430,19 @@ static bool is_binary(char c) {
  * @return The token corresponding to the matched identifier.
  *
  * @note Recognizes whether the token is a reserved keyword or not.
- * Returns an appropriate type if this is the case.
+ * Returns an appropriate type if this is the case. An identifier naming a
+ * register carries its index as the value.
  */
 static Token make_ident(Lexer *lex) {
     while (is_alpha(peek(lex)) || is_digit(peek(lex))) {
         advance(lex);
     }
 
-    return make_token(lex, ident_type(lex));
+    Token t = make_token(lex, ident_type(lex));
+    if (t.type == TOK_IDENT) {
+        t.value = register_index(t.lexeme, t.length);
+    }
+    return t;
 }
 
 /**
@@ -269,18 +452,49 @@ static Token make_ident(Lexer *lex) {
  * @return The appropriate token if the word is reserved, `TOK_IDENT` otherwise.
  */
 static TokenType ident_type(Lexer *lex) {
-    int token_length = lex->current_position - lex->start_position;
-
-    for (int i = 0; i < num_keywords; i++) {
-        if (token_length == keywords[i].length &&
-            memcmp(lex->start_position, keywords[i].name, token_length) == 0) {
-            return keywords[i].type;
-        }
+    const unsigned char *word         = (const unsigned char *) lex->start_position;
+    int                  token_length = lex->current_position - lex->start_position;
+
+    const Keyword *keyword =
+        &keywords[KEYWORD_HASH(word[0], word[token_length / 2], word[token_length - 1],
+                               token_length)];
+    if (token_length == keyword->length &&
+        memcmp(lex->start_position, keyword->name, token_length) == 0) {
+        return keyword->type;
     }
 
     return TOK_IDENT;
 }
 
+/**
+ * @brief Determines which register an identifier names.
+ *
+ * A register is `x` followed by a decimal number from 0 to 31, which may have
+ * leading zeros.
+ *
+ * @param word The identifier.
+ * @param length The length of the identifier.
+ * @return The index of the register, or -1 if the identifier is not one.
+ */
+static int64_t register_index(const char *word, int length) {
+    if (length < 2 || word[0] != 'x') {
+        return -1;
+    }
+
+    int64_t index = 0;
+    for (int i = 1; i < length; i++) {
+        if (!is_digit(word[i])) {
+            return -1;
+        }
+        // Digits only ever make the index larger, so stop once it is too large
+        index = index * 10 + (word[i] - '0');
+        if (index > 31) {
+            return -1;
+        }
+    }
+    return index;
+}
+
 /**
  * @brief Creates a numeric token from the input stream.
  *
@@ -290,9 +504,11 @@ static TokenType ident_type(Lexer *lex) {
  *
  * @param lex A pointer to the lexer, the input stream.
  * @param first_digit The already read in digit.
- * @return The token representing the parsed number.
+ * @return The token representing the parsed number, with its value.
  *
  * @note Returns an error token if there are no digits after the specified base.
+ * A decimal number with a leading zero is lexed but has no value, as it is not
+ * a valid immediate.
  */
 static Token make_number(Lexer *lex, char first_digit) {
     bool z = first_digit == '0';
@@ -310,7 +526,9 @@ static Token make_number(Lexer *lex, char first_digit) {
         c = peek(lex);
     }
 
-    return make_token(lex, TOK_NUM);
+    Token t = make_token(lex, TOK_NUM);
+    t.value = (z && t.length > 1) ? -1 : decode_decimal(t.lexeme, (size_t) t.length);
+    return t;
 }
 
 /**
@@ -319,7 +537,7 @@ static Token make_number(Lexer *lex, char first_digit) {
  * It is assumed that the number has already been checked for the prefix 0b.
  *
  * @param lex A pointer to the lexer, the input stream.
- * @return The token representing this binary number.
+ * @return The token representing this binary number, with its value.
  *
  * @note Returns an error token if there are no digits.
  */
@@ -336,7 +554,10 @@ static Token make_binary(Lexer *lex) {
         c = peek(lex);
     }
 
-    return make_token(lex, TOK_NUM);
+    // Past the 0b prefix
+    Token t = make_token(lex, TOK_NUM);
+    t.value = decode_binary(t.lexeme + 2, (size_t) t.length - 2);
+    return t;
 }
 
 /**
@@ -345,7 +566,7 @@ static Token make_binary(Lexer *lex) {
  * It is assumed that the number has already been checked for the prefix 0x.
  *
  * @param lex A pointer to the lexer, the input stream.
- * @return The token representing this hexadecimal number.
+ * @return The token representing this hexadecimal number, with its value.
  *
  * @note Returns an error token if there are no digits.
  */
@@ -362,7 +583,10 @@ static Token make_hex(Lexer *lex) {
         c = peek(lex);
     }
 
-    return make_token(lex, TOK_NUM);
+    // Past the 0x prefix
+    Token t = make_token(lex, TOK_NUM);
+    t.value = decode_hex(t.lexeme + 2, (size_t) t.length - 2);
+    return t;
 }
 
 /**
@@ -372,19 +596,36 @@ static Token make_hex(Lexer *lex) {
  * @return A token representing this string, excluding the quotes
  */
 static Token make_string(Lexer *lex) {
-    while (peek(lex) != '"' && !is_at_end(lex)) {
-        if (peek(lex) == '\n') {
-            lex->current_line++;
-            lex->current_column = 1;
+    for (;;) {
+        const char *end = scan_string(lex->current_position, lex->end_position);
+        lex->current_column += (int) (end - lex->current_position);
+        lex->current_position = end;
+        stop_at_nul(lex);
+
+        if (is_at_end(lex)) {
+            if (refill(lex)) {
+                continue;
+            }
+            break;
+        }
+        if (peek(lex) != '\n') {
+            break;
         }
 
+        lex->current_line++;
+        lex->current_column = 1;
         advance(lex);
     }
 
     // We do a hack here to avoid storing the quotes
     lex->start_position++;
     Token t = make_token(lex, TOK_STR);
-    advance(lex);
+    if (is_at_end(lex)) {
+        // Unterminated: count the missing quote's column but never pass the end
+        lex->current_column++;
+    } else {
+        advance(lex);
+    }
     return t;
 }
 
@@ -395,7 +636,7 @@ void print_lexed_tokens(Lexer *lex) {
         print_token(t);
         should_stop = t.type == TOK_ERR || t.type == TOK_EOF;
         if (!should_stop) {
-            printf("\n");
+            output_printf("\n");
         }
     }
 }
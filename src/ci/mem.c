@@ -1,10 +1,98 @@
+#define _DEFAULT_SOURCE
 #include "mem.h"
+#include <setjmp.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-static uint8_t mem[MEM_CAPACITY];
+#include "format.h"
+#include "output.h"
 
-static bool validate_bytes(size_t bytes);
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)  // Alignment transparent huge pages need.
+
+#define PAGE_BITS   MEM_PAGE_BITS
+#define PAGE_SIZE   ((size_t) 1 << PAGE_BITS)
+#define PAGE_MASK   (PAGE_SIZE - 1)
+#define LEVEL_BITS  9                      // Each page table level resolves 9 bits.
+#define LEVEL_SIZE  ((size_t) 1 << LEVEL_BITS)
+#define LEVELS      6                      // Enough levels to cover 64 - PAGE_BITS bits.
+#define TLB_ENTRIES 16                     // Direct-mapped cache of recently used pages.
+
+#define DUMP_LINE_MAX 64  // Room for a printed line of 16 bytes and its address.
+
+/**
+ * @brief A node of the sparse memory page table.
+ *
+ * Interior nodes point to further `PageTable`s, nodes at the last level point
+ * to the pages themselves.
+ */
+typedef struct page_table {
+    void *slots[LEVEL_SIZE];  // Child tables or pages, NULL where unpopulated.
+} PageTable;
+
+/**
+ * @brief Caches the translation of a page number to its data.
+ */
+typedef struct {
+    uint64_t page;  // The cached page number.
+    uint8_t *data;  // The page's data, or NULL if this entry is unused.
+} TlbEntry;
+
+/**
+ * @brief A populated sparse page, collected when walking the page table.
+ */
+typedef struct {
+    uint64_t page;  // The page number.
+    uint8_t *data;  // The page's data.
+} PageRef;
+
+static MemBackend backend = MEM_BACKEND_FLAT;
+
+// Flat and guarded backend state
+static uint8_t  *mem         = NULL;
+static size_t    mem_size    = 0;     // Addressable bytes.
+static uint8_t  *mapped_base = NULL;  // Start of the mapping holding `mem`.
+static size_t    mapped_size = 0;     // Bytes actually mapped.
+static uint64_t *dirty       = NULL;  // One bit per page that may hold non-zero bytes.
+static size_t    dirty_pages = 0;     // Number of pages covered by `dirty`.
+
+// Guarded backend state
+static uint8_t         *guard_start = NULL;  // First byte of the PROT_NONE guard.
+static uint8_t         *guard_end   = NULL;  // One past the last byte of the guard.
+static sigjmp_buf      *fault_env   = NULL;  // Where a guard fault resumes.
+static struct sigaction old_segv;            // Handlers in place before guarding.
+static struct sigaction old_bus;
+
+// Sparse backend state
+static PageTable *page_root = NULL;
+static size_t     page_count = 0;  // Number of populated pages.
+static TlbEntry   tlb[TLB_ENTRIES];
+
+static const uint8_t zero_page[PAGE_SIZE];  // Written out for pages never written to.
+
+static bool     validate_bytes(size_t bytes);
+static int      address_width(size_t last_address);
+static void     print_lines(const uint8_t *data, size_t address, size_t length, int addr_width);
+static size_t   line_prefix(char *line, size_t address, int addr_width);
+static void     free_table(PageTable *table, int level);
+static uint8_t *sparse_page(uint64_t page, bool create);
+static bool     sparse_access(uint8_t *buffer, size_t offset, size_t bytes, bool store);
+static void     collect_pages(PageTable *table, int level, uint64_t prefix, PageRef *pages,
+                              size_t *count);
+static PageRef *sparse_pages(size_t *count);
+static void     sparse_print(void);
+static bool     dirty_init(size_t capacity);
+static void     mark_dirty(size_t offset, size_t bytes);
+static void     mark_dirty_range(size_t offset, size_t bytes);
+static bool     next_dirty(size_t from, size_t *page);
+static bool     prev_dirty(size_t from, size_t *page);
+static bool     first_nonzero(const uint8_t *data, size_t length, size_t *index);
+static bool     last_nonzero(const uint8_t *data, size_t length, size_t *index);
+static bool     guard_init(size_t capacity);
+static void     guard_fault(int sig, siginfo_t *info, void *context);
 
 /**
  * @brief Verifies that the given amount of `bytes` is valid to load.
@@ -18,8 +106,439 @@ static bool validate_bytes(size_t bytes) {
     return bytes == 1 || bytes == 2 || bytes == 4 || bytes == 8;
 }
 
+bool mem_init(MemBackend kind, size_t capacity, bool huge_pages) {
+    mem_free();
+    backend = kind;
+
+    if (backend == MEM_BACKEND_SPARSE) {
+        page_root = calloc(1, sizeof(PageTable));
+        return page_root != NULL;
+    }
+
+    if (capacity == 0) {
+        return false;
+    }
+
+    if (backend == MEM_BACKEND_GUARD) {
+        return guard_init(capacity);
+    }
+
+    size_t length = capacity;
+    if (huge_pages) {
+        length = (capacity + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    }
+
+    // MAP_NORESERVE keeps overcommit accounting from refusing large, mostly
+    // untouched reservations.
+    void *region = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        return false;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+        // Only a hint; the kernel may not have THP enabled.
+        madvise(region, length, MADV_HUGEPAGE);
+    }
+#endif
+
+    mem         = region;
+    mem_size    = capacity;
+    mapped_base = region;
+    mapped_size = length;
+    return dirty_init(capacity);
+}
+
+/**
+ * @brief Allocates the dirty page bitmap for flat or guarded memory.
+ *
+ * @param capacity The number of addressable bytes.
+ * @return True if the bitmap was allocated, false otherwise.
+ */
+static bool dirty_init(size_t capacity) {
+    dirty_pages = (capacity >> PAGE_BITS) + ((capacity & PAGE_MASK) != 0);
+    dirty       = calloc((dirty_pages + 63) / 64, sizeof(uint64_t));
+    return dirty != NULL;
+}
+
+/**
+ * @brief Records that the pages covering the given range may be non-zero.
+ *
+ * Every store is at most a page long, so marking both ends covers it.
+ *
+ * @param offset The first byte written.
+ * @param bytes The number of bytes written, at most `PAGE_SIZE`.
+ */
+static void mark_dirty(size_t offset, size_t bytes) {
+    size_t first = offset >> PAGE_BITS;
+    size_t last  = (offset + bytes - 1) >> PAGE_BITS;
+    dirty[first / 64] |= (uint64_t) 1 << (first % 64);
+    dirty[last / 64] |= (uint64_t) 1 << (last % 64);
+}
+
+/**
+ * @brief Records that every page covering the given range may be non-zero.
+ *
+ * @param offset The first byte written.
+ * @param bytes The number of bytes written.
+ */
+static void mark_dirty_range(size_t offset, size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+
+    for (size_t page = offset >> PAGE_BITS; page <= (offset + bytes - 1) >> PAGE_BITS; page++) {
+        dirty[page / 64] |= (uint64_t) 1 << (page % 64);
+    }
+}
+
+/**
+ * @brief Finds the first dirty page at or after the given page.
+ *
+ * @param from The page to start searching from.
+ * @param page A pointer to store the dirty page in.
+ * @return True if a dirty page was found, false otherwise.
+ */
+static bool next_dirty(size_t from, size_t *page) {
+    if (from >= dirty_pages) {
+        return false;
+    }
+
+    size_t   word = from / 64;
+    uint64_t bits = dirty[word] & (~(uint64_t) 0 << (from % 64));
+    while (!bits) {
+        if (++word >= (dirty_pages + 63) / 64) {
+            return false;
+        }
+        bits = dirty[word];
+    }
+
+    *page = word * 64 + (size_t) __builtin_ctzll(bits);
+    return true;
+}
+
+/**
+ * @brief Finds the last dirty page at or before the given page.
+ *
+ * @param from The page to start searching from.
+ * @param page A pointer to store the dirty page in.
+ * @return True if a dirty page was found, false otherwise.
+ */
+static bool prev_dirty(size_t from, size_t *page) {
+    size_t   word = from / 64;
+    uint64_t bits = dirty[word] & (~(uint64_t) 0 >> (63 - from % 64));
+    while (!bits) {
+        if (word-- == 0) {
+            return false;
+        }
+        bits = dirty[word];
+    }
+
+    *page = word * 64 + 63 - (size_t) __builtin_clzll(bits);
+    return true;
+}
+
+/**
+ * @brief Finds the first non-zero byte, skipping zero bytes a word at a time.
+ *
+ * @param data The bytes to search.
+ * @param length The number of bytes to search.
+ * @param index A pointer to store the index of the non-zero byte in.
+ * @return True if a non-zero byte was found, false otherwise.
+ */
+static bool first_nonzero(const uint8_t *data, size_t length, size_t *index) {
+    size_t i = 0;
+    for (uint64_t word; i + sizeof(word) <= length; i += sizeof(word)) {
+        memcpy(&word, data + i, sizeof(word));
+        if (word) {
+            break;
+        }
+    }
+
+    for (; i < length; i++) {
+        if (data[i]) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Finds the last non-zero byte, skipping zero bytes a word at a time.
+ *
+ * @param data The bytes to search.
+ * @param length The number of bytes to search.
+ * @param index A pointer to store the index of the non-zero byte in.
+ * @return True if a non-zero byte was found, false otherwise.
+ */
+static bool last_nonzero(const uint8_t *data, size_t length, size_t *index) {
+    size_t i = length;
+    for (uint64_t word; i >= sizeof(word); i -= sizeof(word)) {
+        memcpy(&word, data + i - sizeof(word), sizeof(word));
+        if (word) {
+            break;
+        }
+    }
+
+    while (i > 0) {
+        if (data[--i]) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reserves guarded memory.
+ *
+ * The usable bytes are placed so that they end exactly where an inaccessible
+ * guard page begins. Any access that starts at or runs past `capacity` then
+ * faults instead of needing an explicit bounds check.
+ *
+ * @param capacity The number of addressable bytes.
+ * @return True if the memory was reserved, false otherwise.
+ */
+static bool guard_init(size_t capacity) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    if (capacity > SIZE_MAX - 2 * page) {
+        return false;
+    }
+
+    size_t usable = (capacity + page - 1) & ~(page - 1);
+    size_t length = usable + page;
+    void  *region =
+        mmap(NULL, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        return false;
+    }
+    if (mprotect(region, usable, PROT_READ | PROT_WRITE) != 0) {
+        munmap(region, length);
+        return false;
+    }
+
+    mapped_base = region;
+    mapped_size = length;
+    mem         = mapped_base + (usable - capacity);
+    mem_size    = capacity;
+    guard_start = mapped_base + usable;
+    guard_end   = mapped_base + length;
+    return dirty_init(capacity);
+}
+
+/**
+ * @brief Turns a fault on the guard page into a memory error.
+ *
+ * Faults anywhere else are genuine crashes; the previous disposition is
+ * restored so that returning re-raises them.
+ */
+static void guard_fault(int sig, siginfo_t *info, void *context) {
+    uint8_t *address = info->si_addr;
+    if (fault_env && address >= guard_start && address < guard_end) {
+        siglongjmp(*fault_env, 1);
+    }
+
+    sigaction(sig, (sig == SIGSEGV) ? &old_segv : &old_bus, NULL);
+}
+
+bool mem_guard_region(MemGuardRegion *region) {
+    if (backend != MEM_BACKEND_GUARD) {
+        return false;
+    }
+
+    *region = (MemGuardRegion) {mem, mem_size, dirty};
+    return true;
+}
+
+bool mem_run_guarded(void (*body)(void *), void *context) {
+    if (backend != MEM_BACKEND_GUARD) {
+        body(context);
+        return true;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = guard_fault;
+    action.sa_flags     = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &old_segv);
+    sigaction(SIGBUS, &action, &old_bus);
+
+    sigjmp_buf    env;
+    volatile bool ok = true;
+    if (sigsetjmp(env, 1) == 0) {
+        fault_env = &env;
+        body(context);
+    } else {
+        ok = false;
+    }
+
+    fault_env = NULL;
+    sigaction(SIGSEGV, &old_segv, NULL);
+    sigaction(SIGBUS, &old_bus, NULL);
+    return ok;
+}
+
+/**
+ * @brief Frees a page table node and everything below it.
+ *
+ * @param table The node to free.
+ * @param level The depth of `table`, 0 being the root.
+ */
+static void free_table(PageTable *table, int level) {
+    if (!table) {
+        return;
+    }
+
+    for (size_t i = 0; i < LEVEL_SIZE; i++) {
+        if (level == LEVELS - 1) {
+            free(table->slots[i]);
+        } else {
+            free_table(table->slots[i], level + 1);
+        }
+    }
+    free(table);
+}
+
+void mem_free(void) {
+    if (mapped_base) {
+        munmap(mapped_base, mapped_size);
+    }
+    mem         = NULL;
+    mem_size    = 0;
+    mapped_base = NULL;
+    mapped_size = 0;
+    guard_start = NULL;
+    guard_end   = NULL;
+
+    free(dirty);
+    dirty       = NULL;
+    dirty_pages = 0;
+
+    free_table(page_root, 0);
+    page_root  = NULL;
+    page_count = 0;
+    memset(tlb, 0, sizeof(tlb));
+}
+
+size_t mem_capacity(void) {
+    return (backend == MEM_BACKEND_SPARSE) ? SIZE_MAX : mem_size;
+}
+
+/**
+ * @brief Translates a sparse page number to the page's data.
+ *
+ * @param page The page number, I.e, the address shifted right by `PAGE_BITS`.
+ * @param create Whether to allocate the page (and its tables) if unpopulated.
+ * @return The page's data, or NULL if it is unpopulated and `create` is false
+ * or allocation failed.
+ */
+static uint8_t *sparse_page(uint64_t page, bool create) {
+    TlbEntry *entry = &tlb[page % TLB_ENTRIES];
+    if (entry->data && entry->page == page) {
+        return entry->data;
+    }
+
+    PageTable *table = page_root;
+    for (int level = 0; level < LEVELS - 1; level++) {
+        size_t     index = (page >> (LEVEL_BITS * (LEVELS - 1 - level))) & (LEVEL_SIZE - 1);
+        PageTable *child = table->slots[index];
+        if (!child) {
+            if (!create || !(child = calloc(1, sizeof(PageTable)))) {
+                return NULL;
+            }
+            table->slots[index] = child;
+        }
+        table = child;
+    }
+
+    size_t   index = page & (LEVEL_SIZE - 1);
+    uint8_t *data  = table->slots[index];
+    if (!data) {
+        if (!create || !(data = calloc(1, PAGE_SIZE))) {
+            return NULL;
+        }
+        table->slots[index] = data;
+        page_count++;
+    }
+
+    entry->page = page;
+    entry->data = data;
+    return data;
+}
+
+/**
+ * @brief Loads or stores a value in sparse memory.
+ *
+ * Loads from unpopulated pages read as zero without populating them.
+ *
+ * @param buffer The buffer to load into or store from.
+ * @param offset The address of the first byte.
+ * @param bytes The amount of bytes to transfer.
+ * @param store True to store `buffer` to memory, false to load it.
+ * @return True if the access succeeded, false otherwise.
+ */
+static bool sparse_access(uint8_t *buffer, size_t offset, size_t bytes, bool store) {
+    // The access may not wrap around the top of the address space.
+    if (bytes - 1 > SIZE_MAX - offset) {
+        return false;
+    }
+
+    while (bytes > 0) {
+        size_t   in_page = offset & PAGE_MASK;
+        size_t   chunk   = (bytes < PAGE_SIZE - in_page) ? bytes : PAGE_SIZE - in_page;
+        uint8_t *data    = sparse_page(offset >> PAGE_BITS, store);
+
+        if (store) {
+            if (!data) {
+                return false;
+            }
+            memcpy(data + in_page, buffer, chunk);
+        } else if (data) {
+            memcpy(buffer, data + in_page, chunk);
+        } else {
+            memset(buffer, 0, chunk);
+        }
+
+        buffer += chunk;
+        offset += chunk;
+        bytes -= chunk;
+    }
+
+    return true;
+}
+
 bool mem_load(uint8_t *destination, size_t offset, size_t bytes) {
-    if (!validate_bytes(bytes) || !destination || offset + bytes > MEM_CAPACITY) {
+    if (backend == MEM_BACKEND_GUARD) {
+        // Out of range offsets are clamped onto the guard page, which costs a
+        // conditional move rather than a branch, and fault there.
+        const uint8_t *source = &mem[(offset < mem_size) ? offset : mem_size];
+        switch (bytes) {
+            case 1:
+                memcpy(destination, source, 1);
+                return true;
+            case 2:
+                memcpy(destination, source, 2);
+                return true;
+            case 4:
+                memcpy(destination, source, 4);
+                return true;
+            case 8:
+                memcpy(destination, source, 8);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if (backend == MEM_BACKEND_SPARSE) {
+        return validate_bytes(bytes) && destination &&
+               sparse_access(destination, offset, bytes, false);
+    }
+
+    if (!validate_bytes(bytes) || !destination || offset > mem_size || bytes > mem_size - offset) {
         return false;
     }
 
@@ -28,54 +547,464 @@ bool mem_load(uint8_t *destination, size_t offset, size_t bytes) {
 }
 
 bool mem_store(uint8_t *source, size_t offset, size_t bytes) {
-    if (!validate_bytes(bytes) || !source || offset + bytes > MEM_CAPACITY) {
+    if (backend == MEM_BACKEND_GUARD) {
+        // Each width is a single store instruction, so a store straddling the
+        // guard faults before writing anything.
+        size_t   index       = (offset < mem_size) ? offset : mem_size;
+        uint8_t *destination = &mem[index];
+        switch (bytes) {
+            case 1:
+                memcpy(destination, source, 1);
+                break;
+            case 2:
+                memcpy(destination, source, 2);
+                break;
+            case 4:
+                memcpy(destination, source, 4);
+                break;
+            case 8:
+                memcpy(destination, source, 8);
+                break;
+            default:
+                return false;
+        }
+        mark_dirty(index, bytes);
+        return true;
+    }
+
+    if (backend == MEM_BACKEND_SPARSE) {
+        return validate_bytes(bytes) && source && sparse_access(source, offset, bytes, true);
+    }
+
+    if (!validate_bytes(bytes) || !source || offset > mem_size || bytes > mem_size - offset) {
         return false;
     }
 
     memcpy(&mem[offset], source, bytes);
+    mark_dirty(offset, bytes);
+    return true;
+}
+
+bool mem_store_range(const uint8_t *source, size_t offset, size_t bytes) {
+    if (!source) {
+        return false;
+    }
+    if (bytes == 0) {
+        return true;
+    }
+
+    if (backend == MEM_BACKEND_SPARSE) {
+        // Stores may not wrap around the top of the address space.
+        size_t fit = (bytes - 1 > SIZE_MAX - offset) ? SIZE_MAX - offset + 1 : bytes;
+        return sparse_access((uint8_t *) source, offset, fit, true) && fit == bytes;
+    }
+
+    // Nothing fits past the end, where `&mem[offset]` would not even be valid
+    if (offset >= mem_size) {
+        return false;
+    }
+    size_t fit = (bytes < mem_size - offset) ? bytes : mem_size - offset;
+    memcpy(&mem[offset], source, fit);
+    mark_dirty_range(offset, fit);
+    return fit == bytes;
+}
+
+bool mem_find_nul(size_t offset, size_t *length) {
+    if (!length) {
+        return false;
+    }
+
+    if (backend == MEM_BACKEND_SPARSE) {
+        // Unpopulated pages read as zero, so the string ends at the first one.
+        size_t address = offset;
+        for (;;) {
+            size_t         in_page = address & PAGE_MASK;
+            const uint8_t *data    = sparse_page(address >> PAGE_BITS, false);
+            if (!data) {
+                *length = address - offset;
+                return true;
+            }
+
+            const uint8_t *nul = memchr(data + in_page, 0, PAGE_SIZE - in_page);
+            if (nul) {
+                *length = address - offset + (size_t) (nul - (data + in_page));
+                return true;
+            }
+
+            address += PAGE_SIZE - in_page;
+            if (address == 0) {
+                return false;
+            }
+        }
+    }
+
+    if (offset >= mem_size) {
+        return false;
+    }
+
+    const uint8_t *nul = memchr(&mem[offset], 0, mem_size - offset);
+    if (!nul) {
+        return false;
+    }
+    *length = (size_t) (nul - &mem[offset]);
+    return true;
+}
+
+bool mem_write_range(size_t offset, size_t bytes) {
+    if (backend == MEM_BACKEND_SPARSE) {
+        if (bytes > 0 && bytes - 1 > SIZE_MAX - offset) {
+            return false;
+        }
+
+        while (bytes > 0) {
+            size_t         in_page = offset & PAGE_MASK;
+            size_t         chunk   = (bytes < PAGE_SIZE - in_page) ? bytes : PAGE_SIZE - in_page;
+            const uint8_t *data    = sparse_page(offset >> PAGE_BITS, false);
+            output_write(data ? data + in_page : zero_page, chunk);
+            offset += chunk;
+            bytes -= chunk;
+        }
+        return true;
+    }
+
+    if (offset > mem_size || bytes > mem_size - offset) {
+        return false;
+    }
+    output_write(&mem[offset], bytes);
     return true;
 }
 
+uint8_t *mem_resolve(size_t offset, size_t bytes, bool for_store) {
+    if (backend == MEM_BACKEND_SPARSE || offset > mem_size || bytes > mem_size - offset) {
+        return NULL;
+    }
+
+    if (for_store) {
+        mark_dirty_range(offset, bytes);
+    }
+    return &mem[offset];
+}
+
+/**
+ * @brief Returns the number of hex digits needed to print every address.
+ *
+ * @param last_address The highest address that may be printed.
+ * @return The number of digits.
+ */
+static int address_width(size_t last_address) {
+    int width = 1;
+    while (last_address >>= 4) {
+        width++;
+    }
+    return width;
+}
+
+/**
+ * @brief Prints memory as lines of 16 bytes.
+ *
+ * Each line is put together whole from tables of hex digits and written out
+ * at once. Runs of zero lines are found a word at a time, and only their
+ * addresses are formatted; their bytes are the same on every line.
+ *
+ * @param data The bytes to print.
+ * @param address The address of `data[0]`, a multiple of 16.
+ * @param length The number of bytes to print.
+ * @param addr_width The number of hex digits to print addresses with.
+ */
+static void print_lines(const uint8_t *data, size_t address, size_t length, int addr_width) {
+    static const char zero_bytes[] = "00000000 00000000 00000000 00000000 \n";
+
+    char   line[DUMP_LINE_MAX];
+    size_t j = 0;
+    while (j < length) {
+        size_t nonzero;
+        if (!first_nonzero(data + j, length - j, &nonzero)) {
+            nonzero = length - j;
+        }
+        for (size_t zero_end = j + nonzero / 16 * 16; j < zero_end; j += 16) {
+            size_t at = line_prefix(line, address + j, addr_width);
+            memcpy(line + at, zero_bytes, sizeof(zero_bytes) - 1);
+            output_write(line, at + sizeof(zero_bytes) - 1);
+        }
+        if (j == length) {
+            break;
+        }
+
+        // The line with the non-zero byte, or the short line at the end
+        size_t at    = line_prefix(line, address + j, addr_width);
+        size_t count = (length - j < 16) ? length - j : 16;
+        for (size_t k = 0; k < count; k += 4) {
+            size_t group = (count - k < 4) ? count - k : 4;
+            format_hex_bytes(line + at, data + j + k, group);
+            at += group * 2;
+            if (group == 4) {
+                line[at++] = ' ';
+            }
+        }
+        line[at++] = '\n';
+        output_write(line, at);
+        j += count;
+    }
+}
+
+/**
+ * @brief Writes the address at the start of a line of memory.
+ *
+ * @param line Where to write, with room for a whole line.
+ * @param address The address of the line's first byte.
+ * @param addr_width The number of hex digits to print addresses with.
+ * @return The number of characters written.
+ */
+static size_t line_prefix(char *line, size_t address, int addr_width) {
+    memcpy(line, "    0x", 6);
+    size_t at  = 6 + format_hex_padded(line + 6, address, addr_width);
+    line[at++] = ':';
+    line[at++] = ' ';
+    return at;
+}
+
+/**
+ * @brief Appends the populated pages below a page table node, in address order.
+ *
+ * @param table The node to walk.
+ * @param level The depth of `table`, 0 being the root.
+ * @param prefix The page number bits selected by the path to `table`.
+ * @param pages The array to append to.
+ * @param count A pointer to the number of pages already in `pages`.
+ */
+static void collect_pages(PageTable *table, int level, uint64_t prefix, PageRef *pages,
+                          size_t *count) {
+    for (size_t i = 0; i < LEVEL_SIZE; i++) {
+        if (!table->slots[i]) {
+            continue;
+        }
+
+        uint64_t page = (prefix << LEVEL_BITS) | i;
+        if (level == LEVELS - 1) {
+            pages[*count].page = page;
+            pages[*count].data = table->slots[i];
+            (*count)++;
+        } else {
+            collect_pages(table->slots[i], level + 1, page, pages, count);
+        }
+    }
+}
+
+/**
+ * @brief Lists every populated sparse page in address order.
+ *
+ * @param count A pointer to store the number of pages in.
+ * @return A newly allocated array of pages, or NULL if none are populated or
+ * allocation failed.
+ */
+static PageRef *sparse_pages(size_t *count) {
+    *count = 0;
+    if (page_count == 0) {
+        return NULL;
+    }
+
+    PageRef *pages = malloc(page_count * sizeof(PageRef));
+    if (pages) {
+        collect_pages(page_root, 0, 0, pages, count);
+    }
+    return pages;
+}
+
+/**
+ * @brief Prints the populated regions of sparse memory.
+ *
+ * Each run of consecutive populated pages is printed like flat memory, trimmed
+ * to the lines holding its first and last non-zero bytes.
+ */
+static void sparse_print(void) {
+    size_t   count;
+    PageRef *pages   = sparse_pages(&count);
+    bool     printed = false;
+
+    for (size_t run_start = 0; run_start < count;) {
+        size_t run_end = run_start + 1;
+        while (run_end < count && pages[run_end].page == pages[run_end - 1].page + 1) {
+            run_end++;
+        }
+
+        // Locate the first and last non-zero bytes of the run
+        size_t first = 0;
+        size_t last  = 0;
+        bool   found = false;
+        for (size_t p = run_start; !found && p < run_end; p++) {
+            found = first_nonzero(pages[p].data, PAGE_SIZE, &first);
+            first |= (size_t) pages[p].page << PAGE_BITS;
+        }
+        for (size_t p = run_end; found && p-- > run_start;) {
+            if (last_nonzero(pages[p].data, PAGE_SIZE, &last)) {
+                last |= (size_t) pages[p].page << PAGE_BITS;
+                break;
+            }
+        }
+
+        if (found) {
+            size_t display_start = first & ~(size_t) 0xF;
+            size_t display_last  = last | 0xF;
+            output_printf("0x%0*zx-0x%0*zx:\n", 16, display_start, 16, display_last);
+
+            for (size_t p = run_start; p < run_end; p++) {
+                size_t base = (size_t) pages[p].page << PAGE_BITS;
+                size_t from = (display_start > base) ? display_start : base;
+                size_t to   = (display_last < base + PAGE_MASK) ? display_last : base + PAGE_MASK;
+                if (from <= to) {
+                    print_lines(pages[p].data + (from - base), from, to - from + 1, 16);
+                }
+            }
+            printed = true;
+        }
+
+        run_start = run_end;
+    }
+
+    if (!printed) {
+        output_printf("Unmodified\n");
+    }
+    free(pages);
+}
+
 void mem_print(void) {
-    printf("Memory state:\n");
+    output_printf("Memory state:\n");
 
-    // Calculate minimum hex digits needed based on capacity
-    int    addr_width = 1;
-    size_t temp       = MEM_CAPACITY - 1;
-    while (temp >>= 4) {
-        addr_width++;
+    if (backend == MEM_BACKEND_SPARSE) {
+        sparse_print();
+        return;
     }
 
+    // Calculate minimum hex digits needed based on capacity
+    int addr_width = address_width(mem_size - 1);
+
+    // Clean pages were never written, so only dirty pages need scanning.
     size_t first_modified = 0;
-    while (first_modified < MEM_CAPACITY && mem[first_modified] == 0) {
-        first_modified++;
+    bool   found          = false;
+    for (size_t page = 0; !found && next_dirty(page, &page); page++) {
+        size_t start  = page << PAGE_BITS;
+        size_t length = (mem_size - start < PAGE_SIZE) ? mem_size - start : PAGE_SIZE;
+        if (first_nonzero(&mem[start], length, &first_modified)) {
+            first_modified += start;
+            found = true;
+        }
     }
 
-    if (first_modified == MEM_CAPACITY) {
-        printf("Unmodified\n");
+    if (!found) {
+        output_printf("Unmodified\n");
         return;
     }
 
-    size_t last_modified = MEM_CAPACITY - 1;
-    while (last_modified > first_modified && mem[last_modified] == 0) {
-        last_modified--;
+    size_t last_modified = first_modified;
+    found                = false;
+    for (size_t page = dirty_pages; !found && page > 0 && prev_dirty(page - 1, &page);) {
+        size_t start  = page << PAGE_BITS;
+        size_t length = (mem_size - start < PAGE_SIZE) ? mem_size - start : PAGE_SIZE;
+        if (last_nonzero(&mem[start], length, &last_modified)) {
+            last_modified += start;
+            found = true;
+        }
     }
 
     size_t display_start = first_modified & ~0xF;
     size_t display_end   = (last_modified + 16) & ~0xF;
-    if (display_end > MEM_CAPACITY)
-        display_end = MEM_CAPACITY;
+    if (display_end > mem_size)
+        display_end = mem_size;
+
+    output_printf("0x%0*zx-0x%0*zx:\n", addr_width, display_start, addr_width, display_end - 1);
+    print_lines(&mem[display_start], display_start, display_end - display_start, addr_width);
+}
+
+bool mem_load_image(const char *path, size_t offset) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        output_printf("Failed to open memory image %s\n", path);
+        return false;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    long filesize = ftell(file);
+    rewind(file);
 
-    printf("0x%0*zx-0x%0*zx:\n", addr_width, display_start, addr_width, display_end - 1);
+    bool fits = filesize >= 0;
+    if (fits && backend == MEM_BACKEND_SPARSE) {
+        fits = filesize == 0 || (size_t) filesize - 1 <= SIZE_MAX - offset;
+    } else if (fits) {
+        fits = offset <= mem_size && (size_t) filesize <= mem_size - offset;
+    }
+    if (!fits) {
+        output_printf("Memory image %s does not fit in memory\n", path);
+        fclose(file);
+        return false;
+    }
 
-    for (size_t j = display_start; j < display_end; j += 16) {
-        printf("    0x%0*zx: ", addr_width, j);
-        for (size_t k = 0; k < 16 && j + k < display_end; k++) {
-            printf("%02x", mem[j + k]);
-            if ((k + 1) % 4 == 0) {
-                printf(" ");
+    size_t bytes_read = 0;
+    if (backend == MEM_BACKEND_SPARSE) {
+        // Read straight into each page in turn
+        while (bytes_read < (size_t) filesize) {
+            size_t   address = offset + bytes_read;
+            size_t   in_page = address & PAGE_MASK;
+            size_t   chunk   = PAGE_SIZE - in_page;
+            uint8_t *data    = sparse_page(address >> PAGE_BITS, true);
+            if (chunk > (size_t) filesize - bytes_read) {
+                chunk = (size_t) filesize - bytes_read;
             }
+            if (!data || fread(data + in_page, 1, chunk, file) != chunk) {
+                break;
+            }
+            bytes_read += chunk;
+        }
+    } else {
+        bytes_read = fread(&mem[offset], 1, (size_t) filesize, file);
+        mark_dirty_range(offset, bytes_read);
+    }
+    fclose(file);
+
+    if (bytes_read < (size_t) filesize) {
+        output_printf("Could not read memory image %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool mem_save_image(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        output_printf("Failed to open memory image %s\n", path);
+        return false;
+    }
+
+    bool ok;
+    if (backend == MEM_BACKEND_SPARSE) {
+        // Only populated pages are written; the gaps between them become holes.
+        size_t   count;
+        PageRef *pages = sparse_pages(&count);
+        ok             = count == 0 || pages != NULL;
+        for (size_t i = 0; ok && i < count; i++) {
+            size_t address = (size_t) pages[i].page << PAGE_BITS;
+            ok             = address <= (size_t) INT64_MAX - PAGE_SIZE &&
+                 fseeko(file, (off_t) address, SEEK_SET) == 0 &&
+                 fwrite(pages[i].data, 1, PAGE_SIZE, file) == PAGE_SIZE;
         }
-        printf("\n");
+        free(pages);
+    } else {
+        // Clean pages are zero; extending the file leaves them as holes
+        // instead of writing the zeroes out.
+        ok = true;
+        for (size_t page = 0; ok && next_dirty(page, &page); page++) {
+            size_t start  = page << PAGE_BITS;
+            size_t length = (mem_size - start < PAGE_SIZE) ? mem_size - start : PAGE_SIZE;
+            ok            = fseeko(file, (off_t) start, SEEK_SET) == 0 &&
+                 fwrite(&mem[start], 1, length, file) == length;
+        }
+        ok = ok && fflush(file) == 0 && ftruncate(fileno(file), (off_t) mem_size) == 0;
+    }
+
+    if (fclose(file) != 0 || !ok) {
+        output_printf("Could not write memory image %s\n", path);
+        return false;
     }
-}
\ No newline at end of file
+
+    return true;
+}
@@ -0,0 +1,300 @@
+#include "mem_profile.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void        touch_line(MemProfile *profile, uint64_t line, bool is_write);
+static void        record_site(MemProfile *profile, const Command *cmd, MemAccess kind,
+                               size_t offset);
+static void        end_window(MemProfile *profile);
+static int         compare_lines(const void *a, const void *b);
+static int         compare_sites(const void *a, const void *b);
+static const char *access_name(MemAccess kind);
+
+void mem_profile_init(MemProfile *profile) {
+    memset(profile, 0, sizeof(*profile));
+    counter_table_init(&profile->lines, sizeof(MemLineCount));
+    counter_table_init(&profile->sites, sizeof(MemSiteCount));
+    profile->window = 1;
+}
+
+void mem_profile_free(MemProfile *profile) {
+    counter_table_free(&profile->lines);
+    counter_table_free(&profile->sites);
+    free(profile->working_set);
+    mem_profile_init(profile);
+}
+
+void mem_profile_record(MemProfile *profile, const Command *cmd, MemAccess kind, size_t offset,
+                        size_t bytes) {
+    if (kind == MEM_ACCESS_LOAD || kind == MEM_ACCESS_STORE) {
+        uint64_t *sizes = (kind == MEM_ACCESS_LOAD) ? profile->loads : profile->stores;
+        switch (bytes) {
+            case 1:
+                sizes[0]++;
+                break;
+            case 2:
+                sizes[1]++;
+                break;
+            case 4:
+                sizes[2]++;
+                break;
+            case 8:
+                sizes[3]++;
+                break;
+            default:
+                sizes[4]++;
+                break;
+        }
+    } else {
+        profile->bulk[kind - MEM_ACCESS_PUT]++;
+        profile->bulk_bytes[kind - MEM_ACCESS_PUT] += bytes;
+    }
+
+    // Every line the access overlaps counts once
+    if (bytes > 0) {
+        bool     is_write = (kind == MEM_ACCESS_STORE || kind == MEM_ACCESS_PUT);
+        uint64_t first    = offset >> MEM_PROFILE_LINE_BITS;
+        uint64_t last     = (offset + (bytes - 1)) >> MEM_PROFILE_LINE_BITS;
+        for (uint64_t line = first; line <= last; line++) {
+            touch_line(profile, line, is_write);
+        }
+    }
+
+    record_site(profile, cmd, kind, offset);
+
+    profile->accesses++;
+    if (profile->accesses % MEM_PROFILE_WINDOW == 0) {
+        end_window(profile);
+    }
+}
+
+void mem_profile_report(MemProfile *profile, Command *commands, const SourceMap *locations,
+                        FILE *out) {
+    static const char *const size_names[] = {"1 byte", "2 bytes", "4 bytes", "8 bytes", "other"};
+
+    fprintf(out, "Memory profile:\n");
+    fprintf(out, "Accesses: %" PRIu64 "\n", profile->accesses);
+    if (profile->incomplete) {
+        fprintf(out, "Ran out of memory while profiling; the report is incomplete\n");
+    }
+
+    fprintf(out, "\nSize mix:\n");
+    for (size_t i = 0; i < 5; i++) {
+        fprintf(out, "    %-7s loads: %" PRIu64 ", stores: %" PRIu64 "\n", size_names[i],
+                profile->loads[i], profile->stores[i]);
+    }
+    fprintf(out, "    puts: %" PRIu64 " (%" PRIu64 " bytes), string prints: %" PRIu64
+                 " (%" PRIu64 " bytes)\n",
+            profile->bulk[0], profile->bulk_bytes[0], profile->bulk[1], profile->bulk_bytes[1]);
+
+    MemLineCount *lines      = counter_table_copy(&profile->lines);
+    MemSiteCount *sites      = counter_table_copy(&profile->sites);
+    size_t        line_count = profile->lines.count;
+    size_t        site_count = profile->sites.count;
+    if (!lines || !sites) {
+        fprintf(out, "Not enough memory to rank the profile\n");
+        free(lines);
+        free(sites);
+        return;
+    }
+
+    qsort(lines, line_count, sizeof(MemLineCount), compare_lines);
+
+    fprintf(out, "\nHottest %d byte lines (%zu touched):\n", 1 << MEM_PROFILE_LINE_BITS,
+            line_count);
+    for (size_t i = 0; i < line_count && i < MEM_PROFILE_TOP; i++) {
+        fprintf(out, "    0x%" PRIx64 ": reads: %" PRIu64 ", writes: %" PRIu64 "\n",
+                lines[i].line << MEM_PROFILE_LINE_BITS, lines[i].reads, lines[i].writes);
+    }
+
+    qsort(sites, site_count, sizeof(MemSiteCount), compare_sites);
+
+    fprintf(out, "\nBusiest instructions:\n");
+    for (size_t i = 0; i < site_count && i < MEM_PROFILE_TOP; i++) {
+        // Instructions are numbered by their position in the program
+        long index = 0;
+        for (Command *cmd = commands; cmd && cmd != sites[i].command; cmd = cmd->next) {
+            index++;
+        }
+
+        fprintf(out, "    #%ld", index);
+        const SourceLocation *location = source_map_at(locations, (size_t) index);
+        if (location) {
+            fprintf(out, " line %" PRIu32, location->line);
+        }
+        fprintf(out, " %s: %" PRIu64 " accesses", access_name(sites[i].kind), sites[i].count);
+        if (sites[i].count > 1) {
+            fprintf(out, ", stride %" PRId64 " (%" PRIu64 "%%)", sites[i].stride,
+                    sites[i].matches * 100 / (sites[i].count - 1));
+        }
+        fprintf(out, "\n");
+    }
+
+    free(lines);
+    free(sites);
+
+    // Count the unfinished window too, so short programs still get a sample
+    size_t   windows = profile->window_count + (profile->accesses % MEM_PROFILE_WINDOW != 0);
+    uint64_t low     = UINT64_MAX;
+    uint64_t high    = 0;
+    uint64_t total   = 0;
+    for (size_t i = 0; i < windows; i++) {
+        uint64_t size = (i < profile->window_count) ? profile->working_set[i]
+                                                    : profile->window_lines;
+        low   = (size < low) ? size : low;
+        high  = (size > high) ? size : high;
+        total += size;
+    }
+
+    fprintf(out, "\nWorking set (lines per %d accesses):\n", MEM_PROFILE_WINDOW);
+    if (windows == 0) {
+        fprintf(out, "    no accesses\n");
+        return;
+    }
+    fprintf(out, "    min: %" PRIu64 ", mean: %" PRIu64 ", max: %" PRIu64 "\n", low,
+            total / windows, high);
+
+    // At most a line of samples, spread evenly over the run
+    size_t step = (windows + 15) / 16;
+    fprintf(out, "    over time:");
+    for (size_t i = 0; i < windows; i += step) {
+        uint64_t size = (i < profile->window_count) ? profile->working_set[i]
+                                                    : profile->window_lines;
+        fprintf(out, " %" PRIu64, size);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * @brief Counts an access to one line.
+ *
+ * @param profile The profile to record into.
+ * @param line The line number.
+ * @param is_write Whether the access wrote to the line.
+ */
+static void touch_line(MemProfile *profile, uint64_t line, bool is_write) {
+    // A key of zero marks an empty slot, so line 0 is kept as 1
+    MemLineCount *entry = counter_table_add(&profile->lines, line + 1);
+    if (!entry) {
+        profile->incomplete = true;
+        return;
+    }
+    entry->line = line;
+
+    if (is_write) {
+        entry->writes++;
+    } else {
+        entry->reads++;
+    }
+
+    if (entry->window != profile->window) {
+        entry->window = profile->window;
+        profile->window_lines++;
+    }
+}
+
+/**
+ * @brief Counts an access made by an instruction and tracks its stride.
+ *
+ * @param profile The profile to record into.
+ * @param cmd The instruction.
+ * @param kind What the access does.
+ * @param offset The address of the first byte accessed.
+ */
+static void record_site(MemProfile *profile, const Command *cmd, MemAccess kind,
+                        size_t offset) {
+    MemSiteCount *site = counter_table_add(&profile->sites, (uint64_t) (uintptr_t) cmd);
+    if (!site) {
+        profile->incomplete = true;
+        return;
+    }
+    if (!site->command) {
+        site->command = cmd;
+        site->kind    = kind;
+        site->last    = offset;
+        site->count   = 1;
+        return;
+    }
+
+    // A majority vote finds the dominant stride without storing every one
+    int64_t stride = (int64_t) (offset - site->last);
+    if (site->votes == 0) {
+        site->stride = stride;
+        site->votes  = 1;
+    } else if (stride == site->stride) {
+        site->votes++;
+    } else {
+        site->votes--;
+    }
+
+    if (stride == site->stride) {
+        site->matches++;
+    }
+    site->last = offset;
+    site->count++;
+}
+
+/**
+ * @brief Stores the working set size of the current window and starts a new one.
+ *
+ * @param profile The profile to record into.
+ */
+static void end_window(MemProfile *profile) {
+    if (profile->window_count == profile->window_capacity) {
+        size_t    capacity = profile->window_capacity ? profile->window_capacity * 2 : 64;
+        uint64_t *grown    = realloc(profile->working_set, capacity * sizeof(uint64_t));
+        if (!grown) {
+            profile->incomplete   = true;
+            profile->window_lines = 0;
+            profile->window++;
+            return;
+        }
+        profile->working_set     = grown;
+        profile->window_capacity = capacity;
+    }
+
+    profile->working_set[profile->window_count++] = profile->window_lines;
+    profile->window_lines                         = 0;
+    profile->window++;
+}
+
+/**
+ * @brief Orders lines from most to least accessed.
+ */
+static int compare_lines(const void *a, const void *b) {
+    const MemLineCount *left  = a;
+    const MemLineCount *right = b;
+    uint64_t            l     = left->reads + left->writes;
+    uint64_t            r     = right->reads + right->writes;
+    if (l != r) {
+        return (l < r) ? 1 : -1;
+    }
+    return (left->line > right->line) - (left->line < right->line);
+}
+
+/**
+ * @brief Orders instructions from most to least accesses.
+ */
+static int compare_sites(const void *a, const void *b) {
+    const MemSiteCount *left  = a;
+    const MemSiteCount *right = b;
+    return (left->count < right->count) - (left->count > right->count);
+}
+
+/**
+ * @brief Returns the name of an access kind for the report.
+ */
+static const char *access_name(MemAccess kind) {
+    switch (kind) {
+        case MEM_ACCESS_LOAD:
+            return "load";
+        case MEM_ACCESS_STORE:
+            return "store";
+        case MEM_ACCESS_PUT:
+            return "put";
+        case MEM_ACCESS_PRINT:
+            return "print";
+    }
+    return "access";
+}
@@ -0,0 +1,618 @@
+#include "object.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter.h"
+#include "output.h"
+
+#define OBJECT_MAGIC   "CIOB"  // Identifies a ci object file.
+#define OBJECT_VERSION 1       // Bumped whenever the layout below changes.
+#define HEADER_SIZE    12      // Bytes of the magic, version and command count.
+#define COMMAND_SIZE   32      // Fewest bytes a command takes, with empty string operands.
+#define LABEL_SIZE     12      // Fewest bytes a label takes, with an empty name.
+
+// Bits of the per-command flags word.
+#define FLAG_A_IMMEDIATE 0x1
+#define FLAG_B_IMMEDIATE 0x2
+#define FLAG_A_STRING    0x4
+#define FLAG_B_STRING    0x8
+
+/**
+ * @brief A label in a loaded object's label table.
+ */
+typedef struct {
+    char    *id;       // The label's name.
+    Command *command;  // The command the object defines it on, or NULL if it only refers to it.
+} ObjectLabel;
+
+/**
+ * @brief An object loaded but not yet linked.
+ *
+ * Which labels an object exports is only known once every object, and the
+ * `extern` declarations they bring, has been loaded.
+ */
+typedef struct {
+    const char  *path;         // The object's path, which qualifies its local labels.
+    Command     *commands;     // The head of the object's command list, or NULL if empty.
+    ObjectLabel *labels;       // The object's label table.
+    uint32_t     label_count;  // The number of labels in `labels`.
+} LoadedObject;
+
+/**
+ * @brief Maps a command back to its position within its module.
+ */
+typedef struct {
+    const Command *command;  // The command.
+    int32_t        index;    // Its position in the module's command list.
+} CommandIndex;
+
+static bool write_u32(FILE *file, uint32_t value);
+static bool write_i64(FILE *file, int64_t value);
+static bool write_str(FILE *file, const char *str);
+static bool write_operand(FILE *file, Operand op, bool is_str);
+static bool write_strings(FILE *file, const StringList *list);
+static bool read_u32(FILE *file, uint32_t *value);
+static bool read_i64(FILE *file, int64_t *value);
+static bool read_str(FILE *file, Arena *arena, char **str);
+static bool read_operand(FILE *file, Arena *arena, Operand *op, bool is_str);
+static bool read_strings(FILE *file, Arena *arena, StringList *list);
+static int  compare_command_index(const void *a, const void *b);
+static bool is_register(Operand op);
+static bool command_in_range(const Command *cmd);
+static bool push_module(ModuleList *mods, Command *commands);
+static bool load_object(ModuleList *mods, const char *path, StringList *includes,
+                        LoadedObject *object);
+static bool local_name(char **buffer, size_t *capacity, const char *id, const char *path);
+static bool is_exported(const ModuleList *mods, const StringList *externs, const char *id);
+static bool link_object(ModuleList *mods, LabelMap *map, const StringList *externs,
+                        const LoadedObject *object);
+
+static bool write_u32(FILE *file, uint32_t value) {
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool write_i64(FILE *file, int64_t value) {
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool write_str(FILE *file, const char *str) {
+    size_t length = strlen(str);
+    return write_u32(file, (uint32_t) length) && fwrite(str, 1, length, file) == length;
+}
+
+static bool write_operand(FILE *file, Operand op, bool is_str) {
+    return is_str ? write_str(file, op.str_val) : write_i64(file, op.num_val);
+}
+
+static bool write_strings(FILE *file, const StringList *list) {
+    if (!write_u32(file, (uint32_t) list->count)) {
+        return false;
+    }
+    for (int i = 0; i < list->count; i++) {
+        if (!write_str(file, list->items[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool read_u32(FILE *file, uint32_t *value) {
+    return fread(value, sizeof(*value), 1, file) == 1;
+}
+
+static bool read_i64(FILE *file, int64_t *value) {
+    return fread(value, sizeof(*value), 1, file) == 1;
+}
+
+/**
+ * @brief Reads a length-prefixed string into an arena.
+ *
+ * @param file The object file to read from.
+ * @param arena Pointer to the `Arena` to allocate the string from.
+ * @param str A pointer to store the NUL-terminated string in on success.
+ * @return True if the string was read, false otherwise.
+ */
+static bool read_str(FILE *file, Arena *arena, char **str) {
+    uint32_t length;
+    if (!read_u32(file, &length)) {
+        return false;
+    }
+
+    char *buffer = arena_alloc(arena, (size_t) length + 1);
+    if (!buffer || fread(buffer, 1, length, file) != length) {
+        return false;
+    }
+    buffer[length] = '\0';
+
+    *str = buffer;
+    return true;
+}
+
+static bool read_operand(FILE *file, Arena *arena, Operand *op, bool is_str) {
+    return is_str ? read_str(file, arena, &op->str_val) : read_i64(file, &op->num_val);
+}
+
+static bool read_strings(FILE *file, Arena *arena, StringList *list) {
+    uint32_t count;
+    if (!read_u32(file, &count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        char *str;
+        if (!read_str(file, arena, &str) || !string_list_push(list, str, (int) strlen(str))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int compare_command_index(const void *a, const void *b) {
+    uintptr_t lhs = (uintptr_t) ((const CommandIndex *) a)->command;
+    uintptr_t rhs = (uintptr_t) ((const CommandIndex *) b)->command;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static bool is_register(Operand op) {
+    return op.num_val >= 0 && op.num_val < NUM_VARIABLES;
+}
+
+/**
+ * @brief Checks that a command read from an object is one the parser could
+ * have produced, so the interpreter can trust its operands.
+ *
+ * Only the generic commands are ever written; the fixed-width forms are
+ * substituted after linking and would carry raw pointers.
+ *
+ * @param cmd The command, with its print base already resolved.
+ * @return True if the command is valid, false otherwise.
+ */
+static bool command_in_range(const Command *cmd) {
+    if ((unsigned) cmd->type > CMD_SUB || cmd->type == CMD_ERR) {
+        return false;
+    }
+
+    // Branches are the only commands with a condition
+    bool is_branch = cmd->type == CMD_BRANCH;
+    if (is_branch ? (cmd->branch_condition < BRANCH_ALWAYS ||
+                     cmd->branch_condition > BRANCH_LESS_EQUAL)
+                  : cmd->branch_condition != BRANCH_NONE) {
+        return false;
+    }
+
+    // A `put` keeps its string, whose length was measured when it was parsed,
+    // and a branch or call the name of its label until it is linked
+    bool a_is_label = is_branch || cmd->type == CMD_CALL;
+    if (cmd->is_b_string || cmd->is_a_string != (cmd->type == CMD_PUT || a_is_label)) {
+        return false;
+    }
+    if (cmd->type == CMD_PUT) {
+        return cmd->destination.num_val == (int64_t) strlen(cmd->val_a.str_val) &&
+               (cmd->is_b_immediate || is_register(cmd->val_b));
+    }
+
+    // Operands a command does not use are zero, which passes as a register
+    bool dest_is_size = cmd->type == CMD_STORE;
+    return (dest_is_size || is_register(cmd->destination)) &&
+           (a_is_label || cmd->type == CMD_PRINT || cmd->is_a_immediate ||
+            is_register(cmd->val_a)) &&
+           (cmd->is_b_immediate || is_register(cmd->val_b));
+}
+
+bool object_write(const char *path, Command *commands, LabelMap *map, const StringList *externs,
+                  const StringList *includes) {
+    if (!path || !map || !externs || !includes) {
+        return false;
+    }
+
+    uint32_t command_count = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        command_count++;
+    }
+
+    // Labels refer to commands by position, so build a sorted pointer lookup.
+    CommandIndex *lookup = malloc((command_count ? command_count : 1) * sizeof(CommandIndex));
+    if (!lookup) {
+        output_printf("Could not allocate space for %s\n", path);
+        return false;
+    }
+    int32_t index = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next, index++) {
+        lookup[index].command = cmd;
+        lookup[index].index   = index;
+    }
+    qsort(lookup, command_count, sizeof(CommandIndex), compare_command_index);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        output_printf("Failed to open object file %s\n", path);
+        free(lookup);
+        return false;
+    }
+
+    bool ok = fwrite(OBJECT_MAGIC, 1, 4, file) == 4 && write_u32(file, OBJECT_VERSION) &&
+              write_u32(file, command_count);
+
+    for (Command *cmd = commands; ok && cmd; cmd = cmd->next) {
+        // A print base is stored as the letter it was written as, and a label
+        // by its name
+        char    letter[2]   = {0};
+        Operand val_a       = cmd->val_a;
+        bool    is_a_string = cmd->is_a_string;
+        if (cmd->type == CMD_PRINT) {
+            letter[0]     = print_base_letter(cmd->val_a.print_base);
+            val_a.str_val = letter;
+            is_a_string   = true;
+        } else if (cmd->type == CMD_BRANCH || cmd->type == CMD_CALL) {
+            val_a.str_val = map->entries[cmd->val_a.num_val].id;
+            is_a_string   = true;
+        }
+
+        uint32_t flags = (cmd->is_a_immediate ? FLAG_A_IMMEDIATE : 0) |
+                         (cmd->is_b_immediate ? FLAG_B_IMMEDIATE : 0) |
+                         (is_a_string ? FLAG_A_STRING : 0) | (cmd->is_b_string ? FLAG_B_STRING : 0);
+        ok = write_u32(file, cmd->type) && write_u32(file, flags) &&
+             write_i64(file, cmd->branch_condition) &&
+             write_i64(file, cmd->destination.num_val) && write_operand(file, val_a, is_a_string) &&
+             write_operand(file, cmd->val_b, cmd->is_b_string);
+    }
+
+    // Labels are written in symbol order, the order they were first seen in
+    ok = ok && write_u32(file, (uint32_t) map->count);
+    for (int i = 0; ok && i < map->count; i++) {
+        const Entry *e      = &map->entries[i];
+        int32_t      target = -1;
+        if (e->command) {
+            CommandIndex  key   = {e->command, 0};
+            CommandIndex *found = bsearch(&key, lookup, command_count, sizeof(CommandIndex),
+                                          compare_command_index);
+            target              = found ? found->index : -1;
+        }
+        ok = write_str(file, e->id) && write_i64(file, target);
+    }
+
+    ok = ok && write_strings(file, externs) && write_strings(file, includes);
+    free(lookup);
+
+    if (fclose(file) != 0 || !ok) {
+        output_printf("Could not write object file %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+void module_list_init(ModuleList *mods) {
+    if (!mods) {
+        return;
+    }
+
+    mods->modules  = NULL;
+    mods->count    = 0;
+    mods->capacity = 0;
+    string_list_init(&mods->paths);
+    string_list_init(&mods->externs);
+    arena_init(&mods->arena);
+}
+
+void module_list_free(ModuleList *mods) {
+    if (!mods) {
+        return;
+    }
+
+    free(mods->modules);
+    string_list_free(&mods->paths);
+    string_list_free(&mods->externs);
+    arena_free(&mods->arena);
+    module_list_init(mods);
+}
+
+/**
+ * @brief Records the head of a loaded module's command list.
+ *
+ * @param mods Pointer to the `ModuleList` to append to.
+ * @param commands The head of the module's command list.
+ * @return True if the module was appended, false otherwise.
+ */
+static bool push_module(ModuleList *mods, Command *commands) {
+    if (mods->count == mods->capacity) {
+        int       new_capacity = mods->capacity ? mods->capacity * 2 : 4;
+        Command **new_modules  = realloc(mods->modules, new_capacity * sizeof(Command *));
+        if (!new_modules) {
+            return false;
+        }
+        mods->modules  = new_modules;
+        mods->capacity = new_capacity;
+    }
+
+    mods->modules[mods->count++] = commands;
+    return true;
+}
+
+/**
+ * @brief Loads a single object file, leaving its labels to be linked.
+ *
+ * @param mods Pointer to the `ModuleList` receiving the module.
+ * @param path The path of the object file to load.
+ * @param includes A list receiving the objects this object includes.
+ * @param object Receives the object's commands and label table.
+ * @return True if the object was loaded, false otherwise.
+ */
+static bool load_object(ModuleList *mods, const char *path, StringList *includes,
+                        LoadedObject *object) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        output_printf("Failed to open object file %s\n", path);
+        return false;
+    }
+
+    // The size bounds how many commands the object can hold
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+
+    char     magic[4];
+    uint32_t version;
+    uint32_t command_count;
+    if (size < HEADER_SIZE || fread(magic, 1, 4, file) != 4 ||
+        memcmp(magic, OBJECT_MAGIC, 4) != 0 || !read_u32(file, &version) ||
+        version != OBJECT_VERSION || !read_u32(file, &command_count)) {
+        output_printf("%s is not a ci object file\n", path);
+        fclose(file);
+        return false;
+    }
+    if (command_count > (uint64_t) (size - HEADER_SIZE) / COMMAND_SIZE) {
+        output_printf("Could not read object file %s\n", path);
+        fclose(file);
+        return false;
+    }
+
+    // The commands live in the module list's arena; this only indexes them
+    Command **commands = calloc(command_count ? command_count : 1, sizeof(Command *));
+    bool      ok       = commands != NULL;
+    for (uint32_t i = 0; ok && i < command_count; i++) {
+        Command *cmd = arena_alloc(&mods->arena, sizeof(Command));
+        if (!cmd) {
+            ok = false;
+            break;
+        }
+        commands[i] = cmd;
+        if (i > 0) {
+            commands[i - 1]->next = cmd;
+        }
+
+        uint32_t type;
+        uint32_t flags;
+        int64_t  branch_condition;
+        ok = read_u32(file, &type) && read_u32(file, &flags) && read_i64(file, &branch_condition) &&
+             read_i64(file, &cmd->destination.num_val);
+        if (!ok) {
+            break;
+        }
+        cmd->type             = (CommandType) type;
+        cmd->branch_condition = (BranchCondition) branch_condition;
+        cmd->is_a_immediate   = flags & FLAG_A_IMMEDIATE;
+        cmd->is_b_immediate   = flags & FLAG_B_IMMEDIATE;
+        cmd->is_a_string      = flags & FLAG_A_STRING;
+        cmd->is_b_string      = flags & FLAG_B_STRING;
+        ok = read_operand(file, &mods->arena, &cmd->val_a, cmd->is_a_string) &&
+             read_operand(file, &mods->arena, &cmd->val_b, cmd->is_b_string);
+
+        // A print base is stored as the letter it was written as
+        if (ok && cmd->type == CMD_PRINT) {
+            ok = cmd->is_a_string && cmd->val_a.str_val[0] != '\0' &&
+                 cmd->val_a.str_val[1] == '\0' &&
+                 print_base_from_letter(cmd->val_a.str_val[0], &cmd->val_a.print_base);
+            cmd->is_a_string = false;
+        }
+        ok = ok && command_in_range(cmd);
+    }
+
+    uint32_t label_count = 0;
+    ok                   = ok && read_u32(file, &label_count);
+    if (ok && label_count > (uint64_t) size / LABEL_SIZE) {
+        ok = false;
+    }
+    ObjectLabel *labels = NULL;
+    if (ok && label_count > 0) {
+        labels = arena_alloc(&mods->arena, label_count * sizeof(ObjectLabel));
+        ok     = labels != NULL;
+    }
+    for (uint32_t i = 0; ok && i < label_count; i++) {
+        int64_t target;
+        if (!read_str(file, &mods->arena, &labels[i].id) || !read_i64(file, &target) ||
+            target < -1 || target >= (int64_t) command_count) {
+            ok = false;
+            break;
+        }
+        labels[i].command = (target >= 0) ? commands[target] : NULL;
+    }
+
+    ok = ok && read_strings(file, &mods->arena, &mods->externs) &&
+         read_strings(file, &mods->arena, includes);
+    fclose(file);
+
+    if (ok) {
+        *object = (LoadedObject) {path, command_count ? commands[0] : NULL, labels, label_count};
+    } else {
+        output_printf("Could not read object file %s\n", path);
+    }
+    free(commands);
+    return ok;
+}
+
+/**
+ * @brief Builds the name a label local to an object is linked under.
+ *
+ * The name joins the label and the object's path with an `@`, which no label
+ * in a source can contain, so it never clashes with another module's labels.
+ *
+ * @param buffer Pointer to a heap buffer to build the name in, grown as needed.
+ * @param capacity Pointer to the size of `buffer`.
+ * @param id The label.
+ * @param path The path of the object defining it.
+ * @return True on success, false if memory ran out.
+ */
+static bool local_name(char **buffer, size_t *capacity, const char *id, const char *path) {
+    size_t id_length   = strlen(id);
+    size_t path_length = strlen(path);
+    size_t length      = id_length + 1 + path_length;
+    if (length + 1 > *capacity) {
+        char *grown = realloc(*buffer, length + 1);
+        if (!grown) {
+            return false;
+        }
+        *buffer   = grown;
+        *capacity = length + 1;
+    }
+
+    memcpy(*buffer, id, id_length);
+    (*buffer)[id_length] = '@';
+    memcpy(*buffer + id_length + 1, path, path_length + 1);
+    return true;
+}
+
+/**
+ * @brief Tells whether a label is exported, which it is when the program or
+ * any linked object declares it `extern`.
+ */
+static bool is_exported(const ModuleList *mods, const StringList *externs, const char *id) {
+    return string_list_contains(externs, id) || string_list_contains(&mods->externs, id);
+}
+
+/**
+ * @brief Links a loaded object's labels into the program's label map.
+ *
+ * Exported labels join the program's labels under their own names. The rest
+ * are local: they are linked under a name qualified by the object's path, so
+ * the object's branches and calls reach its own definitions and no other
+ * module can see them.
+ *
+ * @param mods Pointer to the `ModuleList` holding the object.
+ * @param map Pointer to the program's label map.
+ * @param externs The labels the program declares `extern`.
+ * @param object The object to link.
+ * @return True if the object was linked, false otherwise.
+ */
+static bool link_object(ModuleList *mods, LabelMap *map, const StringList *externs,
+                        const LoadedObject *object) {
+    char  *name     = NULL;
+    size_t capacity = 0;
+    bool   ok       = true;
+    for (uint32_t i = 0; ok && i < object->label_count; i++) {
+        const ObjectLabel *label = &object->labels[i];
+        if (!label->command) {
+            continue;
+        }
+
+        if (!is_exported(mods, externs, label->id)) {
+            ok = local_name(&name, &capacity, label->id, object->path) &&
+                 put_label(map, name, label->command);
+            continue;
+        }
+        Entry *existing = get_label(map, label->id);
+        if (existing && existing->command) {
+            output_printf("Duplicate symbol: %s\n", label->id);
+            free(name);
+            return false;
+        }
+        ok = put_label(map, label->id, label->command);
+    }
+
+    // A target the object defines locally is found under its qualified name,
+    // and any other under its own
+    for (Command *cmd = object->commands; ok && cmd; cmd = cmd->next) {
+        if (cmd->type != CMD_BRANCH && cmd->type != CMD_CALL) {
+            continue;
+        }
+
+        const char *id = cmd->val_a.str_val;
+        ok             = local_name(&name, &capacity, id, object->path);
+        if (!ok) {
+            break;
+        }
+        Entry *local       = get_label(map, name);
+        cmd->val_a.num_val = local ? (int) (local - map->entries)
+                                   : intern_label(map, id, strlen(id));
+        cmd->is_a_string   = false;
+        ok                 = cmd->val_a.num_val >= 0;
+    }
+
+    free(name);
+    if (!ok) {
+        output_printf("Could not link object file %s\n", object->path);
+    }
+    return ok;
+}
+
+bool link_objects(ModuleList *mods, LabelMap *map, const StringList *includes,
+                  const StringList *externs) {
+    if (!mods || !map || !includes || !externs) {
+        return false;
+    }
+
+    StringList pending;
+    string_list_init(&pending);
+    for (int i = 0; i < includes->count; i++) {
+        if (!string_list_push(&pending, includes->items[i], (int) strlen(includes->items[i]))) {
+            string_list_free(&pending);
+            return false;
+        }
+    }
+
+    // `pending` grows as objects pull in their own includes, and every object
+    // is loaded before any is linked so all their externs are known
+    LoadedObject *objects  = NULL;
+    int           count    = 0;
+    int           capacity = 0;
+    bool          ok       = true;
+    for (int i = 0; ok && i < pending.count; i++) {
+        const char *path = pending.items[i];
+        if (string_list_contains(&mods->paths, path)) {
+            continue;
+        }
+        if (count == capacity) {
+            int           new_capacity = capacity ? capacity * 2 : 4;
+            LoadedObject *grown        = realloc(objects, new_capacity * sizeof(LoadedObject));
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            objects  = grown;
+            capacity = new_capacity;
+        }
+        ok = string_list_push(&mods->paths, path, (int) strlen(path)) &&
+             load_object(mods, mods->paths.items[mods->paths.count - 1], &pending,
+                         &objects[count]);
+        if (ok) {
+            count++;
+        }
+    }
+
+    for (int i = 0; ok && i < count; i++) {
+        ok = link_object(mods, map, externs, &objects[i]) &&
+             (!objects[i].commands || push_module(mods, objects[i].commands));
+    }
+
+    free(objects);
+    string_list_free(&pending);
+    return ok;
+}
+
+bool check_externs(LabelMap *map, const StringList *externs) {
+    if (!map || !externs) {
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < externs->count; i++) {
+        Entry *entry = get_label(map, externs->items[i]);
+        if (!entry || !entry->command) {
+            output_printf("Unresolved symbol: %s\n", externs->items[i]);
+            ok = false;
+        }
+    }
+    return ok;
+}
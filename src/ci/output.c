@@ -0,0 +1,238 @@
+#include "output.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "format.h"
+
+static OutputSink sink     = OUTPUT_SINK_STDOUT;  // Where the output goes.
+static int        sink_fd  = STDOUT_FILENO;       // The descriptor written to, or -1 for none.
+static char      *buffer   = NULL;                // The output not yet handed to the sink, or
+                                                  // NULL to write it straight through.
+static size_t     used     = 0;                   // The number of bytes in `buffer`.
+static size_t     capacity = 0;                   // The number of bytes `buffer` holds.
+static bool       failed   = false;               // Whether any output was lost.
+
+static bool  write_all(const char *data, size_t length);
+static bool  make_room(size_t length);
+static char *reserve(size_t length);
+
+bool output_init(OutputSink kind, int fd) {
+    buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (!buffer) {
+        return false;
+    }
+
+    sink     = kind;
+    sink_fd  = (kind == OUTPUT_SINK_STDOUT) ? STDOUT_FILENO : (kind == OUTPUT_SINK_FD) ? fd : -1;
+    used     = 0;
+    capacity = OUTPUT_BUFFER_SIZE;
+    failed   = false;
+    return true;
+}
+
+bool output_free(void) {
+    bool ok = output_flush();
+    if (sink == OUTPUT_SINK_FD && sink_fd >= 0 && close(sink_fd) != 0) {
+        ok = false;
+    }
+
+    free(buffer);
+    sink     = OUTPUT_SINK_STDOUT;
+    sink_fd  = STDOUT_FILENO;
+    buffer   = NULL;
+    used     = 0;
+    capacity = 0;
+    failed   = false;
+    return ok;
+}
+
+bool output_flush(void) {
+    if (sink != OUTPUT_SINK_MEMORY && used > 0) {
+        if (!write_all(buffer, used)) {
+            failed = true;
+        }
+        used = 0;
+    }
+    return !failed;
+}
+
+void output_write(const void *data, size_t length) {
+    if (length > capacity - used && !make_room(length)) {
+        // Too large to be worth buffering, so it goes out as it is
+        if (sink == OUTPUT_SINK_MEMORY || !output_flush() || !write_all(data, length)) {
+            failed = true;
+        }
+        return;
+    }
+    memcpy(buffer + used, data, length);
+    used += length;
+}
+
+void output_char(char c) {
+    if (used == capacity && !make_room(1)) {
+        output_write(&c, 1);
+        return;
+    }
+    buffer[used++] = c;
+}
+
+void output_string(const char *text) {
+    output_write(text, strlen(text));
+}
+
+void output_printf(const char *format, ...) {
+    size_t  room = capacity - used;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(room ? buffer + used : NULL, room, format, args);
+    va_end(args);
+    if (length < 0) {
+        failed = true;
+        return;
+    }
+    if ((size_t) length < room) {
+        used += (size_t) length;
+        return;
+    }
+
+    // Did not fit, so format it again once there is room
+    if (!make_room((size_t) length + 1)) {
+        char *text = malloc((size_t) length + 1);
+        if (text) {
+            va_start(args, format);
+            vsnprintf(text, (size_t) length + 1, format, args);
+            va_end(args);
+            output_write(text, (size_t) length);
+        } else {
+            failed = true;
+        }
+        free(text);
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(buffer + used, capacity - used, format, args);
+    va_end(args);
+    used += (size_t) length;
+}
+
+void output_decimal(int64_t value) {
+    char *out = reserve(FORMAT_DECIMAL_MAX);
+    if (out) {
+        used += format_decimal(out, value);
+        return;
+    }
+    char digits[FORMAT_DECIMAL_MAX];
+    output_write(digits, format_decimal(digits, value));
+}
+
+void output_hex(uint64_t value) {
+    char *out = reserve(FORMAT_HEX_MAX);
+    if (out) {
+        used += format_hex(out, value);
+        return;
+    }
+    char digits[FORMAT_HEX_MAX];
+    output_write(digits, format_hex(digits, value));
+}
+
+void output_binary(uint64_t value) {
+    char *out = reserve(FORMAT_BINARY_MAX);
+    if (out) {
+        used += format_binary(out, value);
+        return;
+    }
+    char digits[FORMAT_BINARY_MAX];
+    output_write(digits, format_binary(digits, value));
+}
+
+const char *output_contents(size_t *length) {
+    if (sink != OUTPUT_SINK_MEMORY || !buffer) {
+        return NULL;
+    }
+
+    if (length) {
+        *length = used;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Writes bytes to the sink's descriptor, however many calls it takes.
+ *
+ * @param data The bytes to write.
+ * @param length The number of bytes.
+ * @return True if every byte was written, false if the descriptor failed.
+ */
+static bool write_all(const char *data, size_t length) {
+    if (sink_fd < 0) {
+        return false;
+    }
+
+    while (length > 0) {
+        ssize_t written = write(sink_fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    return true;
+}
+
+/**
+ * @brief Makes room in the buffer for the specified number of bytes.
+ *
+ * A descriptor's buffer is flushed, and a memory buffer grown.
+ *
+ * @param length The number of bytes to make room for.
+ * @return True if `length` bytes now fit, false if they never will in a
+ * descriptor's buffer or memory ran out.
+ */
+static bool make_room(size_t length) {
+    if (!buffer) {
+        return false;
+    }
+
+    if (sink != OUTPUT_SINK_MEMORY) {
+        output_flush();
+        return length <= capacity;
+    }
+
+    size_t grown = capacity;
+    while (length > grown - used) {
+        if (grown > SIZE_MAX / 2) {
+            return false;
+        }
+        grown *= 2;
+    }
+    char *larger = realloc(buffer, grown);
+    if (!larger) {
+        return false;
+    }
+    buffer   = larger;
+    capacity = grown;
+    return true;
+}
+
+/**
+ * @brief Finds room at the end of the buffer to format into.
+ *
+ * @param length The most bytes that will be written.
+ * @return Where to write, or NULL if there is no buffer to write into; the
+ * caller adds what it wrote to `used`.
+ */
+static char *reserve(size_t length) {
+    if (length > capacity - used && !make_room(length)) {
+        return NULL;
+    }
+    return buffer + used;
+}
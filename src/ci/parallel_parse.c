@@ -0,0 +1,415 @@
+#define _DEFAULT_SOURCE
+#include "parallel_parse.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "token_buffer.h"
+#include "token_type.h"
+
+/**
+ * @brief A run of whole lines of the source and what parsing it produced.
+ */
+typedef struct {
+    const char *text;       // The first line of the chunk.
+    size_t      length;     // The number of characters in the chunk.
+    bool        last;       // Whether the chunk runs to the end of the source, or stops at a NUL.
+    TokenBuffer tokens;     // The chunk's tokens.
+    Parser      parser;     // The parser of the chunk, holding its externs and includes.
+    LabelMap    labels;     // The labels the chunk mentions, by the chunk's own symbol IDs.
+    int        *symbols;    // The program's symbol ID for each of the chunk's, once merged.
+    LabelLog    log;        // The label definitions the chunk makes, in order.
+    SourceMap   locations;  // Where the chunk's commands start, by the chunk's own lines.
+    Arena       arena;      // Holds the chunk's commands and strings.
+    size_t      trailing;   // Labels at the end of `log` with no command after them.
+    Command    *head;       // The first command of the chunk, or NULL.
+    Command    *tail;       // The last command of the chunk, or NULL.
+    bool        ok;         // Set once the chunk has parsed without error.
+} Chunk;
+
+static int   chunk_count(size_t length, int threads);
+static int   split(const char *source, size_t length, Chunk *chunks, int count);
+static void *parse_chunk(void *arg);
+static bool  ends_at_line(const Chunk *chunk);
+static bool  defined_once(const Chunk *chunks, int count);
+static void  merge(Parser *parser, LabelMap *map, Arena *arena, SourceMap *locations,
+                   Chunk *chunks, int count, Command **commands);
+static bool  translate_symbols(LabelMap *map, Chunk *chunk);
+static void  apply_records(LabelMap *map, const Chunk *chunk, const LabelRecord *records,
+                           size_t count, Command *command);
+static void  define_trailing(LabelMap *map, const Chunk *chunk, Command *command);
+static bool  copy_strings(StringList *to, const StringList *from);
+
+bool parse_commands_parallel(Parser *parser, const char *source, size_t length, LabelMap *map,
+                             Arena *arena, SourceMap *locations, int threads,
+                             Command **commands) {
+    if (!parser || !source || !map || !arena || !commands) {
+        return false;
+    }
+
+    int count = chunk_count(length, threads);
+    if (count < 2) {
+        return false;
+    }
+
+    Chunk     *chunks  = calloc(count, sizeof(Chunk));
+    pthread_t *workers = calloc(count, sizeof(pthread_t));
+    bool      *started = calloc(count, sizeof(bool));
+    if (!chunks || !workers || !started) {
+        free(chunks);
+        free(workers);
+        free(started);
+        return false;
+    }
+
+    count = split(source, length, chunks, count);
+    if (count < 2) {
+        free(chunks);
+        free(workers);
+        free(started);
+        return false;
+    }
+
+    // The first chunk is parsed here, as is any a thread could not be made for
+    for (int i = 1; i < count; i++) {
+        started[i] = pthread_create(&workers[i], NULL, parse_chunk, &chunks[i]) == 0;
+    }
+    parse_chunk(&chunks[0]);
+    for (int i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(workers[i], NULL);
+        } else {
+            parse_chunk(&chunks[i]);
+        }
+    }
+
+    // A chunk that stopped at a NUL ends the source, so those after it are not
+    // part of it
+    bool ok   = true;
+    int  used = 0;
+    for (; used < count && (used == 0 || !chunks[used - 1].last); used++) {
+        ok = ok && chunks[used].ok;
+    }
+    // A label defined in two chunks is left for `parse_commands` to report
+    ok = ok && defined_once(chunks, used);
+
+    if (ok) {
+        merge(parser, map, arena, locations, chunks, count, commands);
+    }
+    for (int i = 0; i < count; i++) {
+        parser_free(&chunks[i].parser);
+        label_map_free(&chunks[i].labels);
+        free(chunks[i].symbols);
+        label_log_free(&chunks[i].log);
+        source_map_free(&chunks[i].locations);
+        token_buffer_free(&chunks[i].tokens);
+        arena_free(&chunks[i].arena);
+    }
+    free(chunks);
+    free(workers);
+    free(started);
+    return ok;
+}
+
+/**
+ * @brief Decides how many chunks to split a source into.
+ *
+ * @param length The number of characters in the source.
+ * @param threads The number of threads asked for, or 0 to decide by the
+ * number of CPUs and the size of the source.
+ * @return The number of chunks, at most `PARALLEL_PARSE_MAX_THREADS`.
+ */
+static int chunk_count(size_t length, int threads) {
+    long count = threads;
+    if (count <= 0) {
+        long cpus  = sysconf(_SC_NPROCESSORS_ONLN);
+        long worth = (long) (length / PARALLEL_PARSE_MIN_CHUNK);
+        count      = (cpus < worth) ? cpus : worth;
+    }
+    return (count > PARALLEL_PARSE_MAX_THREADS) ? PARALLEL_PARSE_MAX_THREADS : (int) count;
+}
+
+/**
+ * @brief Splits a source into chunks of about equal length, each ending just
+ * after a newline or at the end of the source.
+ *
+ * @param source The source to split.
+ * @param length The number of characters in the source.
+ * @param chunks The chunks to fill in.
+ * @param count The number of chunks to aim for.
+ * @return The number of chunks made, fewer than `count` if there are too few
+ * lines.
+ */
+static int split(const char *source, size_t length, Chunk *chunks, int count) {
+    size_t start = 0;
+    int    made  = 0;
+    for (int i = 1; i <= count && start < length; i++) {
+        size_t end = (i == count) ? length : length / count * i;
+        if (end < start) {
+            end = start;
+        }
+        if (end < length) {
+            const char *nl = memchr(source + end, '\n', length - end);
+            end            = nl ? (size_t) (nl - source) + 1 : length;
+        }
+
+        chunks[made].text   = source + start;
+        chunks[made].length = end - start;
+        chunks[made].last   = end == length;
+        made++;
+        start = end;
+    }
+    return made;
+}
+
+/**
+ * @brief Lexes and parses one chunk. Run on a thread of its own.
+ *
+ * @param arg The `Chunk` to parse, which records the result.
+ * @return NULL.
+ */
+static void *parse_chunk(void *arg) {
+    Chunk *chunk = arg;
+    token_buffer_init(&chunk->tokens);
+    label_log_init(&chunk->log);
+    source_map_init(&chunk->locations);
+    arena_init(&chunk->arena);
+    if (!label_map_init(&chunk->labels, 64) ||
+        !token_buffer_lex_lines(&chunk->tokens, chunk->text, chunk->length)) {
+        return NULL;
+    }
+    // The EOF falls short of the chunk's end only where the lexer found a NUL
+    const TokenBuffer *tokens = &chunk->tokens;
+    if (tokens->offsets[tokens->count - 1] < chunk->length) {
+        chunk->last = true;
+    }
+    // A chunk that ends inside a string means the next one was lexed from the
+    // wrong place, so neither can be used
+    if (!chunk->last && !ends_at_line(chunk)) {
+        return NULL;
+    }
+
+    parser_init_tokens(&chunk->parser, &chunk->tokens, &chunk->labels, &chunk->arena);
+    chunk->parser.label_log  = &chunk->log;
+    chunk->parser.source_map = &chunk->locations;
+    chunk->head              = parse_commands(&chunk->parser);
+    if (chunk->parser.had_error) {
+        return NULL;
+    }
+
+    for (Command *cmd = chunk->head; cmd; cmd = cmd->next) {
+        chunk->tail = cmd;
+    }
+    // A label with nothing after it in the chunk has no command, and only
+    // labels are defined once the chunk has run out
+    const LabelRecord *records = chunk->log.records;
+    while (chunk->trailing < chunk->log.count &&
+           !records[chunk->log.count - chunk->trailing - 1].command) {
+        chunk->trailing++;
+    }
+    chunk->ok = true;
+    return NULL;
+}
+
+/**
+ * @brief Determines whether a chunk's last token is the newline ending it.
+ *
+ * @param chunk The lexed chunk.
+ * @return False if the chunk ends inside a string.
+ */
+static bool ends_at_line(const Chunk *chunk) {
+    const TokenBuffer *tokens = &chunk->tokens;
+    return tokens->count >= 2 && tokens->types[tokens->count - 2] == TOK_NL &&
+           tokens->offsets[tokens->count - 2] == chunk->length - 1;
+}
+
+/**
+ * @brief Determines whether no label is defined in more than one chunk.
+ *
+ * Each chunk's parser has already rejected a label defined twice within it.
+ *
+ * @param chunks The parsed chunks.
+ * @param count The number of chunks.
+ * @return True if every label is defined at most once, false if one is defined
+ * again or memory ran out.
+ */
+static bool defined_once(const Chunk *chunks, int count) {
+    LabelMap defined;
+    if (!label_map_init(&defined, 64)) {
+        return false;
+    }
+
+    bool once = true;
+    for (int i = 0; once && i < count; i++) {
+        // Labels this chunk defines are new to the map, unless an earlier one did
+        const Chunk *chunk  = &chunks[i];
+        int          before = defined.count;
+        for (size_t r = 0; once && r < chunk->log.count; r++) {
+            const Entry *entry  = &chunk->labels.entries[chunk->log.records[r].symbol];
+            int          symbol = intern_label(&defined, entry->id, entry->length);
+            once                = symbol >= before;
+        }
+    }
+    label_map_free(&defined);
+    return once;
+}
+
+/**
+ * @brief Joins the chunks' commands and applies their labels in source order.
+ *
+ * The recursive parser defines a label only once the command after it is
+ * parsed, so labels left at the end of a chunk are defined right after the
+ * first command of the next chunk that has one, innermost first. Each chunk's
+ * labels are interned into `map` in order, so symbol IDs are given out as in a
+ * single parse. The chunks' arenas are moved into the program's, so their
+ * commands outlive them. Each chunk counted lines from its own start, so its
+ * locations move down by the newlines of the chunks before it. The chunks after
+ * one that stopped at a NUL are left out.
+ *
+ * @param parser Pointer to the `Parser` to initialize with the externs and
+ * includes.
+ * @param map Pointer to the `LabelMap` to add the labels to.
+ * @param arena Pointer to the `Arena` to move the chunks' commands into.
+ * @param locations Pointer to the `SourceMap` to add the locations to, or NULL.
+ * @param chunks The parsed chunks.
+ * @param count The number of chunks.
+ * @param commands A pointer to store the head of the command list in.
+ */
+static void merge(Parser *parser, LabelMap *map, Arena *arena, SourceMap *locations,
+                  Chunk *chunks, int count, Command **commands) {
+    parser_init(parser, NULL, map, arena);
+
+    Command *head  = NULL;
+    Command *tail  = NULL;
+    size_t   lines = 0;
+
+    // Chunks whose trailing labels wait for a command, oldest first
+    int *waiting       = calloc(count, sizeof(int));
+    int  waiting_count = 0;
+    bool ok            = waiting != NULL;
+
+    for (int i = 0; i < count; i++) {
+        Chunk             *chunk   = &chunks[i];
+        const LabelRecord *records = chunk->log.records;
+        size_t             first   = chunk->log.first_command;
+        size_t             body    = chunk->log.count - chunk->trailing;
+
+        ok = ok && translate_symbols(map, chunk);
+        if (chunk->head) {
+            if (tail) {
+                tail->next = chunk->head;
+            } else {
+                head = chunk->head;
+            }
+            tail = chunk->tail;
+
+            if (ok) {
+                apply_records(map, chunk, records, first, NULL);
+                for (int w = waiting_count - 1; w >= 0; w--) {
+                    define_trailing(map, &chunks[waiting[w]], chunk->head);
+                }
+                apply_records(map, chunk, records + first, body - first, NULL);
+            }
+            waiting_count = 0;
+        }
+
+        if (ok && chunk->trailing) {
+            waiting[waiting_count++] = i;
+        }
+        ok = ok && copy_strings(&parser->externs, &chunk->parser.externs) &&
+             copy_strings(&parser->includes, &chunk->parser.includes) &&
+             (!locations || source_map_append(locations, &chunk->locations, lines));
+        lines += chunk->tokens.newline_count;
+        arena_adopt(arena, &chunk->arena);
+        if (chunk->last) {
+            break;
+        }
+    }
+
+    // Labels at the very end of the source point at nothing
+    for (int w = waiting_count - 1; ok && w >= 0; w--) {
+        define_trailing(map, &chunks[waiting[w]], NULL);
+    }
+
+    free(waiting);
+    parser->had_error = !ok;
+    // Commands left with a chunk's symbol IDs would name the wrong labels
+    *commands = ok ? head : NULL;
+}
+
+/**
+ * @brief Interns a chunk's labels into the program's label map and points the
+ * chunk's branches and calls at the program's symbols.
+ *
+ * @param map Pointer to the `LabelMap` of the whole program.
+ * @param chunk The chunk, whose `symbols` are filled in.
+ * @return True on success, false if memory ran out.
+ */
+static bool translate_symbols(LabelMap *map, Chunk *chunk) {
+    const LabelMap *labels = &chunk->labels;
+    chunk->symbols         = malloc((labels->count ? labels->count : 1) * sizeof(int));
+    if (!chunk->symbols) {
+        return false;
+    }
+    for (int i = 0; i < labels->count; i++) {
+        chunk->symbols[i] = intern_label(map, labels->entries[i].id, labels->entries[i].length);
+        if (chunk->symbols[i] < 0) {
+            return false;
+        }
+    }
+
+    for (Command *cmd = chunk->head; cmd; cmd = cmd->next) {
+        if (cmd->type == CMD_BRANCH || cmd->type == CMD_CALL) {
+            cmd->val_a.num_val = chunk->symbols[cmd->val_a.num_val];
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Applies a chunk's logged label definitions to a label map.
+ *
+ * @param map Pointer to the `LabelMap` to change.
+ * @param chunk The chunk the definitions were logged by, with its symbols
+ * translated.
+ * @param records The definitions, in order.
+ * @param count The number of definitions.
+ * @param command The command to point definitions at instead of their own, or
+ * NULL to keep theirs.
+ */
+static void apply_records(LabelMap *map, const Chunk *chunk, const LabelRecord *records,
+                          size_t count, Command *command) {
+    for (size_t i = 0; i < count; i++) {
+        Entry *entry   = &map->entries[chunk->symbols[records[i].symbol]];
+        entry->command = command ? command : records[i].command;
+    }
+}
+
+/**
+ * @brief Defines the labels left at the end of a chunk.
+ *
+ * @param map Pointer to the `LabelMap` to change.
+ * @param chunk The chunk the labels are at the end of.
+ * @param command The first command after the chunk, or NULL if there is none.
+ */
+static void define_trailing(LabelMap *map, const Chunk *chunk, Command *command) {
+    const LabelRecord *records = chunk->log.records + chunk->log.count - chunk->trailing;
+    apply_records(map, chunk, records, chunk->trailing, command);
+}
+
+/**
+ * @brief Appends copies of every string in one list to another.
+ *
+ * @param to Pointer to the `StringList` to append to.
+ * @param from Pointer to the `StringList` to copy.
+ * @return True on success, false if memory ran out.
+ */
+static bool copy_strings(StringList *to, const StringList *from) {
+    for (int i = 0; i < from->count; i++) {
+        if (!string_list_push(to, from->items[i], (int) strlen(from->items[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -8,29 +8,186 @@
 #include "command_type.h"
 #include "token_type.h"
 
+static void     start(Parser *parser, Lexer *lexer, LabelMap *map, Arena *arena);
+static Token    next_token(Parser *parser);
+static bool     claim_label(Parser *parser, int symbol);
+static bool     define_label(Parser *parser, int symbol, Command *cmd);
+static bool     log_label(LabelLog *log, int symbol, Command *cmd);
 static Token    advance(Parser *parser);
 static bool     consume(Parser *parser, TokenType type);
 static bool     is_at_end(Parser *parser);
 static void     skip_nls(Parser *parser);
 static bool     consume_newline(Parser *parser);
-static Command *create_command(CommandType type);
-static bool     is_variable(Token token);
-static bool     parse_variable(Token token, int64_t *var_num);
-static bool     parse_number(Token token, int64_t *result);
+static Command *create_command(Arena *arena, CommandType type);
 static bool     parse_variable_operand(Parser *parser, Operand *op);
 static bool     parse_var_or_imm(Parser *parser, Operand *op, bool *is_immediate);
 static Command *parse_cmd(Parser *parser);
 
-void parser_init(Parser *parser, Lexer *lexer, LabelMap *map) {
+void parser_init(Parser *parser, Lexer *lexer, LabelMap *map, Arena *arena) {
     if (!parser) {
         return;
     }
 
-    parser->lexer     = lexer;
-    parser->had_error = false;
-    parser->label_map = map;
-    parser->current   = lexer_next_token(parser->lexer);
-    parser->next      = lexer_next_token(parser->lexer);
+    parser->tokens.buffer = NULL;
+    start(parser, lexer, map, arena);
+}
+
+void parser_init_tokens(Parser *parser, const TokenBuffer *tokens, LabelMap *map, Arena *arena) {
+    if (!parser) {
+        return;
+    }
+
+    token_cursor_init(&parser->tokens, tokens, 0);
+    start(parser, NULL, map, arena);
+}
+
+void parser_free(Parser *parser) {
+    if (!parser) {
+        return;
+    }
+
+    string_list_free(&parser->externs);
+    string_list_free(&parser->includes);
+    free(parser->defined);
+    parser->defined     = NULL;
+    parser->defined_cap = 0;
+}
+
+void label_log_init(LabelLog *log) {
+    if (!log) {
+        return;
+    }
+
+    log->records       = NULL;
+    log->count         = 0;
+    log->capacity      = 0;
+    log->first_command = 0;
+}
+
+void label_log_free(LabelLog *log) {
+    if (!log) {
+        return;
+    }
+
+    free(log->records);
+    label_log_init(log);
+}
+
+/**
+ * @brief Sets up the state shared by every kind of parser and reads the first
+ * two tokens.
+ *
+ * @param parser Pointer to the `Parser` structure to initialize.
+ * @param lexer Pointer to the `Lexer` to read from, or NULL.
+ * @param map Pointer to the `LabelMap` for associating labels with commands.
+ * @param arena Pointer to the `Arena` to allocate the commands from.
+ */
+static void start(Parser *parser, Lexer *lexer, LabelMap *map, Arena *arena) {
+    parser->lexer      = lexer;
+    parser->had_error  = false;
+    parser->label_map  = map;
+    parser->label_log  = NULL;
+    parser->source_map = NULL;
+    parser->arena      = arena;
+    string_list_init(&parser->externs);
+    string_list_init(&parser->includes);
+    parser->defined     = NULL;
+    parser->defined_cap = 0;
+    parser->current     = next_token(parser);
+    parser->next        = next_token(parser);
+    parser->instruction = parser->current;
+}
+
+/**
+ * @brief Reads the next token from the lexer or the pre-lexed buffer.
+ *
+ * @param parser A pointer to the parser to read tokens from.
+ * @return The token after the last one read, or EOF if there is no source.
+ */
+static Token next_token(Parser *parser) {
+    if (parser->lexer) {
+        return lexer_next_token(parser->lexer);
+    }
+    if (parser->tokens.buffer) {
+        return token_cursor_next(&parser->tokens);
+    }
+
+    Token eof;
+    token_init(&eof, TOK_EOF, "", 0, 1, 1);
+    return eof;
+}
+
+/**
+ * @brief Notes that a label is being defined, which it may be only once in a
+ * parse.
+ *
+ * @param parser A pointer to the parser that read the label.
+ * @param symbol The symbol ID of the label in the parser's label map.
+ * @return True on success, false if the label was already defined or memory
+ * ran out.
+ */
+static bool claim_label(Parser *parser, int symbol) {
+    if (symbol >= parser->defined_cap) {
+        int capacity = parser->defined_cap ? parser->defined_cap : 64;
+        while (capacity <= symbol) {
+            capacity *= 2;
+        }
+        bool *defined = realloc(parser->defined, (size_t) capacity * sizeof(bool));
+        if (!defined) {
+            return false;
+        }
+        memset(defined + parser->defined_cap, 0,
+               (size_t) (capacity - parser->defined_cap) * sizeof(bool));
+        parser->defined     = defined;
+        parser->defined_cap = capacity;
+    }
+
+    if (parser->defined[symbol]) {
+        return false;
+    }
+    parser->defined[symbol] = true;
+    return true;
+}
+
+/**
+ * @brief Points a label at a command, or records that it should be.
+ *
+ * @param parser A pointer to the parser that read the label.
+ * @param symbol The symbol ID of the label in the parser's label map.
+ * @param cmd The command the label is on, or NULL at the end of the source.
+ * @return True on success, false if memory ran out.
+ */
+static bool define_label(Parser *parser, int symbol, Command *cmd) {
+    if (parser->label_log) {
+        return log_label(parser->label_log, symbol, cmd);
+    }
+    parser->label_map->entries[symbol].command = cmd;
+    return true;
+}
+
+/**
+ * @brief Appends a definition to a label log.
+ *
+ * @param log Pointer to the `LabelLog` to append to.
+ * @param symbol The symbol ID of the label.
+ * @param cmd The command the label is on.
+ * @return True on success, false if memory ran out.
+ */
+static bool log_label(LabelLog *log, int symbol, Command *cmd) {
+    if (log->count == log->capacity) {
+        size_t       capacity = log->capacity ? log->capacity * 2 : 64;
+        LabelRecord *records  = realloc(log->records, capacity * sizeof(LabelRecord));
+        if (!records) {
+            return false;
+        }
+        log->records  = records;
+        log->capacity = capacity;
+    }
+
+    log->records[log->count].symbol  = symbol;
+    log->records[log->count].command = cmd;
+    log->count++;
+    return true;
 }
 
 /**
@@ -43,7 +200,7 @@ static Token advance(Parser *parser) {
     Token ret_token = parser->current;
     if (!is_at_end(parser)) {
         parser->current = parser->next;
-        parser->next    = lexer_next_token(parser->lexer);
+        parser->next    = next_token(parser);
     }
     return ret_token;
 }
@@ -78,14 +235,13 @@ static bool consume(Parser *parser, TokenType type) {
 /**
  * @brief Creates a command of the given type.
  *
+ * @param arena Pointer to the `Arena` to allocate the command from.
  * @param type The type of the command to create.
- * @return A pointer to a command with the requested type.
- *
- * @note It is the responsibility of the caller to free the memory associated
- * with the returned command.
+ * @return A pointer to a command with the requested type, or NULL if memory
+ * ran out.
  */
-static Command *create_command(CommandType type) {
-    Command *cmd = (Command *) calloc(1, sizeof(Command));
+static Command *create_command(Arena *arena, CommandType type) {
+    Command *cmd = arena_alloc(arena, sizeof(Command));
     if (!cmd) {
         return NULL;
     }
@@ -100,105 +256,25 @@ static Command *create_command(CommandType type) {
     return cmd;
 }
 
-/**
- * @brief Determines if the given token is a valid variable.
- *
- * A valid (potential) variable is a token that begins with the prefix "x",
- * followed by any other character(s).
- *
- * @param token The token to check.
- * @return True if this token could be a variable, false otherwise.
- */
-static bool is_variable(Token token) {
-    return token.length >= 2 && token.lexeme[0] == 'x';
-}
-
-/**
- * @brief Determines if the given token is a valid base signifier.
- *
- * A valid base signifier is one of d (decimal), x (hex), b (binary) or s (string).
- *
- * @param token The token to check.
- * @return True if this token is a base signifier, false otherwise
- */
-static bool is_base(Token token) {
-    return token.length == 1 && (token.lexeme[0] == 'd' || token.lexeme[0] == 'x' ||
-                                 token.lexeme[0] == 's' || token.lexeme[0] == 'b');
-}
-
 /**
  * @brief Parses the given token as a base signifier
  *
- * A base is a single character, either d, s, x, or b.
+ * A base is a single character, either d (decimal), x (hex), b (binary) or
+ * s (string), whatever type of token it was lexed as.
  *
  * @param parser A pointer to the parser to read tokens from.
  * @param op A pointer to the operand to modify.
  * @return True if the current token was parsed as a base, false otherwise.
  */
 static bool parse_base(Parser *parser, Operand *op) {
-    if (!is_base(parser->current)) {
+    if (parser->current.length != 1 ||
+        !print_base_from_letter(parser->current.lexeme[0], &op->print_base)) {
         return false;
     }
-    size_t str_len = parser->current.length;
-    op->str_val    = malloc(str_len + 1);
-    if (!op->str_val) {
-        return false;
-    }
-    memcpy(op->str_val, parser->current.lexeme, str_len);
-    op->str_val[str_len] = '\0';
     advance(parser);
     return true;
 }
 
-/**
- * @brief Parses the given token as a variable.
- *
- * @param token The token to parse.
- * @param var_num a pointer to modify on success.
- * @return True if `var_num` was successfully modified, false otherwise.
- *
- * @note It is assumed that the token already was verified to begin with a valid
- * prefix, "x".
- */
-static bool parse_variable(Token token, int64_t *var_num) {
-    char   *endptr;
-    int64_t tempnum = strtol(token.lexeme + 1, &endptr, 10);
-
-    if ((token.lexeme + token.length) != endptr || tempnum < 0 || tempnum > 31) {
-        return false;
-    }
-
-    *var_num = tempnum;
-    return true;
-}
-
-/**
- * @brief Parses the given value as a number.
- *
- * @param token The token to parse.
- * @param result A pointer to the value to modify on success.
- * @return True if `result` was successfully modified, false otherwise.
- */
-static bool parse_number(Token token, int64_t *result) {
-    const char *parse_start = token.lexeme;
-    int         base        = 10;
-
-    if (token.length > 2 && token.lexeme[0] == '0') {
-        if (token.lexeme[1] == 'x') {
-            parse_start += 2;
-            base = 16;
-        } else if (token.lexeme[1] == 'b') {
-            parse_start += 2;
-            base = 2;
-        }
-    }
-
-    char *endptr;
-    *result = strtoll(parse_start, &endptr, base);
-
-    return (token.lexeme + token.length) == endptr;
-}
-
 /**
  * @brief Conditionally parses the current token as a number.
  *
@@ -212,53 +288,12 @@ static bool parse_number(Token token, int64_t *result) {
  */
 static bool parse_im(Parser *parser, Operand *op) {
     Token *token = &parser->current;
-    if (token->type != TOK_NUM) {
+    // The lexer has decoded it; a number without a value is malformed
+    if (token->type != TOK_NUM || token->value < 0) {
         return false;
     }
 
-    uint64_t value = 0;
-    if (token->length >= 2 && token->lexeme[0] == '0') {
-        if (token->lexeme[1] == 'x' || token->lexeme[1] == 'X') {
-            for (int i = 2; i < token->length; i++) {
-                char c = token->lexeme[i];
-                if (c >= '0' && c <= '9') {
-                    value = value * 16 + (c - '0');
-                } else if (c >= 'a' && c <= 'f') {
-                    value = value * 16 + (c - 'a' + 10);
-                } else if (c >= 'A' && c <= 'F') {
-                    value = value * 16 + (c - 'A' + 10);
-                } else {
-                    return false;
-                }
-            }
-        } else if (token->lexeme[1] == 'b' || token->lexeme[1] == 'B') {
-            for (int i = 2; i < token->length; i++) {
-                char c = token->lexeme[i];
-                if (c == '0' || c == '1') {
-                    value = value * 2 + (c - '0');
-                } else {
-                    return false;
-                }
-            }
-        } else {
-            return false;
-        }
-    } else {
-        for (int i = 0; i < token->length; i++) {
-            char c = token->lexeme[i];
-            if (c >= '0' && c <= '9') {
-                value = value * 10 + (c - '0');
-            } else {
-                return false;
-            }
-        }
-    }
-
-    if (value > (uint64_t) INT64_MAX) {
-        value = INT64_MAX;
-    }
-
-    op->num_val = value;
+    op->num_val = token->value;
     advance(parser);
     return true;
 }
@@ -276,16 +311,12 @@ static bool parse_im(Parser *parser, Operand *op) {
 static bool parse_variable_operand(Parser *parser, Operand *op) {
     Token *token = &parser->current;
 
-    if (token->type != TOK_IDENT || !is_variable(*token)) {
+    // The lexer has found which register, if any, the identifier names
+    if (token->type != TOK_IDENT || token->value < 0) {
         return false;
     }
 
-    int64_t var_num = 0;
-    if (!parse_variable(*token, &var_num)) {
-        return false;
-    }
-
-    op->base = var_num;
+    op->base = (char) token->value;
     advance(parser);
     return true;
 }
@@ -368,8 +399,8 @@ static bool consume_newline(Parser *parser) {
  * @return A pointer to the appropriate command.
  * Returns null if an error occurred or there are no commands to parse.
  *
- * @note The caller is responsible for freeing the memory associated with the
- * returned command.
+ * @note The command is allocated from the parser's arena, as is anything left
+ * of it after an error.
  */
 static Command *parse_cmd(Parser *parser) {
     skip_nls(parser);
@@ -379,25 +410,23 @@ static Command *parse_cmd(Parser *parser) {
     Token token = parser->current;
 
     if (token.type == TOK_IDENT && parser->next.type == TOK_COLON) {
-        Token label_token = parser->current;
-        advance(parser);
-        consume(parser, TOK_COLON);
-        Command *cmd       = parse_cmd(parser);
-        char    *label_str = malloc(label_token.length + 1);
-        if (!label_str) {
+        // Interned before parsing on, as a streaming lexer only keeps recent tokens,
+        // and claimed then, so a second definition is reported where it is
+        int symbol = intern_label(parser->label_map, parser->current.lexeme,
+                                  (size_t) parser->current.length);
+        if (symbol < 0 || !claim_label(parser, symbol)) {
             parser->had_error = true;
             return NULL;
         }
-        memcpy(label_str, label_token.lexeme, label_token.length);
-        label_str[label_token.length] = '\0';
 
-        if (!put_label(parser->label_map, label_str, cmd)) {
-            free(label_str);
+        advance(parser);
+        consume(parser, TOK_COLON);
+        Command *cmd = parse_cmd(parser);
+
+        if (!define_label(parser, symbol, cmd)) {
             parser->had_error = true;
-            free_command(cmd);
             return NULL;
         }
-        free(label_str);
         return cmd;
     }
 
@@ -408,9 +437,12 @@ static Command *parse_cmd(Parser *parser) {
         return NULL;
     }
 
+    // Any labels on the instruction were read by the calls above, so it starts here
+    parser->instruction = token;
+
     switch (token.type) {
         case TOK_ADD: {
-            Command *cmd = create_command(CMD_ADD);
+            Command *cmd = create_command(parser->arena, CMD_ADD);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -420,21 +452,18 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             bool is_immediate_a = false;
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             bool is_immediate_b = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -443,7 +472,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -452,7 +480,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_SUB: {
-            Command *cmd = create_command(CMD_SUB);
+            Command *cmd = create_command(parser->arena, CMD_SUB);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -462,13 +490,11 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_a_immediate = false;
@@ -476,14 +502,12 @@ static Command *parse_cmd(Parser *parser) {
             bool is_immediate_b = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_b_immediate = is_immediate_b;
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -492,7 +516,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_MOV: {
-            Command *cmd = create_command(CMD_MOV);
+            Command *cmd = create_command(parser->arena, CMD_MOV);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -501,25 +525,21 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (parser->current.type != TOK_NUM) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             if (!parse_im(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_a_immediate = true;
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             advance(parser);
@@ -527,7 +547,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_CMP: {
-            Command *cmd = create_command(CMD_CMP);
+            Command *cmd = create_command(parser->arena, CMD_CMP);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -537,14 +557,12 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             bool is_immediate_b = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_a_immediate = false;
@@ -552,7 +570,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -561,7 +578,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_CMP_U: {
-            Command *cmd = create_command(CMD_CMP_U);
+            Command *cmd = create_command(parser->arena, CMD_CMP_U);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -570,7 +587,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_a_immediate = false;
@@ -578,14 +594,12 @@ static Command *parse_cmd(Parser *parser) {
             bool is_immediate_b = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_b_immediate = is_immediate_b;
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             advance(parser);
@@ -593,7 +607,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_PRINT: {
-            Command *cmd = create_command(CMD_PRINT);
+            Command *cmd = create_command(parser->arena, CMD_PRINT);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -604,21 +618,17 @@ static Command *parse_cmd(Parser *parser) {
             bool is_immediate = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_b_immediate = is_immediate;
 
             if (!parse_base(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
-            cmd->is_a_string = true;
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -627,7 +637,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_AND: {
-            Command *cmd = create_command(CMD_AND);
+            Command *cmd = create_command(parser->arena, CMD_AND);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -637,25 +647,21 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -664,7 +670,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_EOR: {
-            Command *cmd = create_command(CMD_EOR);
+            Command *cmd = create_command(parser->arena, CMD_EOR);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -674,25 +680,21 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -701,7 +703,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_ORR: {
-            Command *cmd = create_command(CMD_ORR);
+            Command *cmd = create_command(parser->arena, CMD_ORR);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -711,25 +713,21 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_b)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -738,7 +736,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_LSL: {
-            Command *cmd = create_command(CMD_LSL);
+            Command *cmd = create_command(parser->arena, CMD_LSL);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -748,20 +746,17 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             bool is_immediate = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -769,7 +764,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -778,7 +772,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_LSR: {
-            Command *cmd = create_command(CMD_LSR);
+            Command *cmd = create_command(parser->arena, CMD_LSR);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -788,20 +782,17 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             bool is_immediate = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -809,7 +800,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -818,7 +808,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_ASR: {
-            Command *cmd = create_command(CMD_ASR);
+            Command *cmd = create_command(parser->arena, CMD_ASR);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -828,20 +818,17 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (!parse_variable_operand(parser, &cmd->val_a)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             bool is_immediate = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -849,7 +836,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -858,7 +844,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_LOAD: {
-            Command *cmd = create_command(CMD_LOAD);
+            Command *cmd = create_command(parser->arena, CMD_LOAD);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -868,7 +854,6 @@ static Command *parse_cmd(Parser *parser) {
 
             if (!parse_variable_operand(parser, &cmd->destination)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -876,7 +861,6 @@ static Command *parse_cmd(Parser *parser) {
             if (!parse_var_or_imm(parser, &cmd->val_a, &is_immediate_offset) ||
                 !is_immediate_offset) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -885,14 +869,12 @@ static Command *parse_cmd(Parser *parser) {
             bool is_immediate_address = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_address)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_b_immediate = is_immediate_address;
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -901,7 +883,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_STORE: {
-            Command *cmd = create_command(CMD_STORE);
+            Command *cmd = create_command(parser->arena, CMD_STORE);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -912,7 +894,6 @@ static Command *parse_cmd(Parser *parser) {
             bool is_immediate_src = false;
             if (!parse_var_or_imm(parser, &cmd->val_a, &is_immediate_src)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_a_immediate = is_immediate_src;
@@ -920,7 +901,6 @@ static Command *parse_cmd(Parser *parser) {
             bool is_immediate_address = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_address)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -930,13 +910,11 @@ static Command *parse_cmd(Parser *parser) {
             if (!parse_var_or_imm(parser, &cmd->destination, &is_immediate_size) ||
                 !is_immediate_size) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -945,7 +923,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_PUT: {
-            Command *cmd = create_command(CMD_PUT);
+            Command *cmd = create_command(parser->arena, CMD_PUT);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -954,36 +932,32 @@ static Command *parse_cmd(Parser *parser) {
 
             if (parser->current.type != TOK_STR) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
             size_t str_len = parser->current.length;
 
-            cmd->val_a.str_val = malloc(str_len + 1);
+            cmd->val_a.str_val = arena_copy_string(parser->arena, parser->current.lexeme, str_len);
             if (!cmd->val_a.str_val) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
+            cmd->is_a_string = true;
 
-            memcpy(cmd->val_a.str_val, parser->current.lexeme, str_len);
-            cmd->val_a.str_val[str_len] = '\0';
-            cmd->is_a_string            = true;
+            // The string's length, so execution never needs to measure it
+            cmd->destination.num_val = (int64_t) str_len;
 
             advance(parser);
 
             bool is_immediate_address = false;
             if (!parse_var_or_imm(parser, &cmd->val_b, &is_immediate_address)) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             cmd->is_b_immediate = is_immediate_address;
 
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
 
@@ -998,7 +972,7 @@ static Command *parse_cmd(Parser *parser) {
         case TOK_BRANCH_LE:
         case TOK_BRANCH_LT:
         case TOK_BRANCH_NEQ: {
-            Command *cmd = create_command(CMD_BRANCH);
+            Command *cmd = create_command(parser->arena, CMD_BRANCH);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -1033,35 +1007,26 @@ static Command *parse_cmd(Parser *parser) {
             advance(parser);
             if (parser->current.type != TOK_IDENT) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
-            size_t len         = parser->current.length;
-            cmd->val_a.str_val = malloc(len + 1);
-            if (!cmd->val_a.str_val) {
+            // Refers to the label by symbol, which is known even if never defined
+            cmd->val_a.num_val = intern_label(parser->label_map, parser->current.lexeme,
+                                              (size_t) parser->current.length);
+            if (cmd->val_a.num_val < 0) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
-            memcpy(cmd->val_a.str_val, parser->current.lexeme, len);
-            cmd->val_a.str_val[len] = '\0';
-            cmd->is_a_string        = true;
             advance(parser);
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             advance(parser);
-
-            if (!get_label(parser->label_map, cmd->val_a.str_val)) {
-                put_label(parser->label_map, cmd->val_a.str_val, NULL);
-            }
             return cmd;
         }
 
         case TOK_RET: {
-            Command *cmd = create_command(CMD_RET);
+            Command *cmd = create_command(parser->arena, CMD_RET);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -1069,7 +1034,6 @@ static Command *parse_cmd(Parser *parser) {
             advance(parser);
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             advance(parser);
@@ -1077,7 +1041,7 @@ static Command *parse_cmd(Parser *parser) {
         }
 
         case TOK_CALL: {
-            Command *cmd = create_command(CMD_CALL);
+            Command *cmd = create_command(parser->arena, CMD_CALL);
             if (!cmd) {
                 parser->had_error = true;
                 return NULL;
@@ -1085,31 +1049,45 @@ static Command *parse_cmd(Parser *parser) {
             advance(parser);
             if (parser->current.type != TOK_IDENT) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
-            size_t len         = parser->current.length;
-            cmd->val_a.str_val = malloc(len + 1);
-            if (!cmd->val_a.str_val) {
+            // Refers to the label by symbol, which is known even if never defined
+            cmd->val_a.num_val = intern_label(parser->label_map, parser->current.lexeme,
+                                              (size_t) parser->current.length);
+            if (cmd->val_a.num_val < 0) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
-            memcpy(cmd->val_a.str_val, parser->current.lexeme, len);
-            cmd->val_a.str_val[len] = '\0';
-            cmd->is_a_string        = true;
             advance(parser);
             if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
                 parser->had_error = true;
-                free_command(cmd);
                 return NULL;
             }
             advance(parser);
+            return cmd;
+        }
+
+        case TOK_EXTERN:
+        case TOK_INCLUDE: {
+            advance(parser);
 
-            if (!get_label(parser->label_map, cmd->val_a.str_val)) {
-                put_label(parser->label_map, cmd->val_a.str_val, NULL);
+            // Directives produce no command; any label before one belongs to
+            // whatever command follows it.
+            TokenType   operand_type = (token.type == TOK_EXTERN) ? TOK_IDENT : TOK_STR;
+            StringList *list = (token.type == TOK_EXTERN) ? &parser->externs : &parser->includes;
+            if (parser->current.type != operand_type ||
+                !string_list_push(list, parser->current.lexeme, parser->current.length)) {
+                parser->had_error = true;
+                return NULL;
             }
-            return cmd;
+            advance(parser);
+
+            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
+                parser->had_error = true;
+                return NULL;
+            }
+            advance(parser);
+            return parse_cmd(parser);
         }
 
         default:
@@ -1139,8 +1117,17 @@ Command *parse_commands(Parser *parser) {
         }
 
         if (cmd) {
+            if (parser->source_map &&
+                !source_map_push(parser->source_map, parser->instruction.line,
+                                 parser->instruction.column)) {
+                parser->had_error = true;
+                break;
+            }
             if (!head) {
                 head = cmd;
+                if (parser->label_log) {
+                    parser->label_log->first_command = parser->label_log->count;
+                }
             } else {
                 tail->next = cmd;
             }
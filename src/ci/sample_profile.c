@@ -0,0 +1,535 @@
+#define _DEFAULT_SOURCE
+#include "sample_profile.h"
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "counter_table.h"
+
+#define INITIAL_SAMPLES 1024
+#define MAIN_SYMBOL     -1  // Stands for the program itself, outside any call.
+#define NO_SYMBOL       -2  // Stands for a function cut off a sample by the depth limit.
+
+/**
+ * @brief What the report needs to know about one sampled command.
+ */
+typedef struct {
+    const Command *command;  // The command, or NULL until the spot is filled in.
+    long           index;    // Position in the program, or -1 if it is in an included object.
+    int            symbol;   // The label it ran in, or `MAIN_SYMBOL` or `NO_SYMBOL`.
+    uint64_t       samples;  // Samples taken while it was running.
+} Spot;
+
+/**
+ * @brief The frames of one sample, for ordering samples by their stacks.
+ */
+typedef struct {
+    const Command **frames;  // The calls kept and then the command running.
+    uint32_t        length;  // Commands in `frames`.
+    bool            cut;     // Set if calls were left out for the depth limit.
+} Stack;
+
+static SampleProfile *volatile active = NULL;  // The profile to ask for samples.
+static struct sigaction        old_prof;       // The handler in place before sampling.
+static timer_t                 timer;          // The sampling timer, while `armed`.
+static bool                    armed = false;  // Set while `timer` exists.
+static struct timespec         started;        // The CPU time of the process at the start.
+
+static void        request_sample(int sig);
+static bool        reserve_sample(SampleProfile *profile, uint32_t kept);
+static uint32_t    kept_calls(uint32_t depth);
+static double      cpu_seconds(void);
+static Spot       *add_spot(CounterTable *table, const Command *cmd);
+static bool        collect_spots(SampleProfile *profile, Command *commands, CounterTable *table);
+static int         sample_symbol(const SampleProfile *profile, const Sample *sample);
+static const char *symbol_name(const LabelMap *labels, int symbol);
+static void        write_frame(FILE *out, const char *name, const CounterTable *table,
+                               const Command *cmd, const SourceMap *locations);
+static int         compare_spots(const void *a, const void *b);
+static int         compare_stacks(const void *a, const void *b);
+
+void sample_profile_init(SampleProfile *profile, int hz) {
+    profile->pending         = 0;
+    profile->depth           = 0;
+    profile->hz              = hz;
+    profile->samples         = NULL;
+    profile->sample_count    = 0;
+    profile->sample_capacity = 0;
+    profile->frames          = NULL;
+    profile->frame_count     = 0;
+    profile->frame_capacity  = 0;
+    profile->dropped         = 0;
+    profile->cpu_time        = 0;
+    profile->incomplete      = false;
+}
+
+void sample_profile_free(SampleProfile *profile) {
+    free(profile->samples);
+    free(profile->frames);
+    sample_profile_init(profile, profile->hz);
+}
+
+void sample_profile_start(SampleProfile *profile) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_sample;
+    action.sa_flags   = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    active = profile;
+    sigaction(SIGPROF, &action, &old_prof);
+
+    // A timer on the process's CPU clock, which like `ITIMER_PROF` is only
+    // checked on the kernel's tick, so faster rates than it are cut to it
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo  = SIGPROF;
+    long              period = 1000000000L / profile->hz;
+    struct itimerspec spec   = {{0, period > 0 ? period : 1}, {0, period > 0 ? period : 1}};
+    armed = timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &timer) == 0;
+    if (!armed || timer_settime(timer, 0, &spec, NULL) != 0) {
+        profile->incomplete = true;
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &started);
+}
+
+void sample_profile_stop(SampleProfile *profile) {
+    profile->cpu_time += cpu_seconds();
+    if (armed) {
+        timer_delete(timer);
+        armed = false;
+    }
+    // A signal still pending finds no profile and is ignored
+    active = NULL;
+    sigaction(SIGPROF, &old_prof, NULL);
+    profile->pending = 0;
+}
+
+void sample_profile_take(SampleProfile *profile, const Command *cmd) {
+    profile->pending = 0;
+
+    uint32_t kept = kept_calls(profile->depth);
+    if (!reserve_sample(profile, kept)) {
+        profile->dropped++;
+        return;
+    }
+
+    Sample *sample = &profile->samples[profile->sample_count++];
+    sample->first  = (uint32_t) profile->frame_count;
+    sample->depth  = profile->depth;
+    memcpy(&profile->frames[profile->frame_count], profile->calls, kept * sizeof(const Command *));
+    profile->frame_count += kept;
+    profile->frames[profile->frame_count++] = cmd;
+}
+
+void sample_profile_enter(SampleProfile *profile, const Command *call) {
+    uint32_t depth = profile->depth;
+    if (depth < SAMPLE_PROFILE_MAX_DEPTH) {
+        profile->calls[depth] = call;
+    }
+    profile->depth = depth + 1;
+}
+
+void sample_profile_leave(SampleProfile *profile) {
+    if (profile->depth > 0) {
+        profile->depth--;
+    }
+}
+
+void sample_profile_report(SampleProfile *profile, Command *commands, const LabelMap *labels,
+                           const SourceMap *locations, FILE *out) {
+    size_t samples = profile->sample_count;
+    fprintf(out, "Sample profile:\n");
+    double rate    = (profile->cpu_time > 0) ? (double) samples / profile->cpu_time : 0;
+    fprintf(out, "Samples: %zu in %.3f s of CPU time, %.0f Hz (%d Hz asked for)\n", samples,
+            profile->cpu_time, rate, profile->hz);
+    if (samples > 0 && rate < profile->hz * 0.9) {
+        fprintf(out, "Fewer than asked for: CPU time timers only fire on the kernel's tick\n");
+    }
+    if (profile->dropped) {
+        fprintf(out, "Dropped %" PRIu64 " samples that could not be stored\n", profile->dropped);
+    }
+    if (profile->incomplete) {
+        fprintf(out, "Could not start the sampling timer\n");
+    }
+    if (samples == 0) {
+        return;
+    }
+
+    uint64_t depths  = 0;
+    uint32_t deepest = 0;
+    for (size_t i = 0; i < samples; i++) {
+        depths += profile->samples[i].depth;
+        deepest = (profile->samples[i].depth > deepest) ? profile->samples[i].depth : deepest;
+    }
+    fprintf(out, "Call depth: mean %.1f, max %" PRIu32 "\n", (double) depths / (double) samples,
+            deepest);
+
+    CounterTable table;
+    counter_table_init(&table, sizeof(Spot));
+    Spot *ranked = NULL;
+    // Self and total samples per label, with the program itself last
+    size_t    symbols = (size_t) labels->count + 1;
+    uint64_t *self    = calloc(symbols, sizeof(uint64_t));
+    uint64_t *total   = calloc(symbols, sizeof(uint64_t));
+    size_t   *seen    = calloc(symbols, sizeof(size_t));
+    if (!self || !total || !seen || !collect_spots(profile, commands, &table) ||
+        !(ranked = counter_table_copy(&table))) {
+        fprintf(out, "Not enough memory to rank the profile\n");
+        free(self);
+        free(total);
+        free(seen);
+        counter_table_free(&table);
+        return;
+    }
+
+    // Calls only seen on the stack were never running themselves
+    size_t count = 0;
+    for (size_t i = 0; i < table.count; i++) {
+        if (ranked[i].samples) {
+            ranked[count++] = ranked[i];
+        }
+    }
+    qsort(ranked, count, sizeof(Spot), compare_spots);
+
+    // Only branches, calls and returns take samples
+    fprintf(out, "\nHottest branches, calls and returns, with the commands leading up to each:\n");
+    for (size_t i = 0; i < count && i < SAMPLE_PROFILE_TOP; i++) {
+        if (ranked[i].index >= 0) {
+            fprintf(out, "    #%ld", ranked[i].index);
+            const SourceLocation *location = source_map_at(locations, (size_t) ranked[i].index);
+            if (location) {
+                fprintf(out, " line %" PRIu32, location->line);
+            }
+        } else {
+            fprintf(out, "    included");
+        }
+        fprintf(out, " in %s: %" PRIu64 " (%.1f%%)\n", symbol_name(labels, ranked[i].symbol),
+                ranked[i].samples, (double) ranked[i].samples * 100 / (double) samples);
+    }
+
+    uint64_t unknown = 0;  // Samples whose label was beyond the depth limit
+    for (size_t i = 0; i < samples; i++) {
+        const Sample *sample = &profile->samples[i];
+        int           symbol = sample_symbol(profile, sample);
+        if (symbol == NO_SYMBOL) {
+            unknown++;
+        } else {
+            self[(symbol == MAIN_SYMBOL) ? symbols - 1 : (size_t) symbol]++;
+        }
+
+        // Each label counts once per sample, however often it recurses
+        uint32_t kept = kept_calls(sample->depth);
+        for (uint32_t c = 0; c <= kept; c++) {
+            size_t slot = symbols - 1;
+            if (c > 0) {
+                slot = (size_t) profile->frames[sample->first + c - 1]->val_a.num_val;
+            }
+            if (seen[slot] != i + 1) {
+                seen[slot] = i + 1;
+                total[slot]++;
+            }
+        }
+    }
+
+    fprintf(out, "\nLabels (self, total):\n");
+    for (size_t shown = 0; shown < SAMPLE_PROFILE_TOP; shown++) {
+        // A linear scan per line shown, as the ranking stops after a few lines
+        size_t busiest = 0;
+        for (size_t s = 1; s < symbols; s++) {
+            if (total[s] > total[busiest] ||
+                (total[s] == total[busiest] && self[s] > self[busiest])) {
+                busiest = s;
+            }
+        }
+        if (total[busiest] == 0) {
+            break;
+        }
+        int symbol = (busiest == symbols - 1) ? MAIN_SYMBOL : (int) busiest;
+        fprintf(out, "    %s: %" PRIu64 " (%.1f%%), %" PRIu64 " (%.1f%%)\n",
+                symbol_name(labels, symbol), self[busiest],
+                (double) self[busiest] * 100 / (double) samples, total[busiest],
+                (double) total[busiest] * 100 / (double) samples);
+        total[busiest] = 0;
+        self[busiest]  = 0;
+    }
+    if (unknown) {
+        fprintf(out, "    beyond the depth limit: %" PRIu64 " (%.1f%%)\n", unknown,
+                (double) unknown * 100 / (double) samples);
+    }
+
+    free(ranked);
+    free(self);
+    free(total);
+    free(seen);
+    counter_table_free(&table);
+}
+
+void sample_profile_write_folded(SampleProfile *profile, Command *commands,
+                                 const LabelMap *labels, const SourceMap *locations, FILE *out) {
+    size_t       samples = profile->sample_count;
+    Stack       *stacks  = malloc((samples + 1) * sizeof(Stack));
+    CounterTable table;
+    counter_table_init(&table, sizeof(Spot));
+    if (!stacks || !collect_spots(profile, commands, &table)) {
+        fprintf(stderr, "Not enough memory to fold the samples\n");
+        free(stacks);
+        counter_table_free(&table);
+        return;
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        const Sample *sample = &profile->samples[i];
+        uint32_t      kept   = kept_calls(sample->depth);
+        stacks[i] = (Stack) {&profile->frames[sample->first], kept + 1, sample->depth > kept};
+    }
+    // Equal stacks end up next to each other, to be counted together
+    qsort(stacks, samples, sizeof(Stack), compare_stacks);
+
+    for (size_t i = 0; i < samples;) {
+        size_t run = 1;
+        while (i + run < samples && compare_stacks(&stacks[i], &stacks[i + run]) == 0) {
+            run++;
+        }
+
+        // Each frame is the label called and the line running in it
+        const Stack *stack = &stacks[i];
+        const char  *name  = symbol_name(labels, MAIN_SYMBOL);
+        for (uint32_t f = 0; f < stack->length; f++) {
+            bool leaf = f + 1 == stack->length;
+            if (leaf && stack->cut) {
+                fprintf(out, "...;");
+                name = symbol_name(labels, NO_SYMBOL);
+            }
+            write_frame(out, name, &table, stack->frames[f], locations);
+            fprintf(out, leaf ? " %zu\n" : ";", run);
+            if (!leaf) {
+                name = symbol_name(labels, (int) stack->frames[f]->val_a.num_val);
+            }
+        }
+        i += run;
+    }
+
+    free(stacks);
+    counter_table_free(&table);
+}
+
+/**
+ * @brief Asks the engine for a sample. Called on every `SIGPROF`.
+ */
+static void request_sample(int sig) {
+    (void) sig;
+    SampleProfile *profile = active;
+    if (profile) {
+        profile->pending = 1;
+    }
+}
+
+/**
+ * @brief Makes room for one more sample and its frames, doubling the buffers
+ * as needed up to their limits.
+ *
+ * @param profile Pointer to the `SampleProfile` to grow.
+ * @param kept The calls the sample keeps.
+ * @return True if there is room, false if a limit was reached or memory ran out.
+ */
+static bool reserve_sample(SampleProfile *profile, uint32_t kept) {
+    size_t frames = profile->frame_count + kept + 1;
+    if (profile->sample_count == SAMPLE_PROFILE_MAX_SAMPLES || frames > SAMPLE_PROFILE_MAX_FRAMES) {
+        return false;
+    }
+
+    if (profile->sample_count == profile->sample_capacity) {
+        size_t  capacity = profile->sample_capacity ? profile->sample_capacity * 2
+                                                    : INITIAL_SAMPLES;
+        Sample *samples  = realloc(profile->samples, capacity * sizeof(Sample));
+        if (!samples) {
+            return false;
+        }
+        profile->samples         = samples;
+        profile->sample_capacity = capacity;
+    }
+
+    if (frames > profile->frame_capacity) {
+        size_t capacity = profile->frame_capacity ? profile->frame_capacity * 2 : INITIAL_SAMPLES;
+        while (capacity < frames) {
+            capacity *= 2;
+        }
+        const Command **grown = realloc(profile->frames, capacity * sizeof(const Command *));
+        if (!grown) {
+            return false;
+        }
+        profile->frames         = grown;
+        profile->frame_capacity = capacity;
+    }
+    return true;
+}
+
+/**
+ * @brief Gives the number of calls a sample keeps.
+ *
+ * @param depth The calls in progress when the sample was taken.
+ * @return The outermost calls kept, at most `SAMPLE_PROFILE_MAX_DEPTH`.
+ */
+static uint32_t kept_calls(uint32_t depth) {
+    return (depth < SAMPLE_PROFILE_MAX_DEPTH) ? depth : SAMPLE_PROFILE_MAX_DEPTH;
+}
+
+/**
+ * @brief Gives the CPU time the process has used since sampling started.
+ *
+ * @return The CPU time in seconds.
+ */
+static double cpu_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (double) (now.tv_sec - started.tv_sec) + (double) (now.tv_nsec - started.tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Finds the spot of a command, adding it if it is new.
+ *
+ * @param table The table to add to.
+ * @param cmd The command.
+ * @return The spot, or NULL if memory ran out.
+ */
+static Spot *add_spot(CounterTable *table, const Command *cmd) {
+    Spot *spot = counter_table_add(table, (uint64_t) (uintptr_t) cmd);
+    if (spot && !spot->command) {
+        *spot = (Spot) {cmd, -1, NO_SYMBOL, 0};
+    }
+    return spot;
+}
+
+/**
+ * @brief Gathers every command the samples name, counting the samples each
+ * was running in, and numbers them in one pass over the program.
+ *
+ * @param profile The profile to gather from.
+ * @param commands The program.
+ * @param table An empty table to fill.
+ * @return True on success, false if memory ran out.
+ */
+static bool collect_spots(SampleProfile *profile, Command *commands, CounterTable *table) {
+    for (size_t i = 0; i < profile->sample_count; i++) {
+        const Sample *sample = &profile->samples[i];
+        uint32_t      kept   = kept_calls(sample->depth);
+        for (uint32_t c = 0; c < kept; c++) {
+            if (!add_spot(table, profile->frames[sample->first + c])) {
+                return false;
+            }
+        }
+
+        Spot *leaf = add_spot(table, profile->frames[sample->first + kept]);
+        if (!leaf) {
+            return false;
+        }
+        // A sample cut off by the depth limit cannot tell, so a later one may
+        leaf->samples++;
+        if (leaf->symbol == NO_SYMBOL) {
+            leaf->symbol = sample_symbol(profile, sample);
+        }
+    }
+
+    if (table->count == 0) {
+        return true;
+    }
+    long index = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next, index++) {
+        Spot *spot = counter_table_find(table, (uint64_t) (uintptr_t) cmd);
+        if (spot) {
+            spot->index = index;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Gives the label a sample's command was running in.
+ *
+ * @param profile The profile the sample is from.
+ * @param sample The sample.
+ * @return The symbol ID of the label last called, `MAIN_SYMBOL` outside any
+ * call, or `NO_SYMBOL` if that call was beyond the depth limit.
+ */
+static int sample_symbol(const SampleProfile *profile, const Sample *sample) {
+    if (sample->depth == 0) {
+        return MAIN_SYMBOL;
+    }
+    if (sample->depth > SAMPLE_PROFILE_MAX_DEPTH) {
+        return NO_SYMBOL;
+    }
+    return (int) profile->frames[sample->first + sample->depth - 1]->val_a.num_val;
+}
+
+/**
+ * @brief Returns the name of a label for the report.
+ */
+static const char *symbol_name(const LabelMap *labels, int symbol) {
+    if (symbol == MAIN_SYMBOL) {
+        return "main";
+    }
+    if (symbol == NO_SYMBOL || symbol >= labels->count) {
+        return "?";
+    }
+    return labels->entries[symbol].id;
+}
+
+/**
+ * @brief Writes one folded stack frame: a label and, if it is known, the line
+ * running in it.
+ *
+ * @param out The stream to write to.
+ * @param name The label.
+ * @param table The spots, giving the position of the command.
+ * @param cmd The command running in the frame.
+ * @param locations The source map of the program, or NULL.
+ */
+static void write_frame(FILE *out, const char *name, const CounterTable *table,
+                        const Command *cmd, const SourceMap *locations) {
+    const Spot           *spot     = counter_table_find(table, (uint64_t) (uintptr_t) cmd);
+    const SourceLocation *location = NULL;
+    if (spot && spot->index >= 0) {
+        location = source_map_at(locations, (size_t) spot->index);
+    }
+
+    if (location) {
+        fprintf(out, "%s:%" PRIu32, name, location->line);
+    } else {
+        fprintf(out, "%s", name);
+    }
+}
+
+/**
+ * @brief Orders commands from most to least sampled.
+ */
+static int compare_spots(const void *a, const void *b) {
+    const Spot *left  = a;
+    const Spot *right = b;
+    if (left->samples != right->samples) {
+        return (left->samples < right->samples) ? 1 : -1;
+    }
+    return (left->index > right->index) - (left->index < right->index);
+}
+
+/**
+ * @brief Orders stacks frame by frame, by the address of each command.
+ */
+static int compare_stacks(const void *a, const void *b) {
+    const Stack *left   = a;
+    const Stack *right  = b;
+    uint32_t     length = (left->length < right->length) ? left->length : right->length;
+    for (uint32_t i = 0; i < length; i++) {
+        uintptr_t l = (uintptr_t) left->frames[i];
+        uintptr_t r = (uintptr_t) right->frames[i];
+        if (l != r) {
+            return (l > r) - (l < r);
+        }
+    }
+    if (left->length != right->length) {
+        return (left->length > right->length) - (left->length < right->length);
+    }
+    return (left->cut > right->cut) - (left->cut < right->cut);
+}
@@ -0,0 +1,152 @@
+#include "scan.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Define CI_NO_SIMD to build only the scalar scanners
+#if !defined(CI_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#else
+#define SCAN_X86 0
+#endif
+
+#define SHORT_RUN 4  // Characters checked one at a time before a wide scan starts.
+
+static bool        in_set(char c, char s1, char s2, char s3, char s4);
+static const char *find_scalar(const char *p, const char *end, char s1, char s2, char s3, char s4,
+                               bool outside);
+static const char *find(const char *p, const char *end, char s1, char s2, char s3, char s4,
+                        bool outside);
+
+const char *scan_blanks(const char *p, const char *end) {
+    // Most runs are a separator and a space, too short to start a wide scan for
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (p == end || !in_set(*p, ' ', '\t', ',', '\r')) {
+            return p;
+        }
+    }
+    return find(p, end, ' ', '\t', ',', '\r', true);
+}
+
+const char *scan_line(const char *p, const char *end) {
+    return find(p, end, '\n', '\0', '\n', '\0', false);
+}
+
+const char *scan_string(const char *p, const char *end) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (p == end || *p == '"' || *p == '\n' || *p == '\0') {
+            return p;
+        }
+    }
+    return find(p, end, '"', '\n', '\0', '"', false);
+}
+
+/**
+ * @brief Determines whether a character is one of four others.
+ *
+ * @param c The character to check.
+ * @param s1, s2, s3, s4 The set, repeating characters if it is smaller.
+ * @return True if `c` is in the set.
+ */
+static bool in_set(char c, char s1, char s2, char s3, char s4) {
+    return c == s1 || c == s2 || c == s3 || c == s4;
+}
+
+/**
+ * @brief Finds the first character in or outside a set, one at a time.
+ *
+ * @param p The first character to examine.
+ * @param end One past the last character that may be read.
+ * @param s1, s2, s3, s4 The set, repeating characters if it is smaller.
+ * @param outside Find the first character outside the set instead of in it.
+ * @return The character found, or `end`.
+ */
+static const char *find_scalar(const char *p, const char *end, char s1, char s2, char s3, char s4,
+                               bool outside) {
+    while (p < end && in_set(*p, s1, s2, s3, s4) == outside) {
+        p++;
+    }
+    return p;
+}
+
+#if SCAN_X86
+/**
+ * @brief Finds the first character in or outside a set, 16 at a time.
+ *
+ * SSE2 is part of x86-64, so this needs no runtime check.
+ */
+static const char *find_sse2(const char *p, const char *end, char s1, char s2, char s3, char s4,
+                             bool outside) {
+    const __m128i v1 = _mm_set1_epi8(s1);
+    const __m128i v2 = _mm_set1_epi8(s2);
+    const __m128i v3 = _mm_set1_epi8(s3);
+    const __m128i v4 = _mm_set1_epi8(s4);
+
+    while (end - p >= 16) {
+        __m128i  chunk = _mm_loadu_si128((const __m128i *) p);
+        __m128i  hits =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v1), _mm_cmpeq_epi8(chunk, v2)),
+                         _mm_or_si128(_mm_cmpeq_epi8(chunk, v3), _mm_cmpeq_epi8(chunk, v4)));
+        unsigned mask  = (unsigned) _mm_movemask_epi8(hits);
+        if (outside) {
+            mask = ~mask & 0xffffu;
+        }
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return find_scalar(p, end, s1, s2, s3, s4, outside);
+}
+
+/**
+ * @brief Finds the first character in or outside a set, 32 at a time.
+ *
+ * Only called once the CPU is known to support AVX2.
+ */
+__attribute__((target("avx2"))) static const char *
+find_avx2(const char *p, const char *end, char s1, char s2, char s3, char s4, bool outside) {
+    const __m256i v1 = _mm256_set1_epi8(s1);
+    const __m256i v2 = _mm256_set1_epi8(s2);
+    const __m256i v3 = _mm256_set1_epi8(s3);
+    const __m256i v4 = _mm256_set1_epi8(s4);
+
+    while (end - p >= 32) {
+        __m256i  chunk = _mm256_loadu_si256((const __m256i *) p);
+        __m256i  hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, v1), _mm256_cmpeq_epi8(chunk, v2)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, v3), _mm256_cmpeq_epi8(chunk, v4)));
+        unsigned mask  = (unsigned) _mm256_movemask_epi8(hits);
+        if (outside) {
+            mask = ~mask;
+        }
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return find_sse2(p, end, s1, s2, s3, s4, outside);
+}
+#endif
+
+/**
+ * @brief Finds the first character in or outside a set with the widest
+ * instructions the CPU supports.
+ *
+ * @param p The first character to examine.
+ * @param end One past the last character that may be read.
+ * @param s1, s2, s3, s4 The set, repeating characters if it is smaller.
+ * @param outside Find the first character outside the set instead of in it.
+ * @return The character found, or `end`.
+ */
+static const char *find(const char *p, const char *end, char s1, char s2, char s3, char s4,
+                        bool outside) {
+#if SCAN_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return find_avx2(p, end, s1, s2, s3, s4, outside);
+    }
+    return find_sse2(p, end, s1, s2, s3, s4, outside);
+#else
+    return find_scalar(p, end, s1, s2, s3, s4, outside);
+#endif
+}
@@ -0,0 +1,87 @@
+#include "source_map.h"
+#include <stdlib.h>
+
+#define INITIAL_CAPACITY 1024
+
+static bool reserve(SourceMap *map, size_t count);
+
+void source_map_init(SourceMap *map) {
+    if (!map) {
+        return;
+    }
+
+    map->locations = NULL;
+    map->count     = 0;
+    map->capacity  = 0;
+}
+
+void source_map_free(SourceMap *map) {
+    if (!map) {
+        return;
+    }
+
+    free(map->locations);
+    source_map_init(map);
+}
+
+bool source_map_push(SourceMap *map, int line, int column) {
+    if (map->count == map->capacity && !reserve(map, 1)) {
+        return false;
+    }
+
+    map->locations[map->count++] = (SourceLocation) {(uint32_t) line, (uint32_t) column};
+    return true;
+}
+
+bool source_map_append(SourceMap *map, const SourceMap *part, size_t lines_before) {
+    if (!reserve(map, part->count)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < part->count; i++) {
+        SourceLocation location = part->locations[i];
+        location.line += (uint32_t) lines_before;
+        map->locations[map->count++] = location;
+    }
+    return true;
+}
+
+const SourceLocation *source_map_at(const SourceMap *map, size_t index) {
+    return (map && index < map->count) ? &map->locations[index] : NULL;
+}
+
+const SourceLocation *source_map_find(const SourceMap *map, const Command *commands,
+                                      const Command *cmd) {
+    size_t index = 0;
+    for (const Command *at = commands; at; at = at->next, index++) {
+        if (at == cmd) {
+            return source_map_at(map, index);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Makes room for more locations, at least doubling the room there is.
+ *
+ * @param map Pointer to the `SourceMap` to grow.
+ * @param count The number of locations to make room for.
+ * @return True on success, false if memory ran out.
+ */
+static bool reserve(SourceMap *map, size_t count) {
+    if (count <= map->capacity - map->count) {
+        return true;
+    }
+
+    size_t capacity = map->capacity ? map->capacity * 2 : INITIAL_CAPACITY;
+    if (capacity < map->count + count) {
+        capacity = map->count + count;
+    }
+    SourceLocation *locations = realloc(map->locations, capacity * sizeof(SourceLocation));
+    if (!locations) {
+        return false;
+    }
+    map->locations = locations;
+    map->capacity  = capacity;
+    return true;
+}
@@ -0,0 +1,65 @@
+#include "string_list.h"
+#include <stdlib.h>
+#include <string.h>
+
+void string_list_init(StringList *list) {
+    if (!list) {
+        return;
+    }
+
+    list->items    = NULL;
+    list->count    = 0;
+    list->capacity = 0;
+}
+
+void string_list_free(StringList *list) {
+    if (!list) {
+        return;
+    }
+
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i]);
+    }
+    free(list->items);
+    string_list_init(list);
+}
+
+bool string_list_push(StringList *list, const char *str, int length) {
+    if (!list || !str || length < 0) {
+        return false;
+    }
+
+    if (list->count == list->capacity) {
+        int    new_capacity = list->capacity ? list->capacity * 2 : 8;
+        char **new_items    = realloc(list->items, new_capacity * sizeof(char *));
+        if (!new_items) {
+            return false;
+        }
+        list->items    = new_items;
+        list->capacity = new_capacity;
+    }
+
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    list->items[list->count++] = copy;
+    return true;
+}
+
+bool string_list_contains(const StringList *list, const char *str) {
+    if (!list || !str) {
+        return false;
+    }
+
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->items[i], str) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
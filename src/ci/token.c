@@ -1,6 +1,8 @@
 #include "token.h"
 #include <stdio.h>
 
+#include "output.h"
+
 void token_init(Token *tok, TokenType tok_type, const char *lexeme, int lexeme_length, int line,
                 int column) {
     if (!tok) {
@@ -12,20 +14,21 @@ void token_init(Token *tok, TokenType tok_type, const char *lexeme, int lexeme_l
     tok->length = lexeme_length;
     tok->line   = line;
     tok->column = column;
+    tok->value  = -1;
 }
 
 void print_token(Token tok) {
-    printf("Token: ");
+    output_printf("Token: ");
     if (tok.type == TOK_EOF) {
-        printf("EOF");
+        output_printf("EOF");
     } else if (tok.type == TOK_NL) {
-        printf("Newline");
+        output_printf("Newline");
     } else {
-        printf("%.*s", tok.length, tok.lexeme);
+        output_printf("%.*s", tok.length, tok.lexeme);
     }
-    printf("\n");
+    output_printf("\n");
 
-    printf("Token type: %u\n", tok.type);
-    printf("Token length: %d\n", tok.length);
-    printf("Line: %d:%d\n", tok.line, tok.column);
+    output_printf("Token type: %u\n", tok.type);
+    output_printf("Token length: %d\n", tok.length);
+    output_printf("Line: %d:%d\n", tok.line, tok.column);
 }
@@ -0,0 +1,303 @@
+#include "token_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "token_type.h"
+
+#define INITIAL_CAPACITY 1024  // Tokens, newlines or overrides allocated at first.
+
+static bool   reserve_tokens(TokenBuffer *buffer);
+static bool   push_newline(TokenBuffer *buffer, uint32_t offset);
+static bool   push_override(TokenBuffer *buffer, size_t index, Token token);
+static size_t position_limit(const TokenBuffer *buffer, size_t index);
+static Token  token_at(const TokenBuffer *buffer, size_t index, size_t newlines);
+
+void token_buffer_init(TokenBuffer *buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    buffer->source            = NULL;
+    buffer->types             = NULL;
+    buffer->offsets           = NULL;
+    buffer->lengths           = NULL;
+    buffer->values            = NULL;
+    buffer->count             = 0;
+    buffer->capacity          = 0;
+    buffer->newlines          = NULL;
+    buffer->newline_count     = 0;
+    buffer->newline_capacity  = 0;
+    buffer->overrides         = NULL;
+    buffer->override_count    = 0;
+    buffer->override_capacity = 0;
+}
+
+void token_buffer_free(TokenBuffer *buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    free(buffer->types);
+    free(buffer->offsets);
+    free(buffer->lengths);
+    free(buffer->values);
+    free(buffer->newlines);
+    free(buffer->overrides);
+    token_buffer_init(buffer);
+}
+
+bool token_buffer_lex(TokenBuffer *buffer, const char *text) {
+    return text && token_buffer_lex_lines(buffer, text, strlen(text));
+}
+
+bool token_buffer_lex_lines(TokenBuffer *buffer, const char *text, size_t length) {
+    if (!buffer || !text || length > TOKEN_BUFFER_MAX_SOURCE) {
+        return false;
+    }
+
+    Lexer lex;
+    lexer_init_lines(&lex, text, length);
+    buffer->source = text;
+
+    // Where the line the lexer is on starts, to check its positions against
+    int64_t line_start = 0;
+    for (;;) {
+        Token t = lexer_next_token(&lex);
+        if (!reserve_tokens(buffer)) {
+            return false;
+        }
+
+        // An error token points at its message, so take its place from the lexer
+        const char *start  = (t.type == TOK_ERR) ? lex.start_position : t.lexeme;
+        size_t      size   = (t.type == TOK_ERR) ? (size_t) (lex.current_position - start)
+                                                 : (size_t) t.length;
+        uint32_t    offset = (uint32_t) (start - text);
+
+        // Strings are the only tokens a newline can be part of
+        if (t.type == TOK_STR) {
+            const char *nl = memchr(start, '\n', size);
+            while (nl) {
+                if (!push_newline(buffer, (uint32_t) (nl - text))) {
+                    return false;
+                }
+                line_start = nl + 1 - text;
+                nl         = memchr(nl + 1, '\n', size - (size_t) (nl + 1 - start));
+            }
+        }
+
+        size_t index           = buffer->count++;
+        buffer->types[index]   = (uint8_t) t.type;
+        buffer->offsets[index] = offset;
+        buffer->lengths[index] = (uint32_t) size;
+        buffer->values[index]  = t.value;
+
+        // Keep whole any token the tables would give a different position
+        if (t.type == TOK_ERR || t.line != (int64_t) buffer->newline_count + 1 ||
+            t.column != offset - line_start + 1) {
+            if (!push_override(buffer, index, t)) {
+                return false;
+            }
+        }
+
+        if (t.type == TOK_NL && text[offset] == '\n') {
+            if (!push_newline(buffer, offset)) {
+                return false;
+            }
+            line_start = offset + 1;
+        }
+        if (t.type == TOK_EOF) {
+            return true;
+        }
+    }
+}
+
+void token_cursor_init(TokenCursor *cursor, const TokenBuffer *buffer, size_t index) {
+    if (!cursor || !buffer) {
+        return;
+    }
+
+    if (index >= buffer->count) {
+        index = buffer->count ? buffer->count - 1 : 0;
+    }
+    cursor->buffer = buffer;
+    cursor->index  = index;
+
+    // Both tables are sorted, so find where the token falls in each
+    size_t limit = buffer->count ? position_limit(buffer, index) : 0;
+    size_t low   = 0;
+    size_t high  = buffer->newline_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (buffer->newlines[mid] < limit) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    cursor->newline = low;
+
+    low  = 0;
+    high = buffer->override_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (buffer->overrides[mid].index < index) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    cursor->override = low;
+}
+
+Token token_cursor_next(TokenCursor *cursor) {
+    const TokenBuffer *buffer = cursor->buffer;
+    size_t             index  = cursor->index;
+    if (index + 1 < buffer->count) {
+        cursor->index++;
+    }
+
+    // Tokens are in source order, so both tables are only ever walked forwards
+    size_t limit = position_limit(buffer, index);
+    while (cursor->newline < buffer->newline_count && buffer->newlines[cursor->newline] < limit) {
+        cursor->newline++;
+    }
+    while (cursor->override < buffer->override_count &&
+           buffer->overrides[cursor->override].index < index) {
+        cursor->override++;
+    }
+
+    if (cursor->override < buffer->override_count &&
+        buffer->overrides[cursor->override].index == index) {
+        return buffer->overrides[cursor->override].token;
+    }
+    return token_at(buffer, index, cursor->newline);
+}
+
+/**
+ * @brief Makes room for one more token in each of the parallel arrays.
+ *
+ * @param buffer Pointer to the `TokenBuffer` to grow.
+ * @return True on success, false if memory ran out.
+ */
+static bool reserve_tokens(TokenBuffer *buffer) {
+    if (buffer->count < buffer->capacity) {
+        return true;
+    }
+
+    size_t   capacity = buffer->capacity ? buffer->capacity * 2 : INITIAL_CAPACITY;
+    uint8_t *types    = realloc(buffer->types, capacity * sizeof(uint8_t));
+    if (!types) {
+        return false;
+    }
+    buffer->types = types;
+
+    uint32_t *offsets = realloc(buffer->offsets, capacity * sizeof(uint32_t));
+    if (!offsets) {
+        return false;
+    }
+    buffer->offsets = offsets;
+
+    uint32_t *lengths = realloc(buffer->lengths, capacity * sizeof(uint32_t));
+    if (!lengths) {
+        return false;
+    }
+    buffer->lengths = lengths;
+
+    int64_t *values = realloc(buffer->values, capacity * sizeof(int64_t));
+    if (!values) {
+        return false;
+    }
+    buffer->values   = values;
+    buffer->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Records the offset of a newline in the source.
+ *
+ * @param buffer Pointer to the `TokenBuffer` to record into.
+ * @param offset The offset of the newline, after every one recorded so far.
+ * @return True on success, false if memory ran out.
+ */
+static bool push_newline(TokenBuffer *buffer, uint32_t offset) {
+    if (buffer->newline_count == buffer->newline_capacity) {
+        size_t    capacity = buffer->newline_capacity ? buffer->newline_capacity * 2
+                                                      : INITIAL_CAPACITY;
+        uint32_t *newlines = realloc(buffer->newlines, capacity * sizeof(uint32_t));
+        if (!newlines) {
+            return false;
+        }
+        buffer->newlines         = newlines;
+        buffer->newline_capacity = capacity;
+    }
+
+    buffer->newlines[buffer->newline_count++] = offset;
+    return true;
+}
+
+/**
+ * @brief Stores a token whole, to be yielded instead of the recovered one.
+ *
+ * @param buffer Pointer to the `TokenBuffer` to record into.
+ * @param index The position of the token, after every one overridden so far.
+ * @param token The token as the lexer made it.
+ * @return True on success, false if memory ran out.
+ */
+static bool push_override(TokenBuffer *buffer, size_t index, Token token) {
+    if (buffer->override_count == buffer->override_capacity) {
+        size_t         capacity  = buffer->override_capacity ? buffer->override_capacity * 2
+                                                             : INITIAL_CAPACITY;
+        TokenOverride *overrides = realloc(buffer->overrides, capacity * sizeof(TokenOverride));
+        if (!overrides) {
+            return false;
+        }
+        buffer->overrides         = overrides;
+        buffer->override_capacity = capacity;
+    }
+
+    buffer->overrides[buffer->override_count].index = index;
+    buffer->overrides[buffer->override_count].token = token;
+    buffer->override_count++;
+    return true;
+}
+
+/**
+ * @brief Finds the offset that newlines must come before to count towards a
+ * token's line.
+ *
+ * The lexer numbers a token by the line it ends on, except for a newline,
+ * which is on the line it ends.
+ *
+ * @param buffer The buffer holding the token.
+ * @param index The position of the token.
+ * @return The offset newlines before the token's line are below.
+ */
+static size_t position_limit(const TokenBuffer *buffer, size_t index) {
+    size_t offset = buffer->offsets[index];
+    return (buffer->types[index] == TOK_NL) ? offset : offset + buffer->lengths[index];
+}
+
+/**
+ * @brief Rebuilds a token from the parallel arrays.
+ *
+ * @param buffer The buffer holding the token.
+ * @param index The position of the token.
+ * @param newlines The number of newlines before the token's line.
+ * @return The token, with its line and column.
+ */
+static Token token_at(const TokenBuffer *buffer, size_t index, size_t newlines) {
+    int64_t offset     = buffer->offsets[index];
+    int64_t line_start = newlines ? (int64_t) buffer->newlines[newlines - 1] + 1 : 0;
+
+    // Built in place rather than with `token_init`, as this runs for every token
+    Token token = {
+        .type   = (TokenType) buffer->types[index],
+        .length = (int) buffer->lengths[index],
+        .lexeme = buffer->source + offset,
+        .line   = (int) newlines + 1,
+        .column = (int) (offset - line_start + 1),
+        .value  = buffer->values[index],
+    };
+    return token;
+}
@@ -0,0 +1,65 @@
+sub x0 x5 0x7fffffffffffffff
+sub x0 x0 1
+print x0 d
+print x0 x
+print x0 b
+
+sub x1 x5 1
+print x1 d
+print x1 x
+print x1 b
+
+mov x2 0x7fffffffffffffff
+print x2 d
+print x2 x
+print x2 b
+
+sub x3 x5 0x7fffffffffffffff
+print x3 d
+print x3 x
+print x3 b
+
+mov x4 1
+print x4 d
+print x4 x
+print x4 b
+
+print x5 d
+print x5 x
+print x5 b
+
+mov x6 9
+print x6 d
+mov x6 10
+print x6 d
+mov x6 99
+print x6 d
+mov x6 100
+print x6 d
+mov x6 999999999999999999
+print x6 d
+mov x6 1000000000000000000
+print x6 d
+mov x6 0x100000000
+print x6 d
+print x6 x
+print x6 b
+
+sub x7 x5 10
+print x7 d
+sub x7 x5 100
+print x7 d
+sub x7 x5 1000000000000000000
+print x7 d
+print x7 x
+
+mov x8 0xf
+print x8 x
+print x8 b
+mov x8 0x10
+print x8 x
+print x8 b
+mov x8 0xff
+print x8 b
+mov x8 0x100
+print x8 b